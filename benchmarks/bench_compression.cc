@@ -0,0 +1,372 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * Measures the throughput, ratio and allocation count of every compressor
+ * on synthetic pages and on pages extracted from the Parquet files found
+ * in the test data directory, for page sizes from 8 KiB to 8 MiB.
+ *
+ * Usage: bench_compression [--corpus-dir DIR] [--min-time SECONDS]
+ */
+
+#include <parquet4seastar/compression.hh>
+#include <parquet4seastar/thrift_serdes.hh>
+#include <seastar/core/app-template.hh>
+#include <seastar/core/fstream.hh>
+#include <seastar/core/memory.hh>
+#include <seastar/core/seastar.hh>
+#include <seastar/core/thread.hh>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bpo = boost::program_options;
+
+namespace parquet4seastar {
+
+namespace {
+
+struct corpus {
+    std::string name;
+    bytes data;
+};
+
+bytes make_zeros(size_t size) {
+    return bytes(size, 0);
+}
+
+bytes make_noise(size_t size) {
+    bytes b;
+    b.reserve(size);
+    uint64_t x = 88172645463325252ull;
+    for (size_t i = 0; i < size; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        b.push_back(static_cast<byte>(x));
+    }
+    return b;
+}
+
+// PLAIN encoded INT64 timestamps with small, irregular deltas.
+bytes make_timestamps(size_t size) {
+    bytes b;
+    b.reserve(size);
+    int64_t ts = 1577836800000;
+    uint32_t x = 1;
+    while (b.size() + sizeof(ts) <= size) {
+        x = x * 1103515245 + 12345;
+        ts += 1000 + (x >> 24);
+        append_raw_bytes(b, ts);
+    }
+    b.resize(size, 0);
+    return b;
+}
+
+// PLAIN encoded BYTE_ARRAY of words drawn from a small vocabulary.
+bytes make_words(size_t size) {
+    static const char* vocabulary[] = {
+        "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+        "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+    };
+    constexpr size_t vocabulary_size = sizeof(vocabulary) / sizeof(vocabulary[0]);
+    bytes b;
+    b.reserve(size);
+    uint32_t x = 1;
+    while (b.size() < size) {
+        x = x * 1103515245 + 12345;
+        std::string_view word = vocabulary[(x >> 16) % vocabulary_size];
+        append_raw_bytes<uint32_t>(b, word.size());
+        b.insert(b.end(), word.begin(), word.end());
+    }
+    b.resize(size);
+    return b;
+}
+
+// The corpus is loaded with Seastar I/O, from the seastar thread of the benchmark.
+bytes read_whole_file(const std::string& path) {
+    seastar::file file = seastar::open_file_dma(path, seastar::open_flags::ro).get0();
+    seastar::input_stream<char> in = seastar::make_file_input_stream(std::move(file));
+    bytes data;
+    std::exception_ptr eptr;
+    try {
+        while (true) {
+            seastar::temporary_buffer<char> buf = in.read().get0();
+            if (buf.empty()) {
+                break;
+            }
+            data.append(reinterpret_cast<const byte*>(buf.get()), buf.size());
+        }
+    } catch (...) {
+        eptr = std::current_exception();
+    }
+    in.close().get();
+    if (eptr) {
+        std::rethrow_exception(eptr);
+    }
+    return data;
+}
+
+// Appends the paths of the .parquet files in dir and its subdirectories to out.
+void find_parquet_files(const std::string& dir, std::vector<std::string>& out) {
+    seastar::file d = seastar::open_directory(dir).get0();
+    std::vector<seastar::directory_entry> entries;
+    d.list_directory([&entries] (seastar::directory_entry entry) {
+        entries.push_back(std::move(entry));
+        return seastar::make_ready_future<>();
+    }).done().get();
+    d.close().get();
+    for (const seastar::directory_entry& entry : entries) {
+        if (entry.name == "." || entry.name == "..") {
+            continue;
+        }
+        std::string path = dir + "/" + entry.name;
+        std::optional<seastar::directory_entry_type> type = entry.type;
+        if (!type) {
+            type = seastar::file_type(path).get0();
+        }
+        std::string_view extension = ".parquet";
+        if (type == seastar::directory_entry_type::directory) {
+            find_parquet_files(path, out);
+        } else if (type == seastar::directory_entry_type::regular && path.size() >= extension.size()
+                && path.compare(path.size() - extension.size(), extension.size(), extension) == 0) {
+            out.push_back(std::move(path));
+        }
+    }
+}
+
+// Appends the uncompressed contents of every page of the file to out.
+void extract_pages(const bytes& file, bytes& out) {
+    if (file.size() < 12 || file.compare(file.size() - 4, 4, reinterpret_cast<const byte*>("PAR1"), 4) != 0) {
+        throw parquet_exception("not a parquet file");
+    }
+    uint32_t metadata_len;
+    std::memcpy(&metadata_len, file.data() + file.size() - 8, 4);
+    if (metadata_len + 8 > file.size()) {
+        throw parquet_exception("metadata length out of bounds");
+    }
+    format::FileMetaData metadata;
+    deserialize_thrift_msg(file.data() + file.size() - 8 - metadata_len, metadata_len, metadata);
+
+    for (const format::RowGroup& rg : metadata.row_groups) {
+        for (const format::ColumnChunk& cc : rg.columns) {
+            const format::ColumnMetaData& cmd = cc.meta_data;
+            auto c = compressor::make(cmd.codec);
+            size_t pos = cmd.__isset.dictionary_page_offset ? cmd.dictionary_page_offset : cmd.data_page_offset;
+            size_t end = pos + cmd.total_compressed_size;
+            if (end > file.size()) {
+                throw parquet_exception("column chunk out of bounds");
+            }
+            while (pos < end) {
+                format::PageHeader header;
+                pos += deserialize_thrift_msg(file.data() + pos, end - pos, header);
+                if (pos + header.compressed_page_size > end) {
+                    throw parquet_exception("page out of bounds");
+                }
+                bytes_view contents{file.data() + pos, static_cast<size_t>(header.compressed_page_size)};
+                pos += header.compressed_page_size;
+                if (header.type == format::PageType::DATA_PAGE_V2) {
+                    const format::DataPageHeaderV2& v2 = header.data_page_header_v2;
+                    size_t levels_size = v2.repetition_levels_byte_length + v2.definition_levels_byte_length;
+                    out.append(contents.substr(0, levels_size));
+                    contents.remove_prefix(levels_size);
+                    if (v2.__isset.is_compressed && !v2.is_compressed) {
+                        out.append(contents);
+                    } else {
+                        out.append(c->decompress(contents, bytes(header.uncompressed_page_size - levels_size, 0)));
+                    }
+                } else {
+                    out.append(c->decompress(contents, bytes(header.uncompressed_page_size, 0)));
+                }
+            }
+        }
+    }
+}
+
+corpus make_real_corpus(const std::string& dir) {
+    corpus real{"test_data", {}};
+    if (seastar::file_type(dir).get0() != seastar::directory_entry_type::directory) {
+        return real;
+    }
+    std::vector<std::string> paths;
+    find_parquet_files(dir, paths);
+    for (const std::string& path : paths) {
+        try {
+            extract_pages(read_whole_file(path), real.data);
+        } catch (const std::exception& e) {
+            // Unsupported codecs, encrypted files and deliberately corrupted test files.
+            std::cerr << "Skipping " << path << ": " << e.what() << '\n';
+        }
+    }
+    return real;
+}
+
+// Cut the corpus into pages of the given size, repeating the corpus if it is too small.
+std::vector<bytes> make_pages(const bytes& data, size_t page_size, size_t total_size) {
+    std::vector<bytes> pages;
+    size_t n_pages = std::max<size_t>(1, total_size / page_size);
+    size_t pos = 0;
+    for (size_t i = 0; i < n_pages; ++i) {
+        bytes page;
+        page.reserve(page_size);
+        while (page.size() < page_size) {
+            size_t n = std::min(page_size - page.size(), data.size() - pos);
+            page.append(data, pos, n);
+            pos = (pos + n) % data.size();
+        }
+        pages.push_back(std::move(page));
+    }
+    return pages;
+}
+
+struct measurement {
+    double seconds = 0;
+    uint64_t calls = 0;
+    uint64_t allocations = 0;
+};
+
+// Run f over all pages repeatedly until min_time has passed.
+template <typename Func>
+measurement measure(const std::vector<bytes>& pages, double min_time, Func f) {
+    measurement m;
+    auto start = std::chrono::steady_clock::now();
+    do {
+        uint64_t mallocs_before = seastar::memory::stats().mallocs();
+        for (size_t i = 0; i < pages.size(); ++i) {
+            f(i);
+        }
+        m.allocations += seastar::memory::stats().mallocs() - mallocs_before;
+        m.calls += pages.size();
+        m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (m.seconds < min_time);
+    return m;
+}
+
+void bench(const corpus& corp, format::CompressionCodec::type codec, size_t page_size, double min_time) {
+    constexpr size_t total_size = 32 * 1024 * 1024;
+    auto c = compressor::make(codec);
+    std::vector<bytes> pages = make_pages(corp.data, page_size, total_size);
+
+    std::vector<bytes> compressed(pages.size());
+    measurement comp = measure(pages, min_time, [&] (size_t i) {
+        compressed[i] = c->compress(pages[i], std::move(compressed[i]));
+    });
+
+    std::vector<bytes> decompressed(pages.size());
+    measurement decomp = measure(pages, min_time, [&] (size_t i) {
+        decompressed[i].resize(pages[i].size());
+        decompressed[i] = c->decompress(compressed[i], std::move(decompressed[i]));
+    });
+    for (size_t i = 0; i < pages.size(); ++i) {
+        if (decompressed[i] != pages[i]) {
+            throw parquet_exception(seastar::format("Roundtrip failure for codec {}", codec));
+        }
+    }
+
+    size_t uncompressed_size = 0;
+    size_t compressed_size = 0;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        uncompressed_size += pages[i].size();
+        compressed_size += compressed[i].size();
+    }
+    double mb = 1024 * 1024;
+    double mb_per_round = uncompressed_size / mb;
+    double rounds_comp = static_cast<double>(comp.calls) / pages.size();
+    double rounds_decomp = static_cast<double>(decomp.calls) / pages.size();
+    std::cout << std::left
+            << std::setw(12) << corp.name
+            << std::setw(14) << codec
+            << std::right
+            << std::setw(10) << page_size / 1024
+            << std::fixed << std::setprecision(3)
+            << std::setw(10) << static_cast<double>(uncompressed_size) / compressed_size
+            << std::setprecision(1)
+            << std::setw(12) << mb_per_round * rounds_comp / comp.seconds
+            << std::setw(12) << mb_per_round * rounds_decomp / decomp.seconds
+            << std::setprecision(2)
+            << std::setw(12) << static_cast<double>(comp.allocations) / comp.calls
+            << std::setw(12) << static_cast<double>(decomp.allocations) / decomp.calls
+            << std::endl;
+}
+
+} // namespace
+
+} // namespace parquet4seastar
+
+int main(int argc, char* argv[]) {
+    using namespace parquet4seastar;
+    seastar::app_template app;
+    app.add_options()
+        ("corpus-dir", bpo::value<std::string>()->default_value(PARQUET4SEASTAR_TEST_DATA),
+                "Directory searched (recursively) for .parquet files, whose pages form the real corpus")
+        ("min-time", bpo::value<double>()->default_value(0.2),
+                "Minimum time (in seconds) spent on each measurement");
+    return app.run(argc, argv, [&app] {
+        return seastar::async([&app] {
+            auto&& config = app.configuration();
+            double min_time = config["min-time"].as<double>();
+
+            constexpr size_t synthetic_size = 8 * 1024 * 1024;
+            std::vector<corpus> corpora;
+            corpora.push_back({"zeros", make_zeros(synthetic_size)});
+            corpora.push_back({"noise", make_noise(synthetic_size)});
+            corpora.push_back({"timestamps", make_timestamps(synthetic_size)});
+            corpora.push_back({"words", make_words(synthetic_size)});
+            corpus real = make_real_corpus(config["corpus-dir"].as<std::string>());
+            if (real.data.empty()) {
+                std::cerr << "No pages found in the corpus directory, skipping the real corpus\n";
+            } else {
+                corpora.push_back(std::move(real));
+            }
+
+            const format::CompressionCodec::type codecs[] = {
+                format::CompressionCodec::UNCOMPRESSED,
+                format::CompressionCodec::SNAPPY,
+                format::CompressionCodec::GZIP,
+            };
+
+            std::cout << std::left
+                    << std::setw(12) << "corpus"
+                    << std::setw(14) << "codec"
+                    << std::right
+                    << std::setw(10) << "page KiB"
+                    << std::setw(10) << "ratio"
+                    << std::setw(12) << "comp MB/s"
+                    << std::setw(12) << "decomp MB/s"
+                    << std::setw(12) << "comp allocs"
+                    << std::setw(12) << "decomp allocs"
+                    << std::endl;
+            for (const corpus& corp : corpora) {
+                for (format::CompressionCodec::type codec : codecs) {
+                    for (size_t page_size = 8 * 1024; page_size <= 8 * 1024 * 1024; page_size *= 4) {
+                        bench(corp, codec, page_size, min_time);
+                    }
+                }
+            }
+        });
+    });
+}
@@ -164,17 +164,17 @@ void do_write() {
     // flush_row_group(). (There is no other way other than writing each column
     // to a separate file. This is permitted by Parquet, but not used by us.)
     //
-    // The flushing is not done automatically because it would require
-    // synchronization between column writers (because a row group can only be
-    // flushed on row boundaries, i.e. when all columns for all rows in the
-    // group has been written).
+    // The flushing can't be done by put() because it requires synchronization
+    // between column writers (because a row group can only be flushed on row
+    // boundaries, i.e. when all columns for all rows in the group has been
+    // written).
     //
-    // Hence, the user has to flush the row group periodically, using
-    // file_writer::flush_row_group(). According to the Parquet specification,
-    // a row group should be several hundred MB in size. Anything bigger than
-    // that would also be impractical because the entire row group has to fit
-    // in memory before the flush. The current estimated row group size can be
+    // Hence, the user has to call file_writer::maybe_flush_row_group()
+    // periodically, on row boundaries. It flushes the row group once its
+    // estimated size reaches file_writer_options::target_row_group_size
+    // (128MiB by default). The current estimated row group size can be
     // obtained with file_writer::estimated_row_group_size().
+    // flush_row_group() flushes the row group unconditionally.
     //
     // There is no control that an equal number of rows was written to every
     // column before the flush. Failure to do so will result in an incorrect
@@ -184,13 +184,11 @@ void do_write() {
     // Note that put() is synchronous. This is because the writes are buffered
     // until flush_row_group().
     map_key.put(2, 0, "key1"_bv);
-    // It is also the user's responsibility to flush pages periodically using
-    // flush_page().
+    // Pages are flushed automatically by put(), on row boundaries, when the
+    // page reaches column_chunk_writer_options::target_page_size or
+    // max_rows_per_page. They can also be flushed manually with flush_page().
     //
-    // Pages should be several KB in size. Anything bigger than that could cause
-    // problems with big allocations and/or reactor stalls for readers.
-    //
-    // The current max possible size of the page after encoding can be viewed with
+    // The size of the page is measured with
     // column_chunk_writer::current_page_max_size(). It is an upper bound - the
     // actual size might be smaller. (Currently, it can be up to 3KB smaller.
     // This may happen with DELTA_BINARY_PACKED encoding of INT64. In this
@@ -198,16 +196,10 @@ void do_write() {
     // may be estimated at their full size (256 * 8B = 2KB), even if the batch
     // will shrink to almost nothing).
     //
-    // Unlike with row groups, automating the page flushing could (and
-    // should) be easily implemented, but we hesitated because the Parquet
-    // specification is somewhat unclear about whether page breaks can occur in
-    // the middle of a row. (See parquet.thrift:904, the comment to
-    // first_row_index). If rows cannot be broken, this could potentially
-    // result in pages of unbounded size (e.g. with very long lists), which
-    // would be unacceptable.
-    //
-    // If rows can be broken, or that bit of specification is determined to be
-    // of no concern, page flushing should be automated.
+    // Pages are never broken in the middle of a row, because the Parquet
+    // specification is somewhat unclear about whether that is allowed. (See
+    // parquet.thrift:904, the comment to first_row_index). Hence, a row with a
+    // very long list results in a page bigger than the target.
     map_key.flush_page();
     map_value.put(2, 0, 1);
     map_key.put(2, 1, "key2"_bv);
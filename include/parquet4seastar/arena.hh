@@ -0,0 +1,87 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/bytes.hh>
+#include <seastar/core/temporary_buffer.hh>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace parquet4seastar {
+
+/* A bump allocator for the byte array values of a batch. All memory is released at once
+ * by clear(), which keeps the first chunk for reuse. Buffers which values point into
+ * (e.g. decompressed pages) can be kept alive until then with keep().
+ */
+class byte_arena {
+    struct chunk {
+        std::unique_ptr<byte[]> data;
+        size_t size;
+    };
+    std::vector<chunk> _chunks;
+    std::vector<seastar::temporary_buffer<byte>> _kept;
+    size_t _chunk_size;
+    // The number of bytes allocated from the last chunk.
+    size_t _used = 0;
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+    explicit byte_arena(size_t chunk_size = DEFAULT_CHUNK_SIZE) : _chunk_size{chunk_size} {}
+
+    byte* allocate(size_t n) {
+        if (_chunks.empty() || _chunks.back().size - _used < n) {
+            size_t size = std::max(n, _chunk_size);
+            _chunks.push_back(chunk{std::make_unique<byte[]>(size), size});
+            _used = 0;
+        }
+        byte* result = _chunks.back().data.get() + _used;
+        _used += n;
+        return result;
+    }
+    bytes_view copy(bytes_view v) {
+        if (v.empty()) {
+            return {};
+        }
+        byte* data = allocate(v.size());
+        std::memcpy(data, v.data(), v.size());
+        return {data, v.size()};
+    }
+    void keep(seastar::temporary_buffer<byte> buf) {
+        _kept.push_back(std::move(buf));
+    }
+    void clear() {
+        if (_chunks.size() > 1) {
+            _chunks.erase(_chunks.begin() + 1, _chunks.end());
+        }
+        _used = 0;
+        _kept.clear();
+    }
+};
+
+// A temporary_buffer which doesn't own its memory, so it costs nothing to create and destroy.
+// The memory has to outlive it (and its shares).
+inline seastar::temporary_buffer<byte> unowned_buffer(bytes_view v) {
+    return seastar::temporary_buffer<byte>(const_cast<byte*>(v.data()), v.size(), seastar::deleter());
+}
+
+} // namespace parquet4seastar
@@ -0,0 +1,95 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/bytes.hh>
+#include <parquet4seastar/parquet_types.h>
+#include <cstdint>
+#include <vector>
+
+namespace parquet4seastar {
+
+// XXH64, as required by the Parquet bloom filter specification.
+uint64_t xxhash64(bytes_view data, uint64_t seed = 0);
+
+// The hash of a value is the hash of its plain encoding (without the length prefix for byte arrays).
+inline uint64_t bloom_filter_hash(bytes_view x) {
+    return xxhash64(x);
+}
+
+template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+uint64_t bloom_filter_hash(T x) {
+    return xxhash64(bytes_view{reinterpret_cast<const byte*>(&x), sizeof(x)});
+}
+
+struct bloom_filter_options {
+    // The expected number of distinct values in a column chunk.
+    uint64_t ndv = 1000000;
+    // The false positive probability at ndv distinct values.
+    double fpp = 0.01;
+};
+
+/* The split block bloom filter described in BloomFilter.md of parquet-format.
+ * The filter is an array of 256-bit blocks. Each hash sets 8 bits in a single block,
+ * so every lookup touches only one cache line.
+ */
+class bloom_filter {
+public:
+    static constexpr size_t BYTES_PER_BLOCK = 32;
+    static constexpr size_t MIN_BYTES = BYTES_PER_BLOCK;
+    static constexpr size_t MAX_BYTES = 128 * 1024 * 1024;
+private:
+    static constexpr size_t WORDS_PER_BLOCK = 8;
+    std::vector<uint32_t> _words;
+    uint64_t _num_blocks;
+private:
+    uint32_t* block(uint64_t hash) {
+        return &_words[((hash >> 32) * _num_blocks >> 32) * WORDS_PER_BLOCK];
+    }
+    const uint32_t* block(uint64_t hash) const {
+        return &_words[((hash >> 32) * _num_blocks >> 32) * WORDS_PER_BLOCK];
+    }
+public:
+    // The smallest power of 2 which gives the expected false positive probability
+    // with the given number of distinct values, clamped to [MIN_BYTES, MAX_BYTES].
+    static size_t optimal_num_bytes(uint64_t ndv, double fpp);
+    // num_bytes is rounded up to a power of 2 and clamped to [MIN_BYTES, MAX_BYTES].
+    explicit bloom_filter(size_t num_bytes);
+    explicit bloom_filter(const bloom_filter_options& options)
+        : bloom_filter(optimal_num_bytes(options.ndv, options.fpp)) {}
+    // A filter read from a file. The size has to be a multiple of BYTES_PER_BLOCK.
+    static bloom_filter from_bitset(bytes_view bitset);
+
+    void insert(uint64_t hash);
+    bool find(uint64_t hash) const;
+    void clear();
+    // The bitset, as it is written to the file (after the header).
+    bytes_view view() const {
+        return {reinterpret_cast<const byte*>(_words.data()), _words.size() * sizeof(uint32_t)};
+    }
+    size_t num_bytes() const { return _words.size() * sizeof(uint32_t); }
+    format::BloomFilterHeader header() const { return header(num_bytes()); }
+    // The header of a filter with a bitset of num_bytes bytes.
+    static format::BloomFilterHeader header(size_t num_bytes);
+};
+
+} // namespace parquet4seastar
@@ -74,7 +74,8 @@ private:
     void load_data_page_v2(page p);
 
     template<typename LevelT>
-    seastar::future<size_t> read_batch_internal(size_t n, LevelT def[], LevelT rep[], output_type val[]);
+    seastar::future<size_t> read_batch_internal(
+            size_t n, LevelT def[], LevelT rep[], output_type val[], byte_arena* arena);
 public:
     explicit column_chunk_reader(
             page_reader&& source,
@@ -96,18 +97,24 @@ public:
     // Example output: def == [1, 1, 0, 1, 0], rep = [0, 0, 0, 0, 0], val = ["a", "b", "d"].
     template<typename LevelT>
     seastar::future<size_t> read_batch(size_t n, LevelT def[], LevelT rep[], output_type val[]);
+    // Like the above, but byte array values don't own their memory: they point into the dictionary
+    // (valid as long as the reader) or into the arena, which keeps the pages they come from alive.
+    // The whole batch is released by clearing the arena.
+    template<typename LevelT>
+    seastar::future<size_t> read_batch(size_t n, LevelT def[], LevelT rep[], output_type val[], byte_arena& arena);
 };
 
 template<format::Type::type T>
 template<typename LevelT>
 seastar::future<size_t>
-column_chunk_reader<T>::read_batch_internal(size_t n, LevelT def[], LevelT rep[], output_type val[]) {
+column_chunk_reader<T>::read_batch_internal(
+        size_t n, LevelT def[], LevelT rep[], output_type val[], byte_arena* arena) {
     if (_eof) {
         return seastar::make_ready_future<size_t>(0);
     }
     if (!_initialized) {
-        return load_next_page().then([this, n, def, rep, val] {
-            return read_batch_internal(n, def, rep, val);
+        return load_next_page().then([this, n, def, rep, val, arena] {
+            return read_batch_internal(n, def, rep, val, arena);
         });
     }
     size_t def_levels_read = _def_decoder.read_batch(n, def);
@@ -119,7 +126,7 @@ column_chunk_reader<T>::read_batch_internal(size_t n, LevelT def[], LevelT rep[]
     }
     if (def_levels_read == 0) {
         _initialized = false;
-        return read_batch_internal(n, def, rep, val);
+        return read_batch_internal(n, def, rep, val, arena);
     }
     for (size_t i = 0; i < def_levels_read; ++i) {
         if (def[i] < 0 || def[i] > static_cast<LevelT>(_def_level)) {
@@ -137,7 +144,9 @@ column_chunk_reader<T>::read_batch_internal(size_t n, LevelT def[], LevelT rep[]
             ++values_to_read;
         }
     }
-    size_t values_read = _val_decoder.read_batch(values_to_read, val);
+    size_t values_read = arena
+            ? _val_decoder.read_batch_unowned(values_to_read, val, *arena)
+            : _val_decoder.read_batch(values_to_read, val);
     if (values_read != values_to_read) {
         return seastar::make_exception_future<size_t>(parquet_exception::corrupted_file(seastar::format(
                 "Number of values in batch {} is less than indicated by def levels {}", values_read, values_to_read)));
@@ -149,7 +158,19 @@ template<format::Type::type T>
 template<typename LevelT>
 seastar::future<size_t>
 inline column_chunk_reader<T>::read_batch(size_t n, LevelT def[], LevelT rep[], output_type val[]) {
-    return read_batch_internal(n, def, rep, val)
+    return read_batch_internal(n, def, rep, val, nullptr)
+    .handle_exception_type([this] (const std::exception& e) {
+        return seastar::make_exception_future<size_t>(parquet_exception(seastar::format(
+                "Error while reading page number {}: {}", _page_ordinal, e.what())));
+    });
+}
+
+template<format::Type::type T>
+template<typename LevelT>
+seastar::future<size_t>
+inline column_chunk_reader<T>::read_batch(
+        size_t n, LevelT def[], LevelT rep[], output_type val[], byte_arena& arena) {
+    return read_batch_internal(n, def, rep, val, &arena)
     .handle_exception_type([this] (const std::exception& e) {
         return seastar::make_exception_future<size_t>(parquet_exception(seastar::format(
                 "Error while reading page number {}: {}", _page_ordinal, e.what())));
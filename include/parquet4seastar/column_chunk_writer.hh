@@ -21,11 +21,23 @@
 
 #pragma once
 
+#include <parquet4seastar/bloom_filter.hh>
 #include <parquet4seastar/column_chunk_reader.hh>
 #include <parquet4seastar/bytes.hh>
 #include <parquet4seastar/encoding.hh>
+#include <parquet4seastar/spill_file.hh>
+#include <parquet4seastar/statistics.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/core/scheduling.hh>
+#include <seastar/core/semaphore.hh>
+#include <seastar/core/shared_future.hh>
 #include <boost/iterator/counting_iterator.hpp>
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace parquet4seastar {
@@ -35,59 +47,263 @@ struct writer_options {
     uint32_t rep_level;
     format::Encoding::type encoding;
     format::CompressionCodec::type compression;
+    size_t max_dictionary_size = default_max_dictionary_size;
+};
+
+// Knobs which affect how a column chunk is written, but not what is written.
+struct column_chunk_writer_options {
+    // If set, pages are compressed in the background, in this scheduling group,
+    // instead of synchronously in flush_page(). Encoding of the following pages
+    // can proceed while previous pages are being compressed.
+    std::optional<seastar::scheduling_group> compression_group;
+    // The maximum number of pages being compressed in the background at once.
+    // Further pages wait, uncompressed, until one is done. column_chunk_writer::backpressure()
+    // resolves when there is a free slot.
+    size_t max_pages_in_compression = 4;
+    // If set, the codec of each column chunk is chosen automatically, by compressing its first pages
+    // with every candidate codec. The compressor given to the writer is then used only for chunks
+    // without data pages. With a compression_group, the trial compressions run there too.
+    std::optional<codec_selection_options> auto_compression;
+    // The directory in which spill() creates the temporary file for the pages of this column.
+    // Required by spill(), and thus by file_writer_options::memory_budget.
+    std::optional<std::string> spill_directory;
+    // put() flushes the current page before starting a new row, if the page has reached
+    // either of these limits. Pages are only ever broken on row boundaries, so a single
+    // huge row can still produce a page above target_page_size.
+    // The size is measured with current_page_max_size(), i.e. before compression.
+    size_t target_page_size = 1024 * 1024;
+    size_t max_rows_per_page = 20000;
+    // If set, statistics are written to every data page header and to the column chunk metadata.
+    std::optional<statistics_options> statistics = statistics_options{};
+    // If set, a bloom filter of the non-null values of each chunk is built.
+    std::optional<bloom_filter_options> bloom_filter;
+    // If set, data pages are written as DATA_PAGE_V2. Their levels aren't compressed, so readers
+    // can count nulls and rows without decompressing. Values which don't compress are stored
+    // uncompressed.
+    bool data_page_v2 = false;
+};
+
+// The page index of a column chunk. Page offsets are relative to the beginning of the chunk.
+struct page_index {
+    // Unset if statistics are disabled, or if some page with values has no min and max
+    // (e.g. it has only NaNs).
+    std::optional<format::ColumnIndex> column_index;
+    format::OffsetIndex offset_index;
 };
 
 template <format::Type::type ParquetType>
 class column_chunk_writer {
+public:
+    using input_type = typename value_encoder<ParquetType>::input_type;
+private:
     thrift_serializer _thrift_serializer;
     rle_builder _rep_encoder;
     rle_builder _def_encoder;
     std::unique_ptr<value_encoder<ParquetType>> _val_encoder;
+    // The compressor given to the writer.
     std::unique_ptr<compressor> _compressor;
-    std::vector<bytes> _pages;
+    // The codec selected for the current chunk with auto_compression, if any.
+    std::unique_ptr<compressor> _chunk_compressor;
+    column_chunk_writer_options _options;
+    // Pages compressed in the background resolve when their compression is done.
+    std::vector<seastar::future<bytes>> _pages;
+    // Limits the pages compressed in the background. Set if there is a compression group.
+    seastar::lw_shared_ptr<seastar::semaphore> _compression_slots;
+    // The sizes of the pages of the current chunk. Shared with the background compressions,
+    // which replace the uncompressed size of their page with the compressed one when done.
+    struct page_sizes {
+        size_t estimated_chunk_size = 0;
+        size_t buffered_size = 0;
+        void add(size_t size) {
+            estimated_chunk_size += size;
+            buffered_size += size;
+        }
+        void replace(size_t old_size, size_t new_size) {
+            add(new_size);
+            estimated_chunk_size -= old_size;
+            buffered_size -= old_size;
+        }
+    };
+    seastar::lw_shared_ptr<page_sizes> _sizes = seastar::make_lw_shared<page_sizes>();
+    std::optional<codec_selector> _codec_selector;
+    bool _codec_selected = false;
+    // Sample pages wait here until the codec of the chunk is selected.
+    struct sampled_page {
+        seastar::promise<bytes> compressed;
+        // For DATA_PAGE_V2: the size of the levels, and the page before compression.
+        std::optional<size_t> v2_levels_size;
+        // Only kept for DATA_PAGE_V2, or if the samples are compressed in the background.
+        bytes page;
+    };
+    // Set while the codec of the chunk is being selected in the background.
+    std::optional<seastar::shared_future<format::CompressionCodec::type>> _selected_codec;
+    std::vector<sampled_page> _sampled_pages;
+    size_t _sampled_bytes = 0;
+    // Pages [0, _spilled_pages) of the current chunk were moved to _spill.
+    std::optional<spill_file> _spill;
+    size_t _spilled_pages = 0;
     std::vector<format::PageHeader> _page_headers;
     bytes _dict_page;
     format::PageHeader _dict_page_header;
     std::unordered_set<format::Encoding::type> _used_encodings;
     uint64_t _levels_in_current_page = 0;
     uint64_t _values_in_current_page = 0;
+    uint64_t _rows_in_current_page = 0;
     uint32_t _rep_level;
     uint32_t _def_level;
     uint64_t _rows_written = 0;
-    size_t _estimated_chunk_size = 0;
+    std::optional<statistics_builder<ParquetType>> _page_statistics;
+    std::optional<statistics_builder<ParquetType>> _chunk_statistics;
+    // The dictionary is reset after every chunk, so if all pages of the chunk use it,
+    // it holds exactly the distinct values of the chunk.
+    bool _only_dictionary_pages = true;
+    // The index of the first row of each page in the current chunk.
+    // The page index assumes that pages begin on row boundaries, which is the case
+    // unless flush_page() is called by the user in the middle of a row.
+    std::vector<int64_t> _page_first_rows;
+    std::vector<format::PageLocation> _page_locations;
+    page_index _page_index;
+    std::optional<bloom_filter> _bloom_filter;
+    std::optional<bloom_filter> _flushed_bloom_filter;
+    // Scratch space for put_batch_spaced().
+    std::vector<input_type> _spaced_values;
+    // Called at the end of every flush_page(). Used by file_writer to enforce its memory budget.
+    std::function<void()> _on_page_flushed;
 public:
-    using input_type = typename value_encoder<ParquetType>::input_type;
-
     column_chunk_writer(
             uint32_t def_level,
             uint32_t rep_level,
             std::unique_ptr<value_encoder<ParquetType>> val_encoder,
-            std::unique_ptr<compressor> compressor)
+            std::unique_ptr<compressor> compressor,
+            column_chunk_writer_options options = {})
         : _rep_encoder{bit_width(rep_level)}
         , _def_encoder{bit_width(def_level)}
         , _val_encoder{std::move(val_encoder)}
         , _compressor{std::move(compressor)}
+        , _options{std::move(options)}
         , _used_encodings(10)
         , _rep_level{rep_level}
-        , _def_level{def_level}
-        {}
+        , _def_level{def_level} {
+        if (_options.compression_group) {
+            _compression_slots = seastar::make_lw_shared<seastar::semaphore>(
+                    std::max<size_t>(_options.max_pages_in_compression, 1));
+        }
+        if (_options.auto_compression) {
+            _codec_selector.emplace(*_options.auto_compression);
+        }
+        if (_options.statistics) {
+            _page_statistics.emplace(*_options.statistics);
+            _chunk_statistics.emplace(*_options.statistics);
+        }
+        if (_options.bloom_filter) {
+            _bloom_filter.emplace(*_options.bloom_filter);
+            _flushed_bloom_filter.emplace(*_options.bloom_filter);
+        }
+    }
 
     void put(uint32_t def_level, uint32_t rep_level, input_type val) {
-        if (_rep_level > 0) {
-            _rep_encoder.put(rep_level);
-        }
         if (_rep_level == 0 || rep_level == 0) {
+            if (_levels_in_current_page > 0 && page_is_full()) {
+                flush_page();
+            }
             ++_rows_written;
+            ++_rows_in_current_page;
+        }
+        if (_rep_level > 0) {
+            _rep_encoder.put(rep_level);
         }
         if (_def_level > 0) {
             _def_encoder.put(def_level);
         }
         if (_def_level == 0 || def_level == _def_level) {
             _val_encoder->put_batch(&val, 1);
+            ++_values_in_current_page;
+            if (_page_statistics) {
+                _page_statistics->put(val);
+            }
+            if (_bloom_filter) {
+                _bloom_filter->insert(bloom_filter_hash(val));
+            }
+        } else if (_page_statistics) {
+            _page_statistics->put_null();
         }
         ++_levels_in_current_page;
     }
 
+    // Put n (def, rep, value) triplets. Like in column_chunk_reader::read_batch, values contains
+    // only the non-null values. def (rep) may be null if the column's max definition (repetition)
+    // level is 0. Pages are flushed automatically, on row boundaries, like in put().
+    template <typename LevelT>
+    void put_batch(size_t n, const LevelT def[], const LevelT rep[], const input_type values[]) {
+        size_t done = 0;
+        while (done < n) {
+            bool row_start = _rep_level == 0 || rep[done] == 0;
+            if (row_start && _levels_in_current_page > 0 && page_is_full()) {
+                flush_page();
+            }
+            // Take as many rows as should fit in the page.
+            size_t max_rows = rows_until_page_full();
+            if (row_start) {
+                max_rows = std::max<size_t>(max_rows, 1);
+            }
+            size_t end = done;
+            size_t rows = 0;
+            if (_rep_level == 0) {
+                end = std::min(n, done + max_rows);
+                rows = end - done;
+            } else {
+                for (; end < n; ++end) {
+                    if (rep[end] == 0) {
+                        if (rows == max_rows) {
+                            break;
+                        }
+                        ++rows;
+                    }
+                }
+            }
+            size_t levels = end - done;
+            size_t n_values = levels;
+            if (_def_level > 0) {
+                n_values = std::count(def + done, def + end, static_cast<LevelT>(_def_level));
+                _def_encoder.put_batch(def + done, levels);
+            }
+            if (_rep_level > 0) {
+                _rep_encoder.put_batch(rep + done, levels);
+            }
+            _val_encoder->put_batch(values, n_values);
+            _values_in_current_page += n_values;
+            if (_page_statistics) {
+                _page_statistics->put_batch(values, n_values);
+                _page_statistics->put_nulls(levels - n_values);
+            }
+            if (_bloom_filter) {
+                for (size_t i = 0; i < n_values; ++i) {
+                    _bloom_filter->insert(bloom_filter_hash(values[i]));
+                }
+            }
+            _levels_in_current_page += levels;
+            _rows_in_current_page += rows;
+            _rows_written += rows;
+            values += n_values;
+            done = end;
+        }
+    }
+
+    // Like put_batch, but values has a slot for every triplet, and only the slots with their bit
+    // set in valid_bits (LSB first, starting from bit valid_bits_offset) are used.
+    template <typename LevelT>
+    void put_batch_spaced(size_t n, const LevelT def[], const LevelT rep[],
+            const uint8_t valid_bits[], size_t valid_bits_offset, const input_type values[]) {
+        _spaced_values.clear();
+        for (size_t i = 0; i < n; ++i) {
+            size_t bit = valid_bits_offset + i;
+            if (valid_bits[bit / 8] & (1 << (bit % 8))) {
+                _spaced_values.push_back(values[i]);
+            }
+        }
+        put_batch(n, def, rep, _spaced_values.data());
+    }
+
     size_t current_page_max_size() const {
         size_t def_size = _def_level ? _def_encoder.max_encoded_size() : 0;
         size_t rep_size = _rep_level ? _rep_encoder.max_encoded_size() : 0;
@@ -99,65 +315,151 @@ public:
         bytes page;
         size_t page_max_size = current_page_max_size();
         page.reserve(page_max_size);
+        // In DATA_PAGE_V2 the sizes of levels are stored in the header instead of the page.
+        size_t rep_levels_size = 0;
+        size_t def_levels_size = 0;
         if (_rep_level > 0) {
             bytes_view levels = _rep_encoder.view();
-            append_raw_bytes<uint32_t>(page, levels.size());
+            if (!_options.data_page_v2) {
+                append_raw_bytes<uint32_t>(page, levels.size());
+            }
             page.insert(page.end(), levels.begin(), levels.end());
+            rep_levels_size = levels.size();
         }
         if (_def_level > 0) {
             bytes_view levels = _def_encoder.view();
-            append_raw_bytes<uint32_t>(page, levels.size());
+            if (!_options.data_page_v2) {
+                append_raw_bytes<uint32_t>(page, levels.size());
+            }
             page.insert(page.end(), levels.begin(), levels.end());
+            def_levels_size = levels.size();
         }
         size_t data_offset = page.size();
         page.resize(page_max_size);
         auto flush_info = _val_encoder->flush(page.data() + data_offset);
         page.resize(data_offset + flush_info.size);
+        size_t uncompressed_page_size = page.size();
 
-        bytes compressed_page = _compressor->compress(page);
-
-        format::DataPageHeader data_page_header;
-        data_page_header.__set_num_values(_levels_in_current_page);
-        data_page_header.__set_encoding(flush_info.encoding);
-        data_page_header.__set_definition_level_encoding(format::Encoding::RLE);
-        data_page_header.__set_repetition_level_encoding(format::Encoding::RLE);
+        std::optional<format::Statistics> statistics;
+        if (_page_statistics) {
+            statistics = _page_statistics->build();
+            _chunk_statistics->merge(*_page_statistics);
+            _page_statistics->clear();
+        }
         format::PageHeader page_header;
-        page_header.__set_type(format::PageType::DATA_PAGE);
-        page_header.__set_uncompressed_page_size(page.size());
-        page_header.__set_compressed_page_size(compressed_page.size());
-        page_header.__set_data_page_header(data_page_header);
+        page_header.__set_uncompressed_page_size(uncompressed_page_size);
+        // compressed_page_size is set in flush_chunk, when the compressed page is ready.
+        std::optional<size_t> v2_levels_size;
+        if (_options.data_page_v2) {
+            v2_levels_size = data_offset;
+            format::DataPageHeaderV2 data_page_header;
+            data_page_header.__set_num_values(_levels_in_current_page);
+            data_page_header.__set_num_nulls(_levels_in_current_page - _values_in_current_page);
+            data_page_header.__set_num_rows(_rows_in_current_page);
+            data_page_header.__set_encoding(flush_info.encoding);
+            data_page_header.__set_definition_levels_byte_length(def_levels_size);
+            data_page_header.__set_repetition_levels_byte_length(rep_levels_size);
+            // is_compressed is set together with compressed_page_size.
+            if (statistics) {
+                data_page_header.__set_statistics(std::move(*statistics));
+            }
+            page_header.__set_type(format::PageType::DATA_PAGE_V2);
+            page_header.__set_data_page_header_v2(data_page_header);
+        } else {
+            format::DataPageHeader data_page_header;
+            data_page_header.__set_num_values(_levels_in_current_page);
+            data_page_header.__set_encoding(flush_info.encoding);
+            data_page_header.__set_definition_level_encoding(format::Encoding::RLE);
+            data_page_header.__set_repetition_level_encoding(format::Encoding::RLE);
+            if (statistics) {
+                data_page_header.__set_statistics(std::move(*statistics));
+            }
+            page_header.__set_type(format::PageType::DATA_PAGE);
+            page_header.__set_data_page_header(data_page_header);
+        }
+
+        if (_codec_selector && !_codec_selected) {
+            // Until the codec is selected, the uncompressed size is the best estimate we have.
+            _sizes->add(uncompressed_page_size);
+            _sampled_bytes += uncompressed_page_size;
+            _sampled_pages.push_back(sampled_page{{}, v2_levels_size});
+            _pages.push_back(_sampled_pages.back().compressed.get_future());
+            if (_options.compression_group) {
+                // The trial compressions are done in the background by select_codec().
+                _sampled_pages.back().page = std::move(page);
+            } else {
+                _codec_selector->sample(bytes_view(page).substr(v2_levels_size.value_or(0)));
+                if (v2_levels_size) {
+                    _sampled_pages.back().page = std::move(page);
+                }
+            }
+            if (_sampled_pages.size() >= _options.auto_compression->sample_pages) {
+                select_codec();
+            }
+        } else if (!_selected_codec && chunk_compressor().type() == format::CompressionCodec::UNCOMPRESSED) {
+            // Nothing to compress. The page is written from this buffer.
+            _sizes->add(uncompressed_page_size);
+            _pages.push_back(seastar::make_ready_future<bytes>(std::move(page)));
+        } else if (_options.compression_group) {
+            // Until the page is compressed, its uncompressed size is the best estimate we have.
+            _sizes->add(uncompressed_page_size);
+            _pages.push_back(compress_in_background(std::move(page), v2_levels_size));
+        } else {
+            bytes compressed_page = compress_page(chunk_compressor(), std::move(page), v2_levels_size);
+            _sizes->add(compressed_page.size());
+            _pages.push_back(seastar::make_ready_future<bytes>(std::move(compressed_page)));
+        }
 
-        _estimated_chunk_size += compressed_page.size();
+        _page_first_rows.push_back(_rows_written - _rows_in_current_page);
         _def_encoder.clear();
         _rep_encoder.clear();
         _levels_in_current_page = 0;
         _values_in_current_page = 0;
+        _rows_in_current_page = 0;
 
         _used_encodings.insert(flush_info.encoding);
+        if (flush_info.encoding != format::Encoding::RLE_DICTIONARY) {
+            _only_dictionary_pages = false;
+        }
         _page_headers.push_back(std::move(page_header));
-        _pages.push_back(std::move(compressed_page));
+        if (_on_page_flushed) {
+            _on_page_flushed();
+        }
+    }
+
+    // Set a callback to be called after every page flush, including the automatic ones
+    // in put() and put_batch().
+    void on_page_flushed(std::function<void()> callback) {
+        _on_page_flushed = std::move(callback);
     }
 
     seastar::future<seastar::lw_shared_ptr<format::ColumnMetaData>> flush_chunk(seastar::output_stream<char>& sink) {
         if (_levels_in_current_page > 0) {
             flush_page();
         }
+        if (_codec_selector && !_codec_selected) {
+            select_codec();
+        }
         auto metadata = seastar::make_lw_shared<format::ColumnMetaData>();
         metadata->__set_type(ParquetType);
         metadata->__set_encodings(
                 std::vector<format::Encoding::type>(
                         _used_encodings.begin(), _used_encodings.end()));
-        metadata->__set_codec(_compressor->type());
         metadata->__set_num_values(0);
         metadata->__set_total_compressed_size(0);
         metadata->__set_total_uncompressed_size(0);
+        if (_chunk_statistics) {
+            format::Statistics statistics = _chunk_statistics->build();
+            if (_only_dictionary_pages && !_page_headers.empty()) {
+                statistics.__set_distinct_count(_val_encoder->cardinality());
+            }
+            metadata->__set_statistics(std::move(statistics));
+            _chunk_statistics->clear();
+        }
 
         auto write_page = [this, metadata, &sink] (const format::PageHeader& header, bytes_view contents) {
             bytes_view serialized_header = _thrift_serializer.serialize(header);
-            metadata->total_uncompressed_size += serialized_header.size();
-            metadata->total_uncompressed_size += header.uncompressed_page_size;
-            metadata->total_compressed_size += serialized_header.size();
-            metadata->total_compressed_size += header.compressed_page_size;
+            account_page(*metadata, header, serialized_header.size());
 
             const char* data = reinterpret_cast<const char*>(serialized_header.data());
             return sink.write(data, serialized_header.size()).then([this, contents, &sink] {
@@ -166,57 +468,413 @@ public:
             });
         };
 
-        return [this, metadata, write_page, &sink] {
-            if (_val_encoder->view_dict()) {
-                fill_dictionary_page();
-                metadata->__set_dictionary_page_offset(metadata->total_compressed_size);
-                return write_page(_dict_page_header, _dict_page);
+        return current_codec().then([this, metadata, write_page] (format::CompressionCodec::type codec) {
+            if (_selected_codec) {
+                _chunk_compressor = compressor::make(codec);
+                _selected_codec.reset();
+            }
+            metadata->__set_codec(chunk_compressor().type());
+            // If the encoder fell back to plain before the first page, the dictionary isn't needed.
+            if (_used_encodings.count(format::Encoding::RLE_DICTIONARY)) {
+                return fill_dictionary_page().then([this, metadata, write_page] {
+                    metadata->__set_dictionary_page_offset(metadata->total_compressed_size);
+                    return write_page(_dict_page_header, _dict_page);
+                });
             } else {
                 return seastar::make_ready_future<>();
             }
-        }().then([this, write_page, metadata, &sink] {
+        }).then([this, metadata, &sink] {
             metadata->__set_data_page_offset(metadata->total_compressed_size);
+            if (!_spill) {
+                return seastar::make_ready_future<>();
+            }
+            for (size_t i = 0; i < _spilled_pages; ++i) {
+                account_page(*metadata, _page_headers[i], _thrift_serializer.serialize(_page_headers[i]).size());
+            }
+            return _spill->copy_to(sink);
+        }).then([this, write_page, metadata, &sink] {
             using it = boost::counting_iterator<size_t>;
-            return seastar::do_for_each(it(0), it(_page_headers.size()),
+            return seastar::do_for_each(it(_spilled_pages), it(_page_headers.size()),
                 [this, metadata, write_page, &sink] (size_t i) {
-                metadata->num_values += _page_headers[i].data_page_header.num_values;
-                return write_page(_page_headers[i], _pages[i]);
+                return std::move(_pages[i]).then([this, i, metadata, write_page] (bytes compressed_page) {
+                    set_compressed_page_size(_page_headers[i], compressed_page.size());
+                    return seastar::do_with(std::move(compressed_page), [this, i, write_page] (bytes& contents) {
+                        return write_page(_page_headers[i], contents);
+                    });
+                });
             });
         }).then([this, metadata] {
+            _page_index.column_index = build_column_index();
+            _page_index.offset_index.__set_page_locations(std::move(_page_locations));
             _pages.clear();
+            _spilled_pages = 0;
             _page_headers.clear();
-            _estimated_chunk_size = 0;
+            *_sizes = page_sizes{};
+            _codec_selected = false;
+            _chunk_compressor.reset();
+            _page_locations.clear();
+            _page_first_rows.clear();
+            if (_bloom_filter) {
+                std::swap(_bloom_filter, _flushed_bloom_filter);
+                _bloom_filter->clear();
+            }
+            _rows_written = 0;
+            _val_encoder->reset_dict();
+            _used_encodings.clear();
+            _only_dictionary_pages = true;
             return metadata;
         });
     }
 
+    // Move the pages buffered in memory to a temporary file, to be copied from there by flush_chunk.
+    // Requires column_chunk_writer_options::spill_directory.
+    seastar::future<> spill() {
+        if (!_options.spill_directory) {
+            return seastar::make_exception_future<>(
+                    parquet_exception("spill() requires column_chunk_writer_options::spill_directory"));
+        }
+        if (_codec_selector && !_codec_selected) {
+            // Sample pages can't be written before the codec is known.
+            select_codec();
+        }
+        if (_spilled_pages == _pages.size()) {
+            return seastar::make_ready_future<>();
+        }
+        return [this] {
+            if (_spill) {
+                return seastar::make_ready_future<>();
+            }
+            return spill_file::open(*_options.spill_directory).then([this] (spill_file f) {
+                _spill = std::move(f);
+            });
+        }().then([this] {
+            using it = boost::counting_iterator<size_t>;
+            size_t pages_to_spill = _pages.size();
+            return seastar::do_for_each(it(_spilled_pages), it(pages_to_spill), [this] (size_t i) {
+                return std::move(_pages[i]).then([this, i] (bytes compressed_page) {
+                    set_compressed_page_size(_page_headers[i], compressed_page.size());
+                    _sizes->buffered_size -= compressed_page.size();
+                    bytes header{_thrift_serializer.serialize(_page_headers[i])};
+                    return seastar::do_with(std::move(header), std::move(compressed_page),
+                    [this] (bytes& header, bytes& contents) {
+                        return _spill->write(header).then([this, &contents] {
+                            return _spill->write(contents);
+                        });
+                    });
+                });
+            }).then([this, pages_to_spill] {
+                _spilled_pages = pages_to_spill;
+            });
+        });
+    }
+
+    // The bloom filter of the last chunk flushed with flush_chunk(), if enabled.
+    // Valid until the next flush_chunk().
+    const bloom_filter* flushed_bloom_filter() const {
+        return _flushed_bloom_filter ? &*_flushed_bloom_filter : nullptr;
+    }
+
+    // The page index of the last chunk flushed with flush_chunk().
+    page_index take_page_index() {
+        return std::exchange(_page_index, page_index{});
+    }
+
+    // Resolves when a page flushed now would start compressing in the background right away.
+    // Pages flushed while all max_pages_in_compression slots are taken wait uncompressed,
+    // so a caller which flushes pages faster than they are compressed should wait for this
+    // (e.g. through file_writer::maybe_flush_row_group()) to keep memory bounded.
+    seastar::future<> backpressure() {
+        if (!_compression_slots) {
+            return seastar::make_ready_future<>();
+        }
+        return seastar::get_units(*_compression_slots, 1).discard_result();
+    }
+
+    seastar::future<> close() {
+        if (_spill) {
+            return _spill->close();
+        }
+        return seastar::make_ready_future<>();
+    }
+
+    // The number of rows in the current chunk.
     size_t rows_written() const { return _rows_written; }
-    size_t estimated_chunk_size() const { return _estimated_chunk_size; }
+    // Includes the current (unflushed) page.
+    size_t estimated_chunk_size() const { return _sizes->estimated_chunk_size + current_page_max_size(); }
+    // The memory held by the data pages of the current chunk: the flushed pages which weren't spilled
+    // (pages waiting for compression are counted with their uncompressed size) and the current page.
+    // The dictionary and the bloom filter aren't counted.
+    size_t buffered_size() const { return _sizes->buffered_size + current_page_max_size(); }
+    // The part of buffered_size() which spill() moves to disk, i.e. all of it but the current page.
+    size_t spillable_size() const { return _sizes->buffered_size; }
 
 private:
-    void fill_dictionary_page() {
+    bool page_is_full() const {
+        return _rows_in_current_page >= _options.max_rows_per_page
+                || current_page_max_size() >= _options.target_page_size;
+    }
+
+    // An estimate of the number of rows which can be added to the current page, based on the
+    // average row size so far. The first row of a page is measured alone.
+    size_t rows_until_page_full() const {
+        if (_rows_in_current_page >= _options.max_rows_per_page) {
+            return 0;
+        }
+        size_t rows = _options.max_rows_per_page - _rows_in_current_page;
+        if (_rows_in_current_page == 0) {
+            return std::min<size_t>(rows, 1);
+        }
+        size_t size = current_page_max_size();
+        if (size >= _options.target_page_size) {
+            return 0;
+        }
+        size_t row_size = std::max<size_t>(size / _rows_in_current_page, 1);
+        return std::min(rows, (_options.target_page_size - size + row_size - 1) / row_size);
+    }
+
+    void account_page(format::ColumnMetaData& metadata, const format::PageHeader& header, size_t header_size) {
+        int64_t offset = metadata.total_compressed_size;
+        metadata.total_uncompressed_size += header_size;
+        metadata.total_uncompressed_size += header.uncompressed_page_size;
+        metadata.total_compressed_size += header_size;
+        metadata.total_compressed_size += header.compressed_page_size;
+        if (header.__isset.data_page_header || header.__isset.data_page_header_v2) {
+            metadata.num_values += header.__isset.data_page_header_v2
+                    ? header.data_page_header_v2.num_values
+                    : header.data_page_header.num_values;
+            format::PageLocation location;
+            location.__set_offset(offset);
+            location.__set_compressed_page_size(metadata.total_compressed_size - offset);
+            location.__set_first_row_index(_page_first_rows[_page_locations.size()]);
+            _page_locations.push_back(std::move(location));
+        }
+    }
+
+    std::optional<format::ColumnIndex> build_column_index() const {
+        if (!_chunk_statistics) {
+            return {};
+        }
+        format::ColumnIndex index;
+        bool ascending = true;
+        bool descending = true;
+        const std::string* last_min = nullptr;
+        const std::string* last_max = nullptr;
+        for (const format::PageHeader& header : _page_headers) {
+            bool v2 = header.__isset.data_page_header_v2;
+            const format::Statistics& stats = v2 ? header.data_page_header_v2.statistics : header.data_page_header.statistics;
+            int32_t num_values = v2 ? header.data_page_header_v2.num_values : header.data_page_header.num_values;
+            bool null_page = stats.null_count == num_values;
+            if (!null_page && !stats.__isset.min_value) {
+                return {};
+            }
+            index.null_pages.push_back(null_page);
+            index.null_counts.push_back(stats.null_count);
+            // Null pages have empty min and max.
+            index.min_values.push_back(null_page ? std::string() : stats.min_value);
+            index.max_values.push_back(null_page ? std::string() : stats.max_value);
+            if (null_page) {
+                continue;
+            }
+            if (last_min) {
+                const auto& b = *_chunk_statistics;
+                ascending = ascending && !b.less_encoded(stats.min_value, *last_min)
+                        && !b.less_encoded(stats.max_value, *last_max);
+                descending = descending && !b.less_encoded(*last_min, stats.min_value)
+                        && !b.less_encoded(*last_max, stats.max_value);
+            }
+            last_min = &stats.min_value;
+            last_max = &stats.max_value;
+        }
+        index.__isset.null_counts = true;
+        index.__set_boundary_order(ascending ? format::BoundaryOrder::ASCENDING
+                : descending ? format::BoundaryOrder::DESCENDING
+                : format::BoundaryOrder::UNORDERED);
+        return index;
+    }
+
+    // Decide the codec of the current chunk and release the sample pages compressed with it.
+    void select_codec() {
+        if (_options.compression_group) {
+            select_codec_in_background();
+            return;
+        }
+        codec_selector::selection selection = _codec_selector->select();
+        if (selection.codec) {
+            _chunk_compressor = std::move(selection.codec);
+        }
+        _sizes->estimated_chunk_size -= _sampled_bytes;
+        _sizes->buffered_size -= _sampled_bytes;
+        for (size_t i = 0; i < _sampled_pages.size(); ++i) {
+            sampled_page& sample = _sampled_pages[i];
+            bytes compressed_page = std::move(selection.compressed_samples[i]);
+            if (sample.v2_levels_size) {
+                compressed_page = assemble_page_v2(std::move(sample.page), *sample.v2_levels_size, std::move(compressed_page));
+            }
+            _sizes->add(compressed_page.size());
+            sample.compressed.set_value(std::move(compressed_page));
+        }
+        _sampled_pages.clear();
+        _sampled_bytes = 0;
+        _codec_selected = true;
+    }
+
+    // Like select_codec(), but the samples are compressed with the candidates in the compression group,
+    // taking one compression slot. Like compress_in_background(), the task owns everything it uses.
+    // Pages flushed before it's done wait for the codec (see current_codec()).
+    void select_codec_in_background() {
+        struct selection_task {
+            codec_selector selector;
+            std::vector<sampled_page> samples;
+            size_t released = 0;
+        };
+        auto task = std::make_unique<selection_task>(
+                selection_task{codec_selector{*_options.auto_compression}, std::move(_sampled_pages)});
+        _sampled_pages.clear();
+        _sampled_bytes = 0;
+        _codec_selected = true;
+        seastar::future<format::CompressionCodec::type> codec = seastar::do_with(_compression_slots, std::move(task),
+        [group = *_options.compression_group, sizes = _sizes, fallback = _compressor->type()]
+        (seastar::lw_shared_ptr<seastar::semaphore>& slots, std::unique_ptr<selection_task>& task) {
+            return seastar::with_semaphore(*slots, 1, [group, &task] {
+                return seastar::with_scheduling_group(group, [&task] {
+                    return seastar::do_for_each(task->samples, [&task] (sampled_page& sample) {
+                        bytes_view values = bytes_view(sample.page).substr(sample.v2_levels_size.value_or(0));
+                        return task->selector.sample_preemptible(values);
+                    });
+                });
+            }).then([&task, sizes, fallback] {
+                codec_selector::selection selection = task->selector.select();
+                for (sampled_page& sample : task->samples) {
+                    size_t uncompressed_size = sample.page.size();
+                    bytes compressed_page = std::move(selection.compressed_samples[task->released]);
+                    if (sample.v2_levels_size) {
+                        compressed_page = assemble_page_v2(
+                                std::move(sample.page), *sample.v2_levels_size, std::move(compressed_page));
+                    }
+                    sizes->replace(uncompressed_size, compressed_page.size());
+                    sample.compressed.set_value(std::move(compressed_page));
+                    ++task->released;
+                }
+                return selection.codec ? selection.codec->type() : fallback;
+            }).handle_exception([&task] (std::exception_ptr eptr) {
+                for (size_t i = task->released; i < task->samples.size(); ++i) {
+                    task->samples[i].compressed.set_exception(eptr);
+                }
+                return seastar::make_exception_future<format::CompressionCodec::type>(eptr);
+            });
+        });
+        _selected_codec.emplace(std::move(codec));
+    }
+
+    // The codec of the pages of the current chunk which aren't samples.
+    seastar::future<format::CompressionCodec::type> current_codec() {
+        if (_selected_codec) {
+            return _selected_codec->get_future();
+        }
+        return seastar::make_ready_future<format::CompressionCodec::type>(chunk_compressor().type());
+    }
+
+    // The compressor of the pages of the current chunk, once its codec is known.
+    const compressor& chunk_compressor() const {
+        return _chunk_compressor ? *_chunk_compressor : *_compressor;
+    }
+
+    // The compression task owns everything it uses (including a compressor of its own),
+    // so it doesn't depend on the lifetime of the writer. It waits for the codec and for a slot first.
+    seastar::future<bytes> compress_in_background(bytes page, std::optional<size_t> v2_levels_size) {
+        size_t uncompressed_size = page.size();
+        return current_codec().then(
+        [slots = _compression_slots, group = *_options.compression_group, page = std::move(page), v2_levels_size]
+        (format::CompressionCodec::type codec) mutable {
+            return seastar::do_with(std::move(slots),
+            [group, codec, page = std::move(page), v2_levels_size] (seastar::lw_shared_ptr<seastar::semaphore>& slots) mutable {
+                return seastar::with_semaphore(*slots, 1, [group, codec, page = std::move(page), v2_levels_size] () mutable {
+                    return seastar::with_scheduling_group(group,
+                    [codec, page = std::move(page), v2_levels_size] () mutable {
+                        return seastar::do_with(std::move(page), compressor::make(codec),
+                        [v2_levels_size] (bytes& page, std::unique_ptr<compressor>& c) {
+                            if (!v2_levels_size) {
+                                return c->compress_preemptible(page);
+                            }
+                            return c->compress_preemptible(bytes_view(page).substr(*v2_levels_size)).then(
+                            [&page, v2_levels_size] (bytes compressed_values) {
+                                return assemble_page_v2(std::move(page), *v2_levels_size, std::move(compressed_values));
+                            });
+                        });
+                    });
+                });
+            });
+        }).then([sizes = _sizes, uncompressed_size] (bytes compressed_page) {
+            sizes->replace(uncompressed_size, compressed_page.size());
+            return compressed_page;
+        });
+    }
+
+    // In DATA_PAGE_V2 only the values, which follow the levels, are compressed.
+    static bytes compress_page(const compressor& c, bytes page, std::optional<size_t> v2_levels_size) {
+        if (!v2_levels_size) {
+            return c.compress(page);
+        }
+        bytes compressed_values = c.compress(bytes_view(page).substr(*v2_levels_size));
+        return assemble_page_v2(std::move(page), *v2_levels_size, std::move(compressed_values));
+    }
+
+    // Values which don't get smaller are stored uncompressed. Otherwise the compressed values
+    // replace the uncompressed ones in the buffer of the page.
+    static bytes assemble_page_v2(bytes page, size_t levels_size, bytes compressed_values) {
+        if (compressed_values.size() >= page.size() - levels_size) {
+            return page;
+        }
+        page.resize(levels_size);
+        page.append(compressed_values);
+        return page;
+    }
+
+    void set_compressed_page_size(format::PageHeader& header, size_t size) {
+        header.__set_compressed_page_size(size);
+        if (header.__isset.data_page_header_v2) {
+            // See assemble_page_v2(). Only uncompressed pages keep their size.
+            header.data_page_header_v2.__set_is_compressed(size < static_cast<size_t>(header.uncompressed_page_size));
+        }
+    }
+
+    // With a compression group, the dictionary is compressed there, taking a compression slot,
+    // like the data pages in compress_in_background().
+    seastar::future<> fill_dictionary_page() {
         bytes_view dict = *_val_encoder->view_dict();
-        _dict_page = _compressor->compress(dict);
+        return [this, dict] {
+            if (!_options.compression_group) {
+                return seastar::make_ready_future<bytes>(chunk_compressor().compress(dict));
+            }
+            return seastar::with_semaphore(*_compression_slots, 1, [this, dict] {
+                return seastar::with_scheduling_group(*_options.compression_group, [this, dict] {
+                    return chunk_compressor().compress_preemptible(dict);
+                });
+            });
+        }().then([this, dict] (bytes compressed_dict) {
+            _dict_page = std::move(compressed_dict);
 
-        format::DictionaryPageHeader dictionary_page_header;
-        dictionary_page_header.__set_num_values(_val_encoder->cardinality());
-        dictionary_page_header.__set_encoding(format::Encoding::PLAIN);
-        dictionary_page_header.__set_is_sorted(false);
-        _dict_page_header.__set_type(format::PageType::DICTIONARY_PAGE);
-        _dict_page_header.__set_uncompressed_page_size(dict.size());
-        _dict_page_header.__set_compressed_page_size(_dict_page.size());
-        _dict_page_header.__set_dictionary_page_header(dictionary_page_header);
+            format::DictionaryPageHeader dictionary_page_header;
+            dictionary_page_header.__set_num_values(_val_encoder->cardinality());
+            dictionary_page_header.__set_encoding(format::Encoding::PLAIN);
+            dictionary_page_header.__set_is_sorted(false);
+            _dict_page_header.__set_type(format::PageType::DICTIONARY_PAGE);
+            _dict_page_header.__set_uncompressed_page_size(dict.size());
+            _dict_page_header.__set_compressed_page_size(_dict_page.size());
+            _dict_page_header.__set_dictionary_page_header(dictionary_page_header);
+        });
     }
 };
 
 template <format::Type::type ParquetType>
 column_chunk_writer<ParquetType>
-make_column_chunk_writer(const writer_options& options) {
+make_column_chunk_writer(const writer_options& options, const column_chunk_writer_options& chunk_options = {}) {
     return column_chunk_writer<ParquetType>(
             options.def_level,
             options.rep_level,
-            make_value_encoder<ParquetType>(options.encoding),
-            compressor::make(options.compression));
+            make_value_encoder<ParquetType>(options.encoding, options.max_dictionary_size),
+            compressor::make(options.compression),
+            chunk_options);
 }
 
 } // namespace parquet4seastar
@@ -22,8 +22,11 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <memory>
+#include <vector>
 #include <parquet4seastar/bytes.hh>
 #include <parquet4seastar/parquet_types.h>
+#include <seastar/core/future.hh>
 
 namespace parquet4seastar {
 
@@ -37,6 +40,16 @@ public:
     // out will be resized appropriately to hold the compressed data.
     virtual bytes compress(bytes_view in, bytes&& out = bytes()) const = 0;
 
+    // Same as compress, but may yield to the reactor between fragments of the input,
+    // so that compressing a big page doesn't stall the shard.
+    // in has to stay alive until the returned future resolves.
+    // The default implementation compresses the input in one go.
+    // If cpu_seconds is given, the CPU time spent compressing is added to it. Unlike the time until
+    // the future resolves, it doesn't include the tasks which ran while the compression yielded.
+    // cpu_seconds has to stay alive until the returned future resolves.
+    virtual seastar::future<bytes> compress_preemptible(
+            bytes_view in, bytes&& out = bytes(), double* cpu_seconds = nullptr) const;
+
     virtual format::CompressionCodec::type type() const = 0;
 
     static std::unique_ptr<compressor> make(format::CompressionCodec::type compression);
@@ -44,4 +57,53 @@ public:
     virtual ~compressor() = default;
 };
 
+// Parameters of the automatic choice of a codec for a column chunk.
+struct codec_selection_options {
+    // The codecs to choose from.
+    std::vector<format::CompressionCodec::type> candidates = {
+        format::CompressionCodec::UNCOMPRESSED,
+        format::CompressionCodec::SNAPPY,
+        format::CompressionCodec::GZIP,
+    };
+    // The number of leading pages of each column chunk which are compressed with every candidate.
+    size_t sample_pages = 2;
+    // The CPU/size trade-off: how many bytes of output one second of compression time is worth.
+    // The candidate minimizing (compressed size + compression time * bytes_per_cpu_second) wins.
+    // Low values favour fast codecs, high values favour strong ones.
+    double bytes_per_cpu_second = 10 * 1024 * 1024;
+};
+
+// Compresses sample pages with every candidate codec, measuring the ratio and the throughput
+// of each, and then picks the codec best suited for the sampled data.
+class codec_selector {
+    struct candidate {
+        std::unique_ptr<compressor> codec;
+        std::vector<bytes> compressed_samples;
+        size_t compressed_size = 0;
+        double seconds = 0;
+    };
+    codec_selection_options _options;
+    std::vector<candidate> _candidates;
+    size_t _samples = 0;
+public:
+    explicit codec_selector(codec_selection_options options);
+    // Compress the page with every candidate.
+    void sample(bytes_view page);
+    // Like sample(), but with compress_preemptible(). Only the CPU time of the compression
+    // itself is measured, not whatever ran while it yielded.
+    // page has to stay alive until the returned future resolves.
+    seastar::future<> sample_preemptible(bytes_view page);
+    size_t samples() const { return _samples; }
+    bool enough_samples() const { return _samples >= _options.sample_pages; }
+
+    struct selection {
+        // Null if there were no samples.
+        std::unique_ptr<compressor> codec;
+        // The sample pages, compressed with the selected codec, in order of sampling.
+        std::vector<bytes> compressed_samples;
+    };
+    // Pick a codec and start over, ready to select the codec of the next column chunk.
+    selection select();
+};
+
 } // namespace
@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <parquet4seastar/arena.hh>
 #include <parquet4seastar/bytes.hh>
 #include <parquet4seastar/thrift_serdes.hh>
 #include <parquet4seastar/overloaded.hh>
@@ -28,6 +29,7 @@
 #include <parquet4seastar/rle_encoding.hh>
 #include <seastar/core/temporary_buffer.hh>
 #include <seastar/core/bitops.hh>
+#include <cstdint>
 #include <variant>
 
 namespace parquet4seastar {
@@ -143,6 +145,20 @@ public:
     virtual void reset(bytes_view buf) = 0;
     // Read a batch of n values (the last batch may be smaller than n).
     virtual size_t read_batch(size_t n, output_type out[]) = 0;
+    // Byte arrays only. Like read_batch, but the values don't own their memory (see unowned_buffer()).
+    // It belongs to the dictionary or to the arena, which may keep the page alive.
+    virtual size_t read_batch_unowned(size_t n, output_type out[], byte_arena& arena) {
+        if constexpr (std::is_same_v<output_type, seastar::temporary_buffer<byte>>) {
+            // Decoders which have to materialize the values copy them to the arena.
+            size_t n_read = read_batch(n, out);
+            for (size_t i = 0; i < n_read; ++i) {
+                out[i] = unowned_buffer(arena.copy(bytes_view{out[i].get(), out[i].size()}));
+            }
+            return n_read;
+        } else {
+            return read_batch(n, out);
+        }
+    }
     virtual ~decoder() = default;
 };
 
@@ -172,6 +188,9 @@ public:
     void reset(bytes_view buf, format::Encoding::type encoding);
     // Read a batch of n values (the last batch may be smaller than n).
     size_t read_batch(size_t n, output_type out[]);
+    // Like read_batch, but byte array values don't own their memory.
+    // They stay valid until the arena is cleared (values from the dictionary: until it is reset).
+    size_t read_batch_unowned(size_t n, output_type out[], byte_arena& arena);
 };
 
 extern template class value_decoder<format::Type::INT32>;
@@ -196,12 +215,18 @@ public:
     virtual flush_result flush(byte sink[]) = 0;
     virtual std::optional<bytes_view> view_dict() { return {}; };
     virtual uint64_t cardinality() { return 0; }
+    // Start a new, empty dictionary. Called after the dictionary page of a column chunk is written.
+    virtual void reset_dict() {}
     virtual ~value_encoder() = default;
 };
 
+// RLE_DICTIONARY falls back to PLAIN for the rest of the column chunk
+// when the dictionary page would grow beyond this size.
+constexpr size_t default_max_dictionary_size = 1024 * 1024;
+
 template <format::Type::type ParquetType>
 std::unique_ptr<value_encoder<ParquetType>>
-make_value_encoder(format::Encoding::type encoding);
+make_value_encoder(format::Encoding::type encoding, size_t max_dictionary_size = default_max_dictionary_size);
 
 class rle_builder {
     size_t _buffer_offset = 0;
@@ -225,9 +250,28 @@ public:
                     static_cast<int>(_bit_width)};
         }
     }
-    void put_batch(const uint64_t data[], size_t size) {
-        for (size_t i = 0; i < size; ++i) {
-            put(data[i]);
+    // Long runs of equal values are added to the encoder at once.
+    template <typename T>
+    void put_batch(const T data[], size_t size) {
+        size_t i = 0;
+        while (i < size) {
+            size_t run_end = i + 1;
+            while (run_end < size && data[run_end] == data[i]) {
+                ++run_end;
+            }
+            put_run(data[i], run_end - i);
+            i = run_end;
+        }
+    }
+    void put_run(uint64_t value, size_t count) {
+        while (count > 0) {
+            int n = _encoder.PutRepeated(value, static_cast<int>(std::min<size_t>(count, INT32_MAX)));
+            if (n > 0) {
+                count -= n;
+            } else {
+                put(value);
+                --count;
+            }
         }
     }
     void clear() {
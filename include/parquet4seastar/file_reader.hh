@@ -22,37 +22,60 @@
 #pragma once
 
 #include <parquet4seastar/column_chunk_reader.hh>
+#include <parquet4seastar/io.hh>
 #include <parquet4seastar/reader_schema.hh>
+#include <parquet4seastar/thrift_compact.hh>
 #include <seastar/core/file.hh>
+#include <unordered_map>
 
 namespace parquet4seastar {
 
 class file_reader {
     std::string _path;
+    // Unset if the reader wasn't opened from a file.
     seastar::file _file;
+    seastar::shared_ptr<random_access_source> _source;
+    // The footer is decoded without the column chunks, which are decoded when first used.
+    seastar::temporary_buffer<uint8_t> _serialized_metadata;
+    std::unique_ptr<thrift_compact::lazy_file_metadata> _lazy_metadata;
+    std::unordered_map<uint64_t, std::unique_ptr<format::ColumnChunk>> _column_chunks;
     std::unique_ptr<format::FileMetaData> _metadata;
     std::unique_ptr<reader_schema::schema> _schema;
     std::unique_ptr<reader_schema::raw_schema> _raw_schema;
 private:
     file_reader() {};
-    static seastar::future<std::unique_ptr<format::FileMetaData>> read_file_metadata(seastar::file file);
+    static seastar::future<seastar::temporary_buffer<uint8_t>>
+    read_serialized_metadata(seastar::shared_ptr<random_access_source> source);
+    void set_serialized_metadata(seastar::temporary_buffer<uint8_t> serialized);
     template <format::Type::type T>
-    seastar::future<column_chunk_reader<T>>
-    open_column_chunk_reader_internal(uint32_t row_group, uint32_t column);
+    seastar::future<std::pair<column_chunk_reader<T>, uint64_t>>
+    open_column_chunk_reader_internal(uint32_t row_group, uint32_t column, uint64_t row);
 public:
     // The entry point to this library.
     static seastar::future<file_reader> open(std::string path);
-    seastar::future<> close() { return _file.close(); };
+    // Reads the file from the source, e.g. one made by make_memory_source().
+    // Column chunks stored in other files (ColumnChunk.file_path) are unsupported.
+    static seastar::future<file_reader> open(seastar::shared_ptr<random_access_source> source);
+    seastar::future<> close() { return _source->close(); };
+    // Empty if the reader wasn't opened from a file.
     const std::string& path() const { return _path; }
     seastar::file file() const { return _file; }
-    const format::FileMetaData& metadata() const { return *_metadata; }
+    random_access_source& source() const { return *_source; }
+    // The whole FileMetaData. For files with many columns, it's much cheaper to use
+    // shallow_metadata() and column_chunk(), which decode only the column chunks in use.
+    const format::FileMetaData& metadata();
+    // FileMetaData without the columns of its row groups (RowGroup::columns are empty).
+    const format::FileMetaData& shallow_metadata() const { return _lazy_metadata->metadata; }
+    uint32_t column_chunk_count(uint32_t row_group) const;
+    // Decodes the column chunk on first use. Throws if there is no such chunk.
+    const format::ColumnChunk& column_chunk(uint32_t row_group, uint32_t column);
     // The schemata are computed lazily (not on open) for robustness.
     // This way lower-level operations (i.e. inspecting metadata,
     // reading raw data with column_chunk_reader) can be done even if
     // higher level metadata cannot be understood/validated by our reader.
     const reader_schema::raw_schema& raw_schema() {
         if (!_raw_schema) {
-            _raw_schema = std::make_unique<reader_schema::raw_schema>(reader_schema::flat_schema_to_raw_schema(metadata().schema));
+            _raw_schema = std::make_unique<reader_schema::raw_schema>(reader_schema::flat_schema_to_raw_schema(shallow_metadata().schema));
         }
         return *_raw_schema;
     }
@@ -65,6 +88,12 @@ public:
 
     template <format::Type::type T>
     seastar::future<column_chunk_reader<T>> open_column_chunk_reader(uint32_t row_group, uint32_t column);
+    // Like open_column_chunk_reader(), but if the chunk has an offset index, the reader starts
+    // at the page containing the given row of the row group (after the dictionary page).
+    // Also returns the number of rows before the first page read.
+    template <format::Type::type T>
+    seastar::future<std::pair<column_chunk_reader<T>, uint64_t>>
+    open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
 };
 
 extern template seastar::future<column_chunk_reader<format::Type::INT32>>
@@ -83,5 +112,21 @@ extern template seastar::future<column_chunk_reader<format::Type::BYTE_ARRAY>>
 file_reader::open_column_chunk_reader(uint32_t row_group, uint32_t column);
 extern template seastar::future<column_chunk_reader<format::Type::FIXED_LEN_BYTE_ARRAY>>
 file_reader::open_column_chunk_reader(uint32_t row_group, uint32_t column);
+extern template seastar::future<std::pair<column_chunk_reader<format::Type::INT32>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+extern template seastar::future<std::pair<column_chunk_reader<format::Type::INT64>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+extern template seastar::future<std::pair<column_chunk_reader<format::Type::INT96>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+extern template seastar::future<std::pair<column_chunk_reader<format::Type::FLOAT>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+extern template seastar::future<std::pair<column_chunk_reader<format::Type::DOUBLE>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+extern template seastar::future<std::pair<column_chunk_reader<format::Type::BOOLEAN>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+extern template seastar::future<std::pair<column_chunk_reader<format::Type::BYTE_ARRAY>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+extern template seastar::future<std::pair<column_chunk_reader<format::Type::FIXED_LEN_BYTE_ARRAY>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
 
 } // namespace parquet4seastar
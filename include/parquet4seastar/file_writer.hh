@@ -22,95 +22,368 @@
 #pragma once
 
 #include <parquet4seastar/column_chunk_writer.hh>
+#include <parquet4seastar/io.hh>
 #include <parquet4seastar/writer_schema.hh>
 #include <parquet4seastar/y_combinator.hh>
 #include <seastar/core/seastar.hh>
+#include <seastar/core/fstream.hh>
+#include <seastar/core/semaphore.hh>
 
 namespace parquet4seastar {
 
+// Large buffers with a few of them in flight, so that the file is written
+// with few, big DMA writes.
+inline seastar::file_output_stream_options default_file_output_stream_options() {
+    seastar::file_output_stream_options options;
+    options.buffer_size = 1024 * 1024;
+    options.write_behind = 4;
+    return options;
+}
+
+struct file_writer_options {
+    // Applied to the writers of all columns.
+    column_chunk_writer_options column_options;
+    // If set, the pages buffered in memory by all columns (see file_writer::buffered_size())
+    // are kept under this size by moving the pages of the largest columns to temporary files
+    // in column_options.spill_directory, which is then required. The budget is checked after
+    // every page flush and spilling runs in the background, so it can be exceeded by the pages
+    // flushed until the spill catches up (maybe_flush_row_group() waits for it) and by the
+    // current pages of the columns, which can't be spilled.
+    std::optional<size_t> memory_budget;
+    // maybe_flush_row_group() starts a new row group when the estimated size
+    // of the current one reaches this.
+    size_t target_row_group_size = 128 * 1024 * 1024;
+    // Buffer size, write-behind, preallocation step and I/O priority class of the writes to the file.
+    seastar::file_output_stream_options output_stream_options = default_file_output_stream_options();
+    // If set, this much space is allocated (fallocate) for the file when it is opened,
+    // so that it is laid out contiguously on disk. The size of the file isn't affected.
+    std::optional<uint64_t> expected_file_size;
+};
+
+using column_chunk_writer_variant = std::variant<
+    column_chunk_writer<format::Type::BOOLEAN>,
+    column_chunk_writer<format::Type::INT32>,
+    column_chunk_writer<format::Type::INT64>,
+    column_chunk_writer<format::Type::FLOAT>,
+    column_chunk_writer<format::Type::DOUBLE>,
+    column_chunk_writer<format::Type::BYTE_ARRAY>,
+    column_chunk_writer<format::Type::FIXED_LEN_BYTE_ARRAY>
+>;
+
+// Everything needed to create the writer of a column.
+struct column_writer_config {
+    format::Type::type type;
+    writer_options options;
+    column_chunk_writer_options chunk_options;
+};
+
+// The configs of the writers of all leaves of the schema, in column order.
+inline std::vector<column_writer_config>
+column_writer_configs(const writer_schema::schema& root, const column_chunk_writer_options& defaults) {
+    using namespace writer_schema;
+    std::vector<column_writer_config> configs;
+    auto convert = y_combinator{[&](auto&& convert, const node& node_variant, uint32_t def, uint32_t rep) -> void {
+        std::visit(overloaded {
+            [&] (const list_node& x) { convert(*x.element, def + 1 + x.optional, rep + 1); },
+            [&] (const map_node& x) {
+                convert(*x.key, def + 1 + x.optional, rep + 1);
+                convert(*x.value, def + 1 + x.optional, rep + 1);
+            },
+            [&] (const struct_node& x) {
+                for (const node& child : x.fields) {
+                    convert(child, def + x.optional, rep);
+                }
+            },
+            [&] (const primitive_node& x) {
+                logical_type::sort_order order = logical_type::get_sort_order(x.logical_type);
+                std::visit(overloaded {
+                    [&] (logical_type::INT96 logical_type) {
+                        throw parquet_exception("INT96 is deprecated. Writing INT96 is unsupported.");
+                    },
+                    [&] (auto logical_type) {
+                        constexpr format::Type::type parquet_type = decltype(logical_type)::physical_type;
+                        writer_options options = {def + x.optional, rep, x.encoding, x.compression, x.max_dictionary_size};
+                        column_chunk_writer_options column_options = defaults;
+                        if (x.auto_compression) {
+                            column_options.auto_compression = x.auto_compression;
+                        }
+                        if (column_options.statistics) {
+                            column_options.statistics->sort_order = order;
+                        }
+                        if (x.bloom_filter) {
+                            if (parquet_type == format::Type::BOOLEAN) {
+                                throw parquet_exception("Bloom filters are unsupported for BOOLEAN columns.");
+                            }
+                            column_options.bloom_filter = x.bloom_filter;
+                        }
+                        configs.push_back(column_writer_config{parquet_type, options, column_options});
+                    }
+                }, x.logical_type);
+            }
+        }, node_variant);
+    }};
+    for (const node& field : root.fields) {
+        convert(field, 0, 0);
+    }
+    return configs;
+}
+
+inline column_chunk_writer_variant make_column_chunk_writer(const column_writer_config& config) {
+    switch (config.type) {
+    case format::Type::BOOLEAN:
+        return make_column_chunk_writer<format::Type::BOOLEAN>(config.options, config.chunk_options);
+    case format::Type::INT32:
+        return make_column_chunk_writer<format::Type::INT32>(config.options, config.chunk_options);
+    case format::Type::INT64:
+        return make_column_chunk_writer<format::Type::INT64>(config.options, config.chunk_options);
+    case format::Type::FLOAT:
+        return make_column_chunk_writer<format::Type::FLOAT>(config.options, config.chunk_options);
+    case format::Type::DOUBLE:
+        return make_column_chunk_writer<format::Type::DOUBLE>(config.options, config.chunk_options);
+    case format::Type::BYTE_ARRAY:
+        return make_column_chunk_writer<format::Type::BYTE_ARRAY>(config.options, config.chunk_options);
+    case format::Type::FIXED_LEN_BYTE_ARRAY:
+        return make_column_chunk_writer<format::Type::FIXED_LEN_BYTE_ARRAY>(config.options, config.chunk_options);
+    default:
+        throw parquet_exception(seastar::format("Writing physical type {} is unsupported", config.type));
+    }
+}
+
+class sharded_file_writer;
+
 class file_writer {
 public:
-    using column_chunk_writer_variant = std::variant<
-        column_chunk_writer<format::Type::BOOLEAN>,
-        column_chunk_writer<format::Type::INT32>,
-        column_chunk_writer<format::Type::INT64>,
-        column_chunk_writer<format::Type::FLOAT>,
-        column_chunk_writer<format::Type::DOUBLE>,
-        column_chunk_writer<format::Type::BYTE_ARRAY>,
-        column_chunk_writer<format::Type::FIXED_LEN_BYTE_ARRAY>
-    >;
+    using column_chunk_writer_variant = parquet4seastar::column_chunk_writer_variant;
 private:
     seastar::output_stream<char> _sink;
+    file_writer_options _options;
     std::vector<column_chunk_writer_variant> _writers;
     format::FileMetaData _metadata;
     std::vector<std::vector<std::string>> _leaf_paths;
     thrift_serializer _thrift_serializer;
     size_t _file_offset = 0;
+    // Per row group, per column. Written just before the footer.
+    std::vector<std::vector<page_index>> _page_indexes;
+    // Spills never overlap with each other or with flush_row_group().
+    seastar::semaphore _spill_lock{1};
+    // The spill started by the last page flush which exceeded the memory budget.
+    seastar::future<> _background_spill = seastar::make_ready_future<>();
+    bool _spilling = false;
+    // sharded_file_writer uses a file_writer without column writers to assemble its file.
+    friend class sharded_file_writer;
 private:
-    void init_writers(const writer_schema::schema &root) {
-        using namespace writer_schema;
-        auto convert = y_combinator{[&](auto&& convert, const node& node_variant, uint32_t def, uint32_t rep) -> void {
-            std::visit(overloaded {
-                [&] (const list_node& x) { convert(*x.element, def + 1 + x.optional, rep + 1); },
-                [&] (const map_node& x) {
-                    convert(*x.key, def + 1 + x.optional, rep + 1);
-                    convert(*x.value, def + 1 + x.optional, rep + 1);
-                },
-                [&] (const struct_node& x) {
-                    for (const node& child : x.fields) {
-                        convert(child, def + x.optional, rep);
-                    }
-                },
-                [&] (const primitive_node& x) {
-                    std::visit(overloaded {
-                        [&] (logical_type::INT96 logical_type) {
-                            throw parquet_exception("INT96 is deprecated. Writing INT96 is unsupported.");
-                        },
-                        [&] (auto logical_type) {
-                            constexpr format::Type::type parquet_type = decltype(logical_type)::physical_type;
-                            writer_options options = {def + x.optional, rep, x.encoding, x.compression};
-                            _writers.push_back(make_column_chunk_writer<parquet_type>(options));
-                        }
-                    }, x.logical_type);
-                }
-            }, node_variant);
-        }};
-        for (const node& field : root.fields) {
-            convert(field, 0, 0);
+    // Prepares the metadata of the file. The column writers are left to the caller.
+    static std::unique_ptr<file_writer>
+    make(const writer_schema::schema& schema, file_writer_options options) {
+        if (options.memory_budget && !options.column_options.spill_directory) {
+            throw parquet_exception("memory_budget requires column_options.spill_directory");
+        }
+        auto fw = std::unique_ptr<file_writer>(new file_writer{});
+        fw->_options = std::move(options);
+        writer_schema::write_schema_result wsr = writer_schema::write_schema(schema);
+        fw->_metadata.schema = std::move(wsr.elements);
+        fw->_leaf_paths = std::move(wsr.leaf_paths);
+        // Tells readers that min_value and max_value follow the sort order of the logical type.
+        format::ColumnOrder column_order;
+        column_order.__set_TYPE_ORDER(format::TypeDefinedOrder{});
+        fw->_metadata.__set_column_orders(std::vector<format::ColumnOrder>(fw->_leaf_paths.size(), column_order));
+        return fw;
+    }
+
+    void init_writers(const writer_schema::schema& schema) {
+        for (const column_writer_config& config : column_writer_configs(schema, _options.column_options)) {
+            _writers.push_back(make_column_chunk_writer(config));
+        }
+        if (_options.memory_budget) {
+            for (column_chunk_writer_variant& writer : _writers) {
+                std::visit([this] (auto& x) { x.on_page_flushed([this] { check_memory_budget(); }); }, writer);
+            }
+        }
+    }
+
+    // Starts spilling in the background if the memory budget is exceeded,
+    // unless a spill or flush_row_group() is already in progress.
+    void check_memory_budget() {
+        if (_spilling || _spill_lock.available_units() == 0 || buffered_size() <= *_options.memory_budget) {
+            return;
+        }
+        _spilling = true;
+        _background_spill = std::move(_background_spill).then([this] {
+            return seastar::with_semaphore(_spill_lock, 1, [this] {
+                return spill_over_budget();
+            });
+        }).finally([this] {
+            _spilling = false;
+        });
+    }
+
+    seastar::future<> wait_for_background_spill() {
+        return std::exchange(_background_spill, seastar::make_ready_future<>());
+    }
+
+    // Spill the columns with the most buffered pages until the memory budget is respected.
+    // Must be called under _spill_lock.
+    seastar::future<> spill_over_budget() {
+        return seastar::repeat([this] {
+            if (_writers.empty() || buffered_size() <= *_options.memory_budget) {
+                return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
+            }
+            auto largest = std::max_element(_writers.begin(), _writers.end(),
+                [] (const column_chunk_writer_variant& a, const column_chunk_writer_variant& b) {
+                    auto size = [] (const auto& x) { return x.spillable_size(); };
+                    return std::visit(size, a) < std::visit(size, b);
+                });
+            if (std::visit([] (const auto& x) { return x.spillable_size(); }, *largest) == 0) {
+                // The rest is held by the current pages, which can't be spilled.
+                return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
+            }
+            return std::visit([] (auto& x) { return x.spill(); }, *largest).then([] {
+                return seastar::stop_iteration::no;
+            });
+        });
+    }
+
+    static seastar::future<std::unique_ptr<file_writer>>
+    open_sink(std::unique_ptr<file_writer> fw, const std::string& path) {
+        seastar::open_flags flags
+                = seastar::open_flags::wo
+                | seastar::open_flags::create
+                | seastar::open_flags::truncate;
+        std::optional<uint64_t> expected_file_size = fw->_options.expected_file_size;
+        return seastar::open_file_dma(path, flags).then(
+        [expected_file_size] (seastar::file file) {
+            if (!expected_file_size) {
+                return seastar::make_ready_future<seastar::file>(std::move(file));
+            }
+            seastar::future<> allocated = file.allocate(0, *expected_file_size);
+            return allocated.then([file = std::move(file)] () mutable {
+                return std::move(file);
+            });
+        }).then([fw = std::move(fw)] (seastar::file file) mutable {
+            seastar::output_stream<char> sink = seastar::make_file_output_stream(
+                    std::move(file), fw->_options.output_stream_options);
+            return open_sink(std::move(fw), std::move(sink));
+        });
+    }
+
+    static seastar::future<std::unique_ptr<file_writer>>
+    open_sink(std::unique_ptr<file_writer> fw, seastar::output_stream<char> sink) {
+        fw->_sink = std::move(sink);
+        fw->_file_offset = 4;
+        return fw->_sink.write("PAR1", 4).then(
+        [fw = std::move(fw)] () mutable {
+            return std::move(fw);
+        });
+    }
+
+    void start_row_group(int64_t rows) {
+        _metadata.row_groups.push_back(format::RowGroup{});
+        _metadata.row_groups.rbegin()->__set_num_rows(rows);
+        _page_indexes.emplace_back();
+    }
+
+    // Records column chunk i of the current row group, whose pages were just written at _file_offset
+    // (with offsets in cmd and index relative to the chunk), and writes the copy of its metadata
+    // which follows the chunk.
+    seastar::future<> finish_chunk(size_t i, format::ColumnMetaData& cmd, page_index index) {
+        cmd.dictionary_page_offset += _file_offset;
+        cmd.data_page_offset += _file_offset;
+        cmd.__set_path_in_schema(_leaf_paths[i]);
+        bytes_view footer = _thrift_serializer.serialize(cmd);
+
+        for (format::PageLocation& location : index.offset_index.page_locations) {
+            location.offset += _file_offset;
         }
+        _page_indexes.back().push_back(std::move(index));
+
+        _file_offset += cmd.total_compressed_size;
+        format::ColumnChunk cc;
+        cc.__set_file_offset(_file_offset);
+        cc.__set_meta_data(cmd);
+        _metadata.row_groups.rbegin()->columns.push_back(cc);
+        _metadata.row_groups.rbegin()->__set_total_byte_size(
+                _metadata.row_groups.rbegin()->total_byte_size
+                + cmd.total_compressed_size
+                + footer.size());
+
+        _file_offset += footer.size();
+        return _sink.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+    }
+
+    seastar::future<> write_bloom_filter(size_t i, const bloom_filter* filter) {
+        if (!filter) {
+            return seastar::make_ready_future<>();
+        }
+        return write_bloom_filter(i, filter->view());
+    }
+
+    // Writes the bloom filter of column i of the last row group, given by its bitset (see bloom_filter::view()).
+    // bitset has to stay alive until the returned future resolves.
+    seastar::future<> write_bloom_filter(size_t i, bytes_view bitset) {
+        _metadata.row_groups.rbegin()->columns[i].meta_data.__set_bloom_filter_offset(_file_offset);
+        bytes_view header = _thrift_serializer.serialize(bloom_filter::header(bitset.size()));
+        _file_offset += header.size() + bitset.size();
+        return _sink.write(reinterpret_cast<const char*>(header.data()), header.size()).then([this, bitset] {
+            return _sink.write(reinterpret_cast<const char*>(bitset.data()), bitset.size());
+        });
+    }
+
+    // Writes everything after the last row group and closes the file.
+    seastar::future<> write_footer() {
+        return write_page_indexes().then([this] {
+            for (const format::RowGroup& rg : _metadata.row_groups) {
+                _metadata.num_rows += rg.num_rows;
+            }
+            _metadata.__set_version(1); // Parquet 2.0 == 1
+            bytes_view footer = _thrift_serializer.serialize(_metadata);
+            return _sink.write(reinterpret_cast<const char*>(footer.data()), footer.size()).then([this, footer] {
+                uint32_t footer_size = footer.size();
+                return _sink.write(reinterpret_cast<const char*>(&footer_size), 4);
+            });
+        }).then([this] {
+            return _sink.write("PAR1", 4);
+        }).then([this] {
+            return _sink.flush();
+        }).then([this] {
+            return _sink.close();
+        });
     }
 
 public:
     static seastar::future<std::unique_ptr<file_writer>>
-    open(const std::string& path, const writer_schema::schema& schema) {
-        return seastar::futurize_invoke([&schema, path] {
-            auto fw = std::unique_ptr<file_writer>(new file_writer{});
-            writer_schema::write_schema_result wsr = writer_schema::write_schema(schema);
-            fw->_metadata.schema = std::move(wsr.elements);
-            fw->_leaf_paths = std::move(wsr.leaf_paths);
+    open(const std::string& path, const writer_schema::schema& schema, file_writer_options options = {}) {
+        return seastar::futurize_invoke([&schema, path, options = std::move(options)] () mutable {
+            auto fw = make(schema, std::move(options));
             fw->init_writers(schema);
+            return open_sink(std::move(fw), path);
+        });
+    }
 
-            seastar::open_flags flags
-                    = seastar::open_flags::wo
-                    | seastar::open_flags::create
-                    | seastar::open_flags::truncate;
-            return seastar::open_file_dma(path, flags).then(
-            [fw = std::move(fw)] (seastar::file file) mutable {
-                fw->_sink = seastar::make_file_output_stream(file);
-                fw->_file_offset = 4;
-                return fw->_sink.write("PAR1", 4).then(
-                [fw = std::move(fw)] () mutable {
-                    return std::move(fw);
-                });
-            });
+    // Writes the file to the sink, e.g. a stream made by make_memory_output_stream().
+    // The sink is flushed and closed by close(). output_stream_options and expected_file_size
+    // apply only to files opened by path.
+    static seastar::future<std::unique_ptr<file_writer>>
+    open(seastar::output_stream<char> sink, const writer_schema::schema& schema, file_writer_options options = {}) {
+        return seastar::futurize_invoke([&schema, &sink, options = std::move(options)] () mutable {
+            auto fw = make(schema, std::move(options));
+            fw->init_writers(schema);
+            return open_sink(std::move(fw), std::move(sink));
         });
     }
 
+    size_t rows_in_row_group() const {
+        if (_writers.empty()) {
+            return 0;
+        }
+        return std::visit([] (const auto& x) { return x.rows_written(); }, _writers[0]);
+    }
+
     template <format::Type::type ParquetType>
     column_chunk_writer<ParquetType>& column(int i) {
         return std::get<column_chunk_writer<ParquetType>>(_writers[i]);
     }
 
+    // Includes the unflushed pages.
     size_t estimated_row_group_size() const {
         size_t size = 0;
         for (const auto& writer : _writers) {
@@ -119,58 +392,131 @@ public:
         return size;
     }
 
+    // The memory held by the data pages of the current row group, including the current
+    // pages of the columns. See column_chunk_writer::buffered_size().
+    size_t buffered_size() const {
+        size_t size = 0;
+        for (const auto& writer : _writers) {
+            std::visit([&] (const auto& x) {size += x.buffered_size();}, writer);
+        }
+        return size;
+    }
+
+    // Resolves when the memory budget is respected again, or when only the current pages
+    // are left in memory. Spilling starts by itself when a page flush exceeds the budget;
+    // this waits for it, and reports its errors.
+    seastar::future<> maybe_spill() {
+        if (!_options.memory_budget) {
+            return seastar::make_ready_future<>();
+        }
+        return wait_for_background_spill().then([this] {
+            return seastar::with_semaphore(_spill_lock, 1, [this] {
+                return spill_over_budget();
+            });
+        });
+    }
+
+    // Resolves when every column can start compressing another page in the background.
+    // See column_chunk_writer::backpressure().
+    seastar::future<> backpressure() {
+        return seastar::do_for_each(_writers, [] (column_chunk_writer_variant& writer) {
+            return std::visit([] (auto& x) { return x.backpressure(); }, writer);
+        });
+    }
+
+    // Flush the row group if it has reached the target size, or wait for maybe_spill()
+    // otherwise. Waits for backpressure() first. Should be called periodically
+    // by the user, but only on row boundaries, i.e. when all columns received the same rows.
+    seastar::future<> maybe_flush_row_group() {
+        return backpressure().then([this] {
+            if (estimated_row_group_size() >= _options.target_row_group_size) {
+                return flush_row_group();
+            }
+            return maybe_spill();
+        });
+    }
+
     seastar::future<> flush_row_group() {
         using it = boost::counting_iterator<size_t>;
 
-        _metadata.row_groups.push_back(format::RowGroup{});
-        size_t rows_written = 0;
-        if (_writers.size() > 0) {
-            rows_written = std::visit([&] (auto& x) {return x.rows_written();}, _writers[0]);
-        }
-        _metadata.row_groups.rbegin()->__set_num_rows(rows_written);
+        return wait_for_background_spill().then([this] {
+            // Holding _spill_lock also keeps the pages flushed by flush_chunk() from starting a spill.
+            return seastar::with_semaphore(_spill_lock, 1, [this] {
+                start_row_group(rows_in_row_group());
+                return seastar::do_for_each(it(0), it(_writers.size()), [this] (size_t i) {
+                    return std::visit([&, i] (auto& x) {
+                        return x.flush_chunk(_sink);
+                    }, _writers[i]).then([this, i] (seastar::lw_shared_ptr<format::ColumnMetaData> cmd) {
+                        page_index index = std::visit([] (auto& x) { return x.take_page_index(); }, _writers[i]);
+                        return finish_chunk(i, *cmd, std::move(index));
+                    });
+                });
+            });
+        }).then([this] {
+            return write_bloom_filters();
+        });
+    }
 
+    // The bloom filters of a row group are written right after it,
+    // so that they don't have to be kept in memory until close().
+    seastar::future<> write_bloom_filters() {
+        using it = boost::counting_iterator<size_t>;
         return seastar::do_for_each(it(0), it(_writers.size()), [this] (size_t i) {
-            return std::visit([&, i] (auto& x) {
-                return x.flush_chunk(_sink);
-            }, _writers[i]).then([this, i] (seastar::lw_shared_ptr<format::ColumnMetaData> cmd) {
-                cmd->dictionary_page_offset += _file_offset;
-                cmd->data_page_offset += _file_offset;
-                cmd->__set_path_in_schema(_leaf_paths[i]);
-                bytes_view footer = _thrift_serializer.serialize(*cmd);
-
-                _file_offset += cmd->total_compressed_size;
-                format::ColumnChunk cc;
-                cc.__set_file_offset(_file_offset);
-                cc.__set_meta_data(*cmd);
-                _metadata.row_groups.rbegin()->columns.push_back(cc);
-                _metadata.row_groups.rbegin()->__set_total_byte_size(
-                        _metadata.row_groups.rbegin()->total_byte_size
-                        + cmd->total_compressed_size
-                        + footer.size());
-
-                _file_offset += footer.size();
-                return _sink.write(reinterpret_cast<const char*>(footer.data()), footer.size());
-            });
+            return write_bloom_filter(i, std::visit([] (auto& x) { return x.flushed_bloom_filter(); }, _writers[i]));
         });
     }
 
-    seastar::future<> close() {
-        return flush_row_group().then([this] {
-            for (const format::RowGroup& rg : _metadata.row_groups) {
-                _metadata.num_rows += rg.num_rows;
+    // All column indexes are written first, followed by all offset indexes,
+    // so that readers can fetch each kind with a single read.
+    seastar::future<> write_page_indexes() {
+        using it = boost::counting_iterator<size_t>;
+        auto for_each_chunk = [this] (auto func) {
+            return seastar::do_for_each(it(0), it(_page_indexes.size()), [this, func] (size_t rg) {
+                return seastar::do_for_each(it(0), it(_page_indexes[rg].size()), [this, func, rg] (size_t col) {
+                    return func(_page_indexes[rg][col], _metadata.row_groups[rg].columns[col]);
+                });
+            });
+        };
+        auto write = [this] (bytes_view serialized) {
+            _file_offset += serialized.size();
+            return _sink.write(reinterpret_cast<const char*>(serialized.data()), serialized.size());
+        };
+        return for_each_chunk([this, write] (page_index& index, format::ColumnChunk& cc) {
+            if (!index.column_index || index.offset_index.page_locations.empty()) {
+                return seastar::make_ready_future<>();
             }
-            _metadata.__set_version(1); // Parquet 2.0 == 1
-            bytes_view footer = _thrift_serializer.serialize(_metadata);
-            return _sink.write(reinterpret_cast<const char*>(footer.data()), footer.size()).then([this, footer] {
-                uint32_t footer_size = footer.size();
-                return _sink.write(reinterpret_cast<const char*>(&footer_size), 4);
+            bytes_view serialized = _thrift_serializer.serialize(*index.column_index);
+            cc.__set_column_index_offset(_file_offset);
+            cc.__set_column_index_length(serialized.size());
+            return write(serialized);
+        }).then([this, for_each_chunk, write] {
+            return for_each_chunk([this, write] (page_index& index, format::ColumnChunk& cc) {
+                if (index.offset_index.page_locations.empty()) {
+                    return seastar::make_ready_future<>();
+                }
+                bytes_view serialized = _thrift_serializer.serialize(index.offset_index);
+                cc.__set_offset_index_offset(_file_offset);
+                cc.__set_offset_index_length(serialized.size());
+                return write(serialized);
             });
         }).then([this] {
-            return _sink.write("PAR1", 4);
-        }).then([this] {
-            return _sink.flush();
+            _page_indexes.clear();
+        });
+    }
+
+    seastar::future<> close() {
+        return wait_for_background_spill().then([this] {
+            if (!_metadata.row_groups.empty() && rows_in_row_group() == 0) {
+                // Don't leave an empty row group behind maybe_flush_row_group().
+                return seastar::make_ready_future<>();
+            }
+            return flush_row_group();
         }).then([this] {
-            return _sink.close();
+            return write_footer();
+        }).finally([this] {
+            return seastar::do_for_each(_writers, [] (column_chunk_writer_variant& writer) {
+                return std::visit([] (auto& x) { return x.close(); }, writer);
+            });
         });
     }
 };
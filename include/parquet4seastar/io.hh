@@ -0,0 +1,78 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <seastar/core/file.hh>
+#include <seastar/core/iostream.hh>
+#include <seastar/core/shared_ptr.hh>
+#include <seastar/core/temporary_buffer.hh>
+#include <functional>
+
+namespace parquet4seastar {
+
+// Buffers which hold a contiguous range of bytes, in order.
+using buffer_chain = std::vector<seastar::temporary_buffer<char>>;
+
+/* The bytes which file_reader reads from: a file, a chain of buffers in memory, or anything
+ * else which can serve reads of arbitrary ranges.
+ * Streams made by make_stream() don't depend on the lifetime of the source.
+ */
+class random_access_source {
+public:
+    virtual ~random_access_source() = default;
+    virtual seastar::future<uint64_t> size() = 0;
+    // Reads exactly [pos, pos + len). Fails if the range goes beyond the end of the source.
+    virtual seastar::future<seastar::temporary_buffer<uint8_t>> read(uint64_t pos, size_t len) = 0;
+    // A stream of [pos, pos + len).
+    virtual seastar::input_stream<char> make_stream(uint64_t pos, uint64_t len) = 0;
+    virtual seastar::future<> close() = 0;
+};
+
+seastar::shared_ptr<random_access_source> make_file_source(seastar::file file);
+
+// The buffers are shared, not copied, by reads and streams.
+seastar::shared_ptr<random_access_source> make_memory_source(buffer_chain buffers);
+
+// Returns exactly [pos, pos + len) of a source of the given size.
+using read_callback = std::function<seastar::future<seastar::temporary_buffer<uint8_t>>(uint64_t pos, size_t len)>;
+// Streams are read in chunks of stream_read_size bytes.
+seastar::shared_ptr<random_access_source>
+make_callback_source(uint64_t size, read_callback read, size_t stream_read_size = 128 * 1024);
+
+// Reads the streams one after another.
+seastar::input_stream<char> make_concatenated_stream(std::vector<seastar::input_stream<char>> streams);
+
+/* Sinks for file_writer. Any seastar::output_stream<char> can be used (e.g. one made by
+ * make_file_output_stream()), these cover writing to memory and to user code.
+ */
+
+// Appends everything written to the stream to *buffers.
+seastar::output_stream<char>
+make_memory_output_stream(seastar::lw_shared_ptr<buffer_chain> buffers, size_t buffer_size = 128 * 1024);
+
+// Passes every buffer written to the stream to the callback (e.g. to send it as a part
+// of a network response). The next buffer is passed when the previous call resolves.
+using write_callback = std::function<seastar::future<>(seastar::temporary_buffer<char>)>;
+seastar::output_stream<char>
+make_callback_output_stream(write_callback write, size_t buffer_size = 128 * 1024);
+
+} // namespace parquet4seastar
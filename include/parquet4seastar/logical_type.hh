@@ -124,4 +124,10 @@ using logical_type = std::variant<
 logical_type read_logical_type(const format::SchemaElement& x);
 void write_logical_type(logical_type logical_type, format::SchemaElement& leaf);
 
+// The order in which min and max statistics of a column are computed.
+// For byte arrays, SIGNED means comparison as big-endian two's complement integers (decimals),
+// and UNSIGNED means lexicographic comparison of unsigned bytes.
+enum class sort_order { SIGNED, UNSIGNED, UNDEFINED };
+sort_order get_sort_order(const logical_type& logical_type);
+
 } // namespace parquet4seastar::logical_type
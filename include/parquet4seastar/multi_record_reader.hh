@@ -0,0 +1,107 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/record_reader.hh>
+
+namespace parquet4seastar::record {
+
+/* Reads the records of all row groups of a sequence of files.
+ * While a row group is consumed, the next one is opened and the first pages
+ * of its column chunks are read, so there is no stall at row group boundaries.
+ * The same is done for the footer of the next file.
+ *
+ * All files must have the same columns (paths, physical types and levels).
+ * The projection and predicates select columns by index, which is the same in all files.
+ * Row groups which can't satisfy the predicates (according to their statistics
+ * and bloom filters) are skipped without being opened.
+ * The reader works in the background between calls, so it must not be moved after the first read.
+ */
+class multi_record_reader {
+    struct row_group {
+        file_reader* file;
+        // Set if the file was opened by this reader, which closes it after its last row group.
+        seastar::lw_shared_ptr<file_reader> owned_file;
+        std::unique_ptr<record_reader> reader;
+    };
+    std::vector<file_reader*> _files;
+    std::vector<std::string> _paths;
+    projection _projection;
+    std::vector<predicate> _filter;
+    // The file of the last opened row group, and the position of the next one.
+    file_reader* _file = nullptr;
+    seastar::lw_shared_ptr<file_reader> _owned_file;
+    size_t _next_file = 0;
+    int _next_row_group = 0;
+    // The columns of the first file, which all files must match.
+    struct column {
+        std::vector<std::string> path;
+        format::Type::type type;
+        uint32_t def_level;
+        uint32_t rep_level;
+    };
+    std::optional<std::vector<column>> _columns;
+    std::optional<row_group> _current;
+    std::optional<seastar::future<std::optional<row_group>>> _next;
+private:
+    multi_record_reader(std::vector<file_reader*> files, std::vector<std::string> paths,
+            projection proj, std::vector<predicate> filter)
+        : _files{std::move(files)}
+        , _paths{std::move(paths)}
+        , _projection{std::move(proj)}
+        , _filter{std::move(filter)} {}
+    size_t file_count() const { return _files.size() + _paths.size(); }
+    void check_schema(file_reader& fr);
+    seastar::future<> open_next_file();
+    static seastar::future<> release(std::optional<row_group> rg);
+    seastar::future<std::optional<row_group>> open_next_row_group();
+    seastar::future<bool> advance();
+public:
+    // Reads the given files, which are owned (and closed) by the caller.
+    explicit multi_record_reader(std::vector<file_reader*> files,
+            projection proj = {}, std::vector<predicate> filter = {})
+        : multi_record_reader{std::move(files), {}, std::move(proj), std::move(filter)} {}
+    // Opens the files one after another, and closes each after reading it.
+    explicit multi_record_reader(std::vector<std::string> paths,
+            projection proj = {}, std::vector<predicate> filter = {})
+        : multi_record_reader{{}, std::move(paths), std::move(proj), std::move(filter)} {}
+
+    template <typename Consumer> seastar::future<> read_all(Consumer& c);
+    // Has to be called before destruction, also after an exception.
+    seastar::future<> close();
+};
+
+template <typename Consumer>
+inline seastar::future<> multi_record_reader::read_all(Consumer& c) {
+    return seastar::repeat([this, &c] {
+        return advance().then([this, &c] (bool has_row_group) {
+            if (!has_row_group) {
+                return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
+            }
+            return _current->reader->read_all(c).then([] {
+                return seastar::stop_iteration::no;
+            });
+        });
+    });
+}
+
+} // namespace parquet4seastar::record
@@ -0,0 +1,149 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/file_reader.hh>
+#include <parquet4seastar/statistics.hh>
+
+namespace parquet4seastar::record {
+
+enum class comparison { eq, ne, lt, le, gt, ge, is_null, is_not_null };
+
+/* A condition on a leaf column which holds at most one value per record,
+ * i.e. which isn't inside a list or map.
+ * Values are compared in the sort order of the logical type of the column
+ * (e.g. UINT32 is unsigned, DECIMAL is signed, strings are compared byte by byte).
+ * Nulls satisfy only is_null. INT96 columns, and ordered comparisons on columns
+ * without an order (e.g. INTERVAL), are rejected.
+ */
+struct predicate {
+    uint32_t column_index;
+    comparison op;
+    // The plain encoding of the value: a single byte for BOOLEAN,
+    // the bytes themselves for byte arrays. Unused by is_null and is_not_null.
+    bytes value;
+
+    // T is the input type of the physical type of the column (e.g. int32_t for INT32),
+    // or bytes_view for byte arrays.
+    template <typename T>
+    static predicate make(uint32_t column_index, comparison op, const T& value) {
+        if constexpr (std::is_convertible_v<const T&, bytes_view>) {
+            return predicate{column_index, op, bytes{bytes_view{value}}};
+        } else {
+            static_assert(std::is_arithmetic_v<T>);
+            const byte* data = reinterpret_cast<const byte*>(&value);
+            return predicate{column_index, op, bytes(data, data + sizeof(value))};
+        }
+    }
+    static predicate is_null(uint32_t column_index) {
+        return predicate{column_index, comparison::is_null, {}};
+    }
+    static predicate is_not_null(uint32_t column_index) {
+        return predicate{column_index, comparison::is_not_null, {}};
+    }
+};
+
+// Throws parquet_exception if a predicate can't be applied to the schema.
+void check_predicates(file_reader& fr, const std::vector<predicate>& predicates);
+
+// Returns false if no record of the row group satisfies all predicates.
+// Uses the statistics and bloom filters of the column chunks.
+seastar::future<bool> row_group_may_match(file_reader& fr, int row_group, const std::vector<predicate>& predicates);
+
+namespace predicate_internal {
+
+// A predicate with its value decoded.
+template <format::Type::type ParquetType>
+class evaluator {
+public:
+    using output_type = typename value_decoder_traits<ParquetType>::output_type;
+private:
+    static constexpr bool is_byte_array =
+            ParquetType == format::Type::BYTE_ARRAY || ParquetType == format::Type::FIXED_LEN_BYTE_ARRAY;
+    using value_type = std::conditional_t<is_byte_array, bytes_view, output_type>;
+    comparison _op;
+    logical_type::sort_order _order;
+    value_type _value{};
+private:
+    bool less(const value_type& a, const value_type& b) const {
+        return statistics_internal::less(_order, a, b);
+    }
+    bool equal(const value_type& a, const value_type& b) const {
+        return a == b;
+    }
+public:
+    // The predicate has to outlive the evaluator.
+    evaluator(const predicate& p, logical_type::sort_order order) : _op{p.op}, _order{order} {
+        if (p.op == comparison::is_null || p.op == comparison::is_not_null) {
+            return;
+        }
+        if constexpr (is_byte_array) {
+            _value = p.value;
+        } else {
+            std::memcpy(&_value, p.value.data(), sizeof(_value));
+        }
+    }
+
+    bool test_null() const {
+        return _op == comparison::is_null;
+    }
+
+    bool test(const value_type& x) const {
+        if constexpr (std::is_floating_point_v<value_type>) {
+            // NaN is unordered.
+            if (std::isnan(x)) {
+                return _op == comparison::ne || _op == comparison::is_not_null;
+            }
+        }
+        switch (_op) {
+        case comparison::eq: return equal(x, _value);
+        case comparison::ne: return !equal(x, _value);
+        case comparison::lt: return less(x, _value);
+        case comparison::le: return !less(_value, x);
+        case comparison::gt: return less(_value, x);
+        case comparison::ge: return !less(x, _value);
+        case comparison::is_null: return false;
+        case comparison::is_not_null: return true;
+        }
+        return true;
+    }
+
+    bool test(const seastar::temporary_buffer<uint8_t>& x) const {
+        return test(bytes_view{x.get(), x.size()});
+    }
+
+    // Whether a value in [min, max] may satisfy the predicate.
+    bool may_match_range(const value_type& min, const value_type& max) const {
+        switch (_op) {
+        case comparison::eq: return !less(_value, min) && !less(max, _value);
+        case comparison::lt: return less(min, _value);
+        case comparison::le: return !less(_value, min);
+        case comparison::gt: return less(_value, max);
+        case comparison::ge: return !less(max, _value);
+        default: return true;
+        }
+    }
+};
+
+} // namespace predicate_internal
+
+} // namespace parquet4seastar::record
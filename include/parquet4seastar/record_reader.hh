@@ -22,22 +22,74 @@
 #pragma once
 
 #include <parquet4seastar/file_reader.hh>
+#include <parquet4seastar/predicate.hh>
 #include <parquet4seastar/reader_schema.hh>
 #include <limits>
 
 namespace parquet4seastar::record {
 
+/* Records are assembled synchronously, from levels and values buffered by the leaf readers.
+ * record_reader refills (asynchronously) only the leaves which don't hold a complete record,
+ * and then assembles as many records as all leaves hold, without suspending.
+ */
+
 struct field_reader;
 
+/* The columns to read. A field is assembled if any of its leaves is selected,
+ * and only its selected parts are assembled. Maps are an exception: the key and value
+ * are read together if either is selected.
+ */
+class projection {
+    bool _all = true;
+    // Indexed by column index.
+    std::vector<bool> _columns;
+public:
+    // Selects all columns.
+    projection() = default;
+    static projection of_columns(const reader_schema::schema& schema, const std::vector<uint32_t>& column_indices);
+    // Selects the leaves of the nodes with the given paths (see reader_schema::node_base::path).
+    static projection of_paths(const reader_schema::schema& schema, const std::vector<std::vector<std::string>>& paths);
+    bool selects_column(uint32_t column_index) const {
+        return _all || (column_index < _columns.size() && _columns[column_index]);
+    }
+    bool selects(const reader_schema::node& node) const;
+};
+
+// The part of typed_primitive_reader used by record_reader to schedule refills.
+class primitive_reader_base {
+public:
+    virtual ~primitive_reader_base() = default;
+    // The number of complete records buffered after the current position,
+    // which has to be the beginning of a record.
+    virtual size_t buffered_records() const = 0;
+    // Whether all levels of the column chunk have been buffered.
+    virtual bool exhausted() const = 0;
+    // Buffer more levels, keeping the unread ones.
+    virtual seastar::future<> refill() = 0;
+    virtual uint32_t column_index() const = 0;
+    // Discards the next n records, which may not be buffered yet.
+    // buffered_records() is 0 until they are discarded.
+    virtual void skip_records(uint64_t n) = 0;
+    // Deselects the next selection.size() records which don't satisfy the predicate.
+    // The column must not be repeated, so that each record is a single level.
+    virtual void filter(const predicate& p, std::vector<bool>& selection) const = 0;
+};
+
+/* If use_arena is set, byte array values don't own their memory (see unowned_buffer()).
+ * They point into the dictionary, into the pages, or into an arena of the reader,
+ * and are valid only until the next refill. Consumers have to copy the values they keep.
+ */
 template <typename LogicalType>
-class typed_primitive_reader {
+class typed_primitive_reader final : public primitive_reader_base {
 public:
     using output_type = typename column_chunk_reader<LogicalType::physical_type>::output_type;
     static constexpr int64_t DEFAULT_BATCH_SIZE = 1024;
 private:
+    static constexpr bool is_byte_array = std::is_same_v<output_type, seastar::temporary_buffer<byte>>;
     column_chunk_reader<LogicalType::physical_type> _source;
     uint32_t _def_level;
     uint32_t _rep_level;
+    uint32_t _column_index;
     std::string _name;
     LogicalType _logical_type;
     std::vector<int32_t> _rep_levels;
@@ -47,6 +99,18 @@ private:
     size_t _values_offset = 0;
     size_t _levels_buffered = 0;
     size_t _values_buffered = 0;
+    // The number of buffered levels which begin a record (i.e. have repetition level 0).
+    size_t _record_starts = 0;
+    bool _exhausted = false;
+    // The number of record beginnings to discard, and whether the last of them was discarded
+    // and its remaining levels (up to the next beginning) have to be discarded too.
+    uint64_t _records_to_skip = 0;
+    bool _skipping = false;
+    bool _use_arena;
+    // The memory of the buffered values. The unread values are moved to the spare arena
+    // on refill, and the rest is released at once.
+    byte_arena _arena;
+    byte_arena _spare_arena;
 
     struct triplet {
         int16_t def_level;
@@ -57,15 +121,18 @@ public:
     explicit typed_primitive_reader(
             const reader_schema::primitive_node& node,
             column_chunk_reader<LogicalType::physical_type>&& source,
-            int64_t batch_size = DEFAULT_BATCH_SIZE)
+            int64_t batch_size = DEFAULT_BATCH_SIZE,
+            bool use_arena = false)
         : _source{std::move(source)}
         , _def_level{node.def_level}
         , _rep_level{node.rep_level}
+        , _column_index{node.column_index}
         , _name{node.info.name}
         , _logical_type(std::get<LogicalType>(node.logical_type))
         , _rep_levels(batch_size)
         , _def_levels(batch_size)
-        , _values(batch_size) {
+        , _values(batch_size)
+        , _use_arena{use_arena && is_byte_array} {
         if (_def_level > static_cast<uint32_t>(std::numeric_limits<int16_t>::max())
                 || _rep_level > static_cast<uint32_t>(std::numeric_limits<int16_t>::max())) {
             throw parquet_exception(seastar::format(
@@ -74,16 +141,23 @@ public:
     }
 
     template <typename Consumer>
-    seastar::future<> read_field(Consumer& c);
-    seastar::future<> skip_field();
-    seastar::future<int, int> current_levels();
+    void read_field(Consumer& c);
+    void skip_field();
+    std::pair<int, int> current_levels() const;
     const std::string& name() const { return _name; };
 
+    size_t buffered_records() const override;
+    bool exhausted() const override { return _exhausted; }
+    seastar::future<> refill() override;
+    uint32_t column_index() const override { return _column_index; }
+    void skip_records(uint64_t n) override;
+    void filter(const predicate& p, std::vector<bool>& selection) const override;
+
 private:
-    int current_def_level();
-    int current_rep_level();
-    seastar::future<> refill_when_empty();
-    seastar::future<std::optional<triplet>> next();
+    int def_level_at(size_t i) const;
+    int rep_level_at(size_t i) const;
+    triplet next();
+    void discard_skipped();
 };
 
 class struct_reader {
@@ -102,10 +176,11 @@ public:
     }
 
     template <typename Consumer>
-    seastar::future<> read_field(Consumer& c);
-    seastar::future<> skip_field();
-    seastar::future<int, int> current_levels();
+    void read_field(Consumer& c);
+    void skip_field();
+    std::pair<int, int> current_levels() const;
     const std::string& name() const { return _name; };
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves);
 };
 
 class list_reader {
@@ -123,10 +198,11 @@ public:
         , _name(node.info.name) {}
 
     template <typename Consumer>
-    seastar::future<> read_field(Consumer& c);
-    seastar::future<> skip_field();
-    seastar::future<int, int> current_levels();
+    void read_field(Consumer& c);
+    void skip_field();
+    std::pair<int, int> current_levels() const;
     const std::string& name() const { return _name; };
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves);
 };
 
 class optional_reader {
@@ -144,10 +220,11 @@ public:
         , _name(node.info.name) {}
 
     template <typename Consumer>
-    seastar::future<> read_field(Consumer& c);
-    seastar::future<> skip_field();
-    seastar::future<int, int> current_levels();
+    void read_field(Consumer& c);
+    void skip_field();
+    std::pair<int, int> current_levels() const;
     const std::string& name() const { return _name; };
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves);
 };
 
 class map_reader {
@@ -168,13 +245,14 @@ public:
         , _name(node.info.name) {}
 
     template <typename Consumer>
-    seastar::future<> read_field(Consumer& c);
-    seastar::future<> skip_field();
-    seastar::future<int, int> current_levels();
+    void read_field(Consumer& c);
+    void skip_field();
+    std::pair<int, int> current_levels() const;
     const std::string& name() const { return _name; };
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves);
 private:
     template <typename Consumer>
-    seastar::future<> read_pair(Consumer& c);
+    void read_pair(Consumer& c);
 };
 
 struct field_reader {
@@ -218,290 +296,554 @@ struct field_reader {
         return *std::visit([](const auto& x) {return &x.name();}, _reader);
     }
     template <typename Consumer>
-    seastar::future<> read_field(Consumer& c) {
-        return std::visit([&](auto& x) {return x.read_field(c);}, _reader);
+    void read_field(Consumer& c) {
+        std::visit([&](auto& x) {x.read_field(c);}, _reader);
     }
-    seastar::future<> skip_field() {
-        return std::visit([](auto& x) {return x.skip_field();}, _reader);
+    void skip_field() {
+        std::visit([](auto& x) {x.skip_field();}, _reader);
     }
-    seastar::future<int, int> current_levels() {
-        return std::visit([](auto& x) {return x.current_levels();}, _reader);
+    std::pair<int, int> current_levels() const {
+        return std::visit([](const auto& x) {return x.current_levels();}, _reader);
+    }
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves) {
+        std::visit([&] (auto& x) {
+            if constexpr (std::is_base_of_v<primitive_reader_base, std::decay_t<decltype(x)>>) {
+                leaves.push_back(&x);
+            } else {
+                x.collect_leaves(leaves);
+            }
+        }, _reader);
     }
+    // The projection has to select the node. It is not used after make() returns.
+    // The reader starts at the given row of the row group.
     static seastar::future<field_reader>
-    make(file_reader& file, const reader_schema::node& node_variant, int row_group);
+    make(file_reader& file, const reader_schema::node& node_variant, int row_group,
+            const projection& proj = {}, uint64_t first_row = 0, bool use_arena = false);
 };
 
+/* The rows of a row group to read. The pages before the first row are not read,
+ * if the column chunks have an offset index. Other unselected rows are discarded
+ * by the leaf readers, without being assembled.
+ */
+struct row_selection {
+    uint64_t first = 0;
+    uint64_t end = std::numeric_limits<uint64_t>::max();
+    // If set, only these rows (in ascending order) of [first, end) are read.
+    std::optional<std::vector<uint64_t>> rows;
+};
+
+// The selectors use only the row counts of row groups, so file_reader::shallow_metadata() suffices.
+
+// The selections (row group index, rows) of the row groups which overlap
+// the rows [first, end) of the file.
+std::vector<std::pair<int, row_selection>>
+select_row_range(const format::FileMetaData& metadata, uint64_t first, uint64_t end);
+// Selects each row of the file independently, with the given probability.
+std::vector<std::pair<int, row_selection>>
+select_bernoulli_sample(const format::FileMetaData& metadata, double probability, uint64_t seed);
+// Selects sample_size distinct rows of the file (or all, if it has fewer), uniformly at random.
+std::vector<std::pair<int, row_selection>>
+select_uniform_sample(const format::FileMetaData& metadata, uint64_t sample_size, uint64_t seed);
+
 class record_reader {
     const reader_schema::schema& _schema;
     std::vector<field_reader> _field_readers;
+    // Columns which are filtered on, but not projected. They are skipped by every record.
+    std::vector<field_reader> _filter_readers;
+    // Point into _field_readers and _filter_readers, whose elements don't move.
+    std::vector<primitive_reader_base*> _leaves;
+    std::vector<std::pair<predicate, primitive_reader_base*>> _predicates;
+    std::vector<bool> _selection;
+    // The row (of the row group) at which the leaves are positioned.
+    uint64_t _next_row;
+    uint64_t _end_row;
+    std::optional<std::vector<uint64_t>> _rows;
+    // The position of the next row to read in _rows.
+    size_t _next_selected = 0;
     explicit record_reader(
             const reader_schema::schema& schema,
-            std::vector<field_reader>&& field_readers)
-        : _schema(schema), _field_readers(std::move(field_readers)) {
+            std::vector<field_reader>&& field_readers,
+            std::vector<field_reader>&& filter_readers,
+            std::vector<predicate>&& predicates,
+            row_selection&& rows)
+        : _schema(schema)
+        , _field_readers(std::move(field_readers))
+        , _filter_readers(std::move(filter_readers))
+        , _next_row{rows.first}
+        , _end_row{rows.end}
+        , _rows{std::move(rows.rows)} {
+        for (field_reader& reader : _field_readers) {
+            reader.collect_leaves(_leaves);
+        }
+        for (field_reader& reader : _filter_readers) {
+            reader.collect_leaves(_leaves);
+        }
+        for (predicate& p : predicates) {
+            auto leaf = std::find_if(_leaves.begin(), _leaves.end(), [&p] (primitive_reader_base* leaf) {
+                return leaf->column_index() == p.column_index;
+            });
+            _predicates.emplace_back(std::move(p), *leaf);
+        }
     }
+    seastar::future<size_t> prepare();
+    uint64_t skip_unselected();
+    void advance(size_t records);
+    void select(size_t records);
+    template <typename Consumer> void assemble_one(Consumer& c);
+    void skip_one();
 public:
     template <typename Consumer> seastar::future<> read_one(Consumer& c);
     template <typename Consumer> seastar::future<> read_all(Consumer& c);
     seastar::future<int, int> current_levels();
-    static seastar::future<record_reader> make(file_reader& fr, int row_group);
+    // Buffers the first records of all columns, so that the next read doesn't wait for I/O.
+    seastar::future<> prefetch() { return prepare().discard_result(); }
+    // Only the top-level fields selected by the projection are passed to the consumer,
+    // and only the selected rows satisfying all predicates. Filtering is done on batches of
+    // buffered records, before any of them is assembled.
+    // With use_arena, byte array values passed to the consumer are valid only until the next
+    // call to the reader (see typed_primitive_reader).
+    static seastar::future<record_reader> make(
+            file_reader& fr, int row_group, const projection& proj = {}, std::vector<predicate> filter = {},
+            row_selection rows = {}, bool use_arena = false);
 };
 
 template <typename L>
 template <typename Consumer>
-inline seastar::future<> typed_primitive_reader<L>::read_field(Consumer& c) {
-    return next().then([this, &c] (std::optional<triplet> t) {
-        if (!t) {
-            throw parquet_exception("No more values buffered");
-        } else if (t->value) {
-            c.append_value(_logical_type, std::move(*t->value));
-        }
-    });
+inline void typed_primitive_reader<L>::read_field(Consumer& c) {
+    triplet t = next();
+    if (t.value) {
+        c.append_value(_logical_type, std::move(*t.value));
+    }
 }
 
 template <typename Consumer>
-inline seastar::future<> struct_reader::read_field(Consumer& c) {
+inline void struct_reader::read_field(Consumer& c) {
     c.start_struct();
-    return seastar::do_for_each(_readers, [this, &c] (auto& child) mutable {
+    for (field_reader& child : _readers) {
         c.start_field(child.name());
-        return child.read_field(c);
-    }).then([&c] {
-        c.end_struct();
-    });
+        child.read_field(c);
+    }
+    c.end_struct();
 }
 
 template <typename Consumer>
-inline seastar::future<> list_reader::read_field(Consumer& c) {
+inline void list_reader::read_field(Consumer& c) {
     c.start_list();
-    return current_levels().then([this, &c] (int def, int) {
-        if (def > static_cast<int>(_def_level)) {
-            return _reader->read_field(c).then([this, &c] {
-                return seastar::repeat([this, &c] {
-                    return current_levels().then([this, &c] (int def, int rep) {
-                        if (rep > static_cast<int>(_rep_level)) {
-                            c.separate_list_values();
-                            return _reader->read_field(c).then([] {
-                                return seastar::stop_iteration::no;
-                            });
-                        } else {
-                            return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
-                        }
-                    });
-                });
-            });
-        } else {
-            return _reader->skip_field();
+    if (current_levels().first > static_cast<int>(_def_level)) {
+        _reader->read_field(c);
+        while (current_levels().second > static_cast<int>(_rep_level)) {
+            c.separate_list_values();
+            _reader->read_field(c);
         }
-    }).then([&c] {
-        c.end_list();
-    });
+    } else {
+        _reader->skip_field();
+    }
+    c.end_list();
 }
 
 template <typename Consumer>
-inline seastar::future<> optional_reader::read_field(Consumer& c) {
-    return current_levels().then([this, &c] (int def, int) {
-        if (def > static_cast<int>(_def_level)) {
-            return _reader->read_field(c);
-        } else {
-            c.append_null();
-            return _reader->skip_field();
-        }
-    });
+inline void optional_reader::read_field(Consumer& c) {
+    if (current_levels().first > static_cast<int>(_def_level)) {
+        _reader->read_field(c);
+    } else {
+        c.append_null();
+        _reader->skip_field();
+    }
 }
 
 template <typename Consumer>
-inline seastar::future<> map_reader::read_field(Consumer& c) {
+inline void map_reader::read_field(Consumer& c) {
     c.start_map();
-    return current_levels().then([this, &c] (int def, int) {
-        if (def > static_cast<int>(_def_level)) {
-            return read_pair<Consumer>(c).then([this, &c] {
-                return seastar::repeat([this, &c] {
-                    return current_levels().then([this, &c] (int def, int rep) {
-                        if (rep > static_cast<int>(_rep_level)) {
-                            c.separate_map_values();
-                            return read_pair<Consumer>(c).then([this, &c] {
-                                return seastar::stop_iteration::no;
-                            });
-                        } else {
-                            return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
-                        }
-                    });
-                });
-            });
-        } else {
-            return skip_field();
+    if (current_levels().first > static_cast<int>(_def_level)) {
+        read_pair<Consumer>(c);
+        while (current_levels().second > static_cast<int>(_rep_level)) {
+            c.separate_map_values();
+            read_pair<Consumer>(c);
         }
-    }).then([&c] {
-        c.end_map();
-    });
+    } else {
+        skip_field();
+    }
+    c.end_map();
 }
 
 template <typename Consumer>
-inline seastar::future<> map_reader::read_pair(Consumer& c) {
-    return _key_reader->read_field(c).then([this, &c] {
-        c.separate_key_value();
-        return _value_reader->read_field(c);
-    });
+inline void map_reader::read_pair(Consumer& c) {
+    _key_reader->read_field(c);
+    c.separate_key_value();
+    _value_reader->read_field(c);
 }
 
-inline seastar::future<> struct_reader::skip_field() {
-    return seastar::do_for_each(_readers.begin(), _readers.end(), [] (auto& child) {
-        return child.skip_field();
-    });
+inline void struct_reader::skip_field() {
+    for (field_reader& child : _readers) {
+        child.skip_field();
+    }
 }
 
-inline seastar::future<int, int> struct_reader::current_levels() {
+inline std::pair<int, int> struct_reader::current_levels() const {
     if (_readers.empty()) {
-        return seastar::make_ready_future<int, int>(-1, -1);
+        return {-1, -1};
     }
     return _readers[0].current_levels();
 }
-inline seastar::future<> list_reader::skip_field() {
-    return _reader->skip_field();
+
+inline void struct_reader::collect_leaves(std::vector<primitive_reader_base*>& leaves) {
+    for (field_reader& child : _readers) {
+        child.collect_leaves(leaves);
+    }
 }
 
-inline seastar::future<int, int> list_reader::current_levels() {
+inline void list_reader::skip_field() {
+    _reader->skip_field();
+}
+
+inline std::pair<int, int> list_reader::current_levels() const {
     return _reader->current_levels();
 }
 
-inline seastar::future<> optional_reader::skip_field() {
-    return _reader->skip_field();
+inline void list_reader::collect_leaves(std::vector<primitive_reader_base*>& leaves) {
+    _reader->collect_leaves(leaves);
 }
 
-inline seastar::future<int, int> optional_reader::current_levels() {
+inline void optional_reader::skip_field() {
+    _reader->skip_field();
+}
+
+inline std::pair<int, int> optional_reader::current_levels() const {
     return _reader->current_levels();
 }
 
-inline seastar::future<> map_reader::skip_field() {
-    return seastar::when_all_succeed(
-            _key_reader->skip_field(),
-            _value_reader->skip_field());
+inline void optional_reader::collect_leaves(std::vector<primitive_reader_base*>& leaves) {
+    _reader->collect_leaves(leaves);
 }
 
-inline seastar::future<int, int> map_reader::current_levels() {
+inline void map_reader::skip_field() {
+    _key_reader->skip_field();
+    _value_reader->skip_field();
+}
+
+inline std::pair<int, int> map_reader::current_levels() const {
     return _key_reader->current_levels();
 }
 
-inline seastar::future<int, int> record_reader::current_levels() {
-    if (_field_readers.empty()) {
-        return seastar::make_ready_future<int, int>(-1, -1);
+inline void map_reader::collect_leaves(std::vector<primitive_reader_base*>& leaves) {
+    _key_reader->collect_leaves(leaves);
+    _value_reader->collect_leaves(leaves);
+}
+
+template <typename L>
+inline void typed_primitive_reader<L>::skip_field() {
+    next();
+}
+
+template <typename L>
+inline std::pair<int, int> typed_primitive_reader<L>::current_levels() const {
+    if (_levels_offset == _levels_buffered) {
+        return {-1, -1};
     }
-    return _field_readers[0].current_levels();
+    return {def_level_at(_levels_offset), rep_level_at(_levels_offset)};
 }
 
+template <typename L>
+inline int typed_primitive_reader<L>::def_level_at(size_t i) const {
+    return _def_level > 0 ? _def_levels[i] : 0;
+}
 
 template <typename L>
-inline seastar::future<> typed_primitive_reader<L>::skip_field() {
-    return next().then([this] (std::optional<triplet> triplet) {
-        if (!triplet) {
-            throw parquet_exception("No more values buffered");
-        }
-    });
+inline int typed_primitive_reader<L>::rep_level_at(size_t i) const {
+    return _rep_level > 0 ? _rep_levels[i] : 0;
 }
 
 template <typename L>
-inline seastar::future<int, int> typed_primitive_reader<L>::current_levels() {
-    return refill_when_empty().then([this] {
-        if (!_levels_buffered) {
-            return seastar::make_ready_future<int, int>(-1, -1);
-        } else {
-            return seastar::make_ready_future<int, int>(current_def_level(), current_rep_level());
+inline size_t typed_primitive_reader<L>::buffered_records() const {
+    if (_skipping || _record_starts == 0) {
+        return 0;
+    }
+    // The last buffered record is complete only if no more levels follow it.
+    return _record_starts - 1 + _exhausted;
+}
+
+template <typename L>
+inline seastar::future<> typed_primitive_reader<L>::refill() {
+    // Move the unread part of the buffers to the front.
+    if (_levels_offset > 0) {
+        std::move(_def_levels.begin() + _levels_offset, _def_levels.begin() + _levels_buffered, _def_levels.begin());
+        std::move(_rep_levels.begin() + _levels_offset, _rep_levels.begin() + _levels_buffered, _rep_levels.begin());
+    }
+    if constexpr (is_byte_array) {
+        if (_use_arena) {
+            for (size_t i = _values_offset; i < _values_buffered; ++i) {
+                _values[i] = unowned_buffer(_spare_arena.copy(bytes_view{_values[i].get(), _values[i].size()}));
+            }
+            std::swap(_arena, _spare_arena);
+            _spare_arena.clear();
         }
+    }
+    if (_values_offset > 0) {
+        std::move(_values.begin() + _values_offset, _values.begin() + _values_buffered, _values.begin());
+    }
+    _levels_buffered -= _levels_offset;
+    _values_buffered -= _values_offset;
+    _levels_offset = 0;
+    _values_offset = 0;
+    if (_levels_buffered == _def_levels.size()) {
+        // A record doesn't fit in the buffers.
+        _def_levels.resize(_def_levels.size() * 2);
+        _rep_levels.resize(_rep_levels.size() * 2);
+        _values.resize(_values.size() * 2);
+    }
+    return [this] {
+        if (_use_arena) {
+            return _source.read_batch(
+                    _def_levels.size() - _levels_buffered,
+                    _def_levels.data() + _levels_buffered,
+                    _rep_levels.data() + _levels_buffered,
+                    _values.data() + _values_buffered,
+                    _arena);
+        }
+        return _source.read_batch(
+                _def_levels.size() - _levels_buffered,
+                _def_levels.data() + _levels_buffered,
+                _rep_levels.data() + _levels_buffered,
+                _values.data() + _values_buffered);
+    }().then([this] (size_t levels_read) {
+        if (levels_read == 0) {
+            _exhausted = true;
+        }
+        for (size_t i = _levels_buffered; i < _levels_buffered + levels_read; ++i) {
+            if (def_level_at(i) == static_cast<int>(_def_level)) {
+                ++_values_buffered;
+            }
+            if (rep_level_at(i) == 0) {
+                ++_record_starts;
+            }
+        }
+        _levels_buffered += levels_read;
+        discard_skipped();
+    }).handle_exception_type([this] (const std::exception& e){
+        throw parquet_exception(seastar::format(
+                    "In column {}: {}", _name, e.what()));
     });
 }
 
 template <typename L>
-inline int typed_primitive_reader<L>::current_def_level() {
-    return _def_level > 0 ? _def_levels[_levels_offset] : 0;
+inline void typed_primitive_reader<L>::skip_records(uint64_t n) {
+    if (n == 0) {
+        return;
+    }
+    _records_to_skip += n;
+    _skipping = true;
+    discard_skipped();
 }
 
 template <typename L>
-inline int typed_primitive_reader<L>::current_rep_level() {
-    return _rep_level > 0 ? _rep_levels[_levels_offset] : 0;
+inline void typed_primitive_reader<L>::discard_skipped() {
+    while (_skipping && _levels_offset < _levels_buffered) {
+        if (rep_level_at(_levels_offset) == 0) {
+            if (_records_to_skip == 0) {
+                _skipping = false;
+                break;
+            }
+            --_records_to_skip;
+        }
+        next();
+    }
+    if (_exhausted && _levels_offset == _levels_buffered) {
+        _records_to_skip = 0;
+        _skipping = false;
+    }
 }
 
 template <typename L>
-inline seastar::future<> typed_primitive_reader<L>::refill_when_empty() {
-    if (_levels_offset == _levels_buffered) {
-        return _source.read_batch(
-                _def_levels.size(),
-                _def_levels.data(),
-                _rep_levels.data(),
-                _values.data()
-        ).then([this] (size_t levels_read) {
-            _levels_buffered = levels_read;
-            _values_buffered = 0;
-            for (size_t i = 0; i < levels_read; ++i) {
-                if (_def_levels[i] == static_cast<int>(_def_level)) {
-                    ++_values_buffered;
-                }
+inline void typed_primitive_reader<L>::filter(const predicate& p, std::vector<bool>& selection) const {
+    if constexpr (L::physical_type == format::Type::INT96) {
+        throw parquet_exception(seastar::format("Predicate on INT96 column {}", _name));
+    } else {
+        predicate_internal::evaluator<L::physical_type> e{p, logical_type::get_sort_order(_logical_type)};
+        size_t value = _values_offset;
+        for (size_t i = 0; i < selection.size(); ++i) {
+            bool is_null = def_level_at(_levels_offset + i) < static_cast<int>(_def_level);
+            if (!selection[i]) {
+                value += !is_null;
+            } else if (is_null) {
+                selection[i] = e.test_null();
+            } else {
+                selection[i] = e.test(_values[value++]);
             }
-            _values_offset = 0;
-            _levels_offset = 0;
-        }).handle_exception_type([this] (const std::exception& e){
-            throw parquet_exception(seastar::format(
-                        "In column {}: {}", _name, e.what()));
-        });
+        }
     }
-    return seastar::make_ready_future<>();
 }
 
 template <typename L>
-inline seastar::future<std::optional<typename typed_primitive_reader<L>::triplet>> typed_primitive_reader<L>::next() {
-    return refill_when_empty().then([this] {
-        if (!_levels_buffered) {
-            return std::optional<triplet>{};
-        }
-        int16_t def_level = current_def_level();
-        int16_t rep_level = current_rep_level();
-        _levels_offset++;
-        bool is_null = def_level < static_cast<int>(_def_level);
-        if (is_null) {
-            return std::optional<triplet>{{def_level, rep_level, std::nullopt}};
+inline typename typed_primitive_reader<L>::triplet typed_primitive_reader<L>::next() {
+    if (_levels_offset == _levels_buffered) {
+        throw parquet_exception(seastar::format("No more values buffered in column {}", _name));
+    }
+    int16_t def_level = def_level_at(_levels_offset);
+    int16_t rep_level = rep_level_at(_levels_offset);
+    _levels_offset++;
+    if (rep_level == 0) {
+        --_record_starts;
+    }
+    bool is_null = def_level < static_cast<int>(_def_level);
+    if (is_null) {
+        return triplet{def_level, rep_level, std::nullopt};
+    }
+    if (_values_offset == _values_buffered) {
+        throw parquet_exception("Value was non-null, but has not been buffered");
+    }
+    output_type& val = _values[_values_offset++];
+    return triplet{def_level, rep_level, std::move(val)};
+}
+
+// Refills the leaves which don't hold a complete record, until all of them do
+// or are exhausted. Returns the number of records which can be assembled without refilling.
+inline seastar::future<size_t> prepare_leaves(const std::vector<primitive_reader_base*>& leaves) {
+    return seastar::repeat_until_value([&leaves] {
+        size_t records = std::numeric_limits<size_t>::max();
+        std::vector<seastar::future<>> refills;
+        for (primitive_reader_base* leaf : leaves) {
+            size_t buffered = leaf->buffered_records();
+            if (buffered == 0 && !leaf->exhausted()) {
+                refills.push_back(leaf->refill());
+            }
+            records = std::min(records, buffered);
         }
-        if (_values_offset == _values_buffered) {
-            throw parquet_exception("Value was non-null, but has not been buffered");
+        if (refills.empty()) {
+            return seastar::make_ready_future<std::optional<size_t>>(leaves.empty() ? 0 : records);
         }
-        output_type& val = _values[_values_offset++];
-        return std::optional<triplet>{{def_level, rep_level, std::move(val)}};
+        return seastar::when_all_succeed(refills.begin(), refills.end()).then([] {
+            return std::optional<size_t>{};
+        });
     });
 }
 
+inline seastar::future<size_t> record_reader::prepare() {
+    return prepare_leaves(_leaves);
+}
+
+// Skips the records before the next selected row. Returns the number of consecutive
+// selected rows which begin at the current position.
+inline uint64_t record_reader::skip_unselected() {
+    if (!_rows) {
+        return _end_row - _next_row;
+    }
+    const std::vector<uint64_t>& rows = *_rows;
+    if (_next_selected == rows.size()) {
+        return 0;
+    }
+    uint64_t row = rows[_next_selected];
+    if (row > _next_row) {
+        for (primitive_reader_base* leaf : _leaves) {
+            leaf->skip_records(row - _next_row);
+        }
+        _next_row = row;
+    }
+    size_t run = 1;
+    while (_next_selected + run < rows.size() && rows[_next_selected + run] == row + run) {
+        ++run;
+    }
+    return run;
+}
+
+inline void record_reader::advance(size_t records) {
+    _next_row += records;
+    if (_rows) {
+        _next_selected += records;
+    }
+}
+
+// Selects the next records which satisfy all predicates.
+inline void record_reader::select(size_t records) {
+    _selection.assign(records, true);
+    for (const auto& [p, leaf] : _predicates) {
+        leaf->filter(p, _selection);
+    }
+}
+
 template <typename Consumer>
-inline seastar::future<> record_reader::read_one(Consumer& c) {
+inline void record_reader::assemble_one(Consumer& c) {
     c.start_record();
-    return seastar::do_for_each(_field_readers, [this, &c] (auto& child) {
-        return child.current_levels().then([this, &c, &child] (int def, int) {
-            c.start_column(child.name());
-            return std::visit(overloaded {
-                [this, def, &c] (optional_reader& typed_child) {
-                    if (def > 0) {
-                        return typed_child.read_field(c);
-                    } else {
-                        c.append_null();
-                        return typed_child.skip_field();
-                    }
-                },
-                [this, &c] (auto& typed_child) {
-                    return typed_child.read_field(c);
-                }
-            }, child._reader);
+    for (field_reader& child : _field_readers) {
+        c.start_column(child.name());
+        child.read_field(c);
+    }
+    c.end_record();
+    for (field_reader& reader : _filter_readers) {
+        reader.skip_field();
+    }
+}
+
+inline void record_reader::skip_one() {
+    for (field_reader& reader : _field_readers) {
+        reader.skip_field();
+    }
+    for (field_reader& reader : _filter_readers) {
+        reader.skip_field();
+    }
+}
+
+template <typename Consumer>
+inline seastar::future<> record_reader::read_one(Consumer& c) {
+    return seastar::repeat([this, &c] {
+        if (skip_unselected() == 0) {
+            return seastar::make_exception_future<seastar::stop_iteration>(parquet_exception("No more records"));
+        }
+        return prepare().then([this, &c] (size_t records) {
+            if (records == 0) {
+                throw parquet_exception("No more records");
+            }
+            select(1);
+            advance(1);
+            if (!_selection[0]) {
+                skip_one();
+                return seastar::stop_iteration::no;
+            }
+            assemble_one(c);
+            return seastar::stop_iteration::yes;
         });
-    }).then([&c] {
-        c.end_record();
     });
 }
 
 template <typename Consumer>
 inline seastar::future<> record_reader::read_all(Consumer& c) {
     return seastar::repeat([this, &c] {
-        return current_levels().then([this, &c] (int def, int) {
-            if (def < 0) {
-                return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
+        uint64_t selected = skip_unselected();
+        if (selected == 0) {
+            return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
+        }
+        return prepare().then([this, &c, selected] (size_t records) {
+            records = std::min<uint64_t>(records, selected);
+            if (records == 0) {
+                return seastar::stop_iteration::yes;
+            }
+            advance(records);
+            if (_predicates.empty()) {
+                for (size_t i = 0; i < records; ++i) {
+                    assemble_one(c);
+                }
             } else {
-                return read_one<Consumer>(c).then([] { return seastar::stop_iteration::no; });
+                select(records);
+                for (size_t i = 0; i < records; ++i) {
+                    if (_selection[i]) {
+                        assemble_one(c);
+                    } else {
+                        skip_one();
+                    }
+                }
             }
+            return seastar::stop_iteration::no;
         });
     });
 }
 
+inline seastar::future<int, int> record_reader::current_levels() {
+    return prepare().then([this] (size_t) {
+        if (_field_readers.empty()) {
+            return seastar::make_ready_future<int, int>(-1, -1);
+        }
+        auto [def, rep] = _field_readers[0].current_levels();
+        return seastar::make_ready_future<int, int>(def, rep);
+    });
+}
+
 } // namespace parquet4seastar::record
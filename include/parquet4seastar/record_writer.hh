@@ -0,0 +1,220 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/file_writer.hh>
+#include <parquet4seastar/writer_schema.hh>
+
+namespace parquet4seastar::record {
+
+namespace record_writer_internal {
+
+// The levels and values of one column, buffered until record_writer::flush().
+template <format::Type::type ParquetType>
+class column_buffer {
+public:
+    using input_type = typename value_encoder<ParquetType>::input_type;
+    static constexpr format::Type::type parquet_type = ParquetType;
+private:
+    static constexpr bool is_byte_array =
+            ParquetType == format::Type::BYTE_ARRAY || ParquetType == format::Type::FIXED_LEN_BYTE_ARRAY;
+    std::string _name;
+    // For FIXED_LEN_BYTE_ARRAY: the size of every value.
+    std::optional<uint32_t> _type_length;
+    std::vector<int32_t> _def;
+    std::vector<int32_t> _rep;
+    std::vector<input_type> _values;
+    // Byte arrays are copied, so that the caller's buffers don't have to outlive the batch.
+    bytes _arena;
+    std::vector<size_t> _ends;
+public:
+    explicit column_buffer(std::string name, std::optional<uint32_t> type_length = {})
+        : _name{std::move(name)}
+        , _type_length{type_length} {}
+
+    void put_null(uint32_t def, uint32_t rep) {
+        _def.push_back(def);
+        _rep.push_back(rep);
+    }
+
+    template <typename T>
+    void put(uint32_t def, uint32_t rep, const T& value) {
+        if constexpr (is_byte_array && std::is_convertible_v<const T&, bytes_view>) {
+            bytes_view v = value;
+            if (ParquetType == format::Type::FIXED_LEN_BYTE_ARRAY && _type_length && v.size() != *_type_length) {
+                throw parquet_exception(seastar::format(
+                        "Value of size {} appended to column {} of fixed length {}", v.size(), _name, *_type_length));
+            }
+            _arena.append(v);
+            _ends.push_back(_arena.size());
+        } else if constexpr (!is_byte_array && (std::is_same_v<T, input_type>
+                || (ParquetType == format::Type::BOOLEAN && std::is_same_v<T, bool>))) {
+            _values.push_back(value);
+        } else {
+            throw parquet_exception(seastar::format(
+                    "Value of a wrong type appended to column {} of type {}", _name, ParquetType));
+        }
+        put_null(def, rep);
+    }
+
+    void flush(column_chunk_writer<ParquetType>& writer) {
+        if constexpr (is_byte_array) {
+            _values.reserve(_ends.size());
+            size_t start = 0;
+            for (size_t end : _ends) {
+                _values.push_back(bytes_view{_arena.data() + start, end - start});
+                start = end;
+            }
+        }
+        writer.put_batch(_def.size(), _def.data(), _rep.data(), _values.data());
+        _def.clear();
+        _rep.clear();
+        _values.clear();
+        _arena.clear();
+        _ends.clear();
+    }
+};
+
+using any_column_buffer = std::variant<
+    column_buffer<format::Type::BOOLEAN>,
+    column_buffer<format::Type::INT32>,
+    column_buffer<format::Type::INT64>,
+    column_buffer<format::Type::FLOAT>,
+    column_buffer<format::Type::DOUBLE>,
+    column_buffer<format::Type::BYTE_ARRAY>,
+    column_buffer<format::Type::FIXED_LEN_BYTE_ARRAY>
+>;
+
+enum class node_kind { primitive, group, list, map };
+
+// writer_schema::node, with the column numbers of its leaves.
+struct node {
+    node_kind kind;
+    std::string name;
+    bool optional;
+    // For lists and maps: the repetition level of their elements.
+    uint32_t rep_level;
+    // The leaves of the node are columns [first_column, end_column).
+    size_t first_column;
+    size_t end_column;
+    // Fields of a group, the element of a list, or the key and value of a map.
+    std::vector<node> children;
+};
+
+} // namespace record_writer_internal
+
+struct record_writer_options {
+    // Records are shredded into buffers, which are passed to the column writers
+    // in batches of this many records.
+    size_t batch_size = 1024;
+};
+
+/* Shreds records into the columns of a file_writer.
+ * The records are pushed with calls mirroring the consumer callbacks of record_reader:
+ *
+ *   start_record();
+ *   start_column("List"); start_list();
+ *       start_struct(); start_field("a"); append_value(1.0f); end_struct();
+ *       append_null();
+ *   end_list();
+ *   end_record();
+ *
+ * start_column() and start_field() select the next field by name. They may skip fields
+ * (which are then null), but they can't go back. If they aren't called, the fields are filled
+ * in schema order. Fields which are missing at the end of a struct or record are null.
+ * separate_list_values(), separate_key_value() and separate_map_values() may be called
+ * for symmetry with record_reader, but they are not required.
+ *
+ * append_value() takes the input type of the column's physical type (see column_chunk_writer),
+ * or bool for BOOLEAN. Byte arrays are copied.
+ *
+ * Records are buffered. Call flush() (or maybe_flush_row_group() or close() of this class)
+ * before flushing or closing the file_writer directly.
+ * After an exception (e.g. a null in a required field), the file is unusable.
+ */
+class record_writer {
+    using node = record_writer_internal::node;
+    struct frame {
+        const node* n;
+        // The definition level of the values in this frame.
+        uint32_t def_level;
+        // The number of fields (of a group) or values (of a list or map) filled so far.
+        size_t filled = 0;
+    };
+    file_writer& _file_writer;
+    record_writer_options _options;
+    node _root;
+    std::vector<record_writer_internal::any_column_buffer> _columns;
+    // The repetition level of the next level of each column.
+    std::vector<uint32_t> _next_rep;
+    std::vector<frame> _stack;
+    size_t _buffered_records = 0;
+private:
+    frame& top();
+    const node& start_value();
+    void put_nulls(const node& n, uint32_t def);
+    void fill_group();
+public:
+    record_writer(file_writer& fw, const writer_schema::schema& schema, record_writer_options options = {});
+
+    void start_record();
+    void end_record();
+    void start_column(const std::string& name) { start_field(name); }
+    void start_field(const std::string& name);
+    void start_struct();
+    void end_struct();
+    void start_list();
+    void end_list();
+    void separate_list_values() {}
+    void start_map();
+    void end_map();
+    void separate_key_value() {}
+    void separate_map_values() {}
+    void append_null();
+    template <typename T>
+    void append_value(const T& value);
+
+    // Pass the buffered records to the column writers.
+    void flush();
+    size_t buffered_records() const { return _buffered_records; }
+    seastar::future<> maybe_flush_row_group() {
+        flush();
+        return _file_writer.maybe_flush_row_group();
+    }
+    seastar::future<> close() {
+        flush();
+        return _file_writer.close();
+    }
+};
+
+template <typename T>
+void record_writer::append_value(const T& value) {
+    const node& n = start_value();
+    if (n.kind != record_writer_internal::node_kind::primitive) {
+        throw parquet_exception(seastar::format("A value appended to {}, which is not a primitive", n.name));
+    }
+    uint32_t def = top().def_level + n.optional;
+    uint32_t rep = _next_rep[n.first_column];
+    std::visit([&] (auto& column) { column.put(def, rep, value); }, _columns[n.first_column]);
+}
+
+} // namespace parquet4seastar::record
@@ -199,6 +199,11 @@ class RleEncoder {
   /// This value must be representable with bit_width_ bits.
   bool Put(uint64_t value);
 
+  /// Encode up to count copies of value, if they continue the current repeated run
+  /// (i.e. Put(value) would take its fast path). Returns the number of values encoded,
+  /// which may be 0. Equivalent to calling Put(value) that many times.
+  int PutRepeated(uint64_t value, int count);
+
   /// Flushes any pending values to the underlying buffer.
   /// Returns the total number of bytes written
   int Flush();
@@ -380,6 +385,16 @@ inline bool RleEncoder::Put(uint64_t value) {
   return true;
 }
 
+inline int RleEncoder::PutRepeated(uint64_t value, int count) {
+  if (buffer_full_ || current_value_ != value || repeat_count_ < 8) return 0;
+  // Keep the run length representable in the indicator varint.
+  constexpr int kMaxRepeatCount = 1 << 30;
+  int n = std::min(count, kMaxRepeatCount - repeat_count_);
+  if (n <= 0) return 0;
+  repeat_count_ += n;
+  return n;
+}
+
 inline void RleEncoder::FlushLiteralRun(bool update_indicator_byte) {
   if (literal_indicator_byte_ == NULL) {
     // The literal indicator byte has not been reserved yet, get one now.
@@ -0,0 +1,278 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/file_writer.hh>
+#include <parquet4seastar/io.hh>
+#include <seastar/core/sharded.hh>
+
+namespace parquet4seastar {
+
+namespace sharded_file_writer_internal {
+
+// A column chunk flushed to memory on the shard of its column,
+// to be written to the file by the shard which owns the file.
+struct flushed_chunk {
+    // Offsets are relative to the beginning of the chunk.
+    format::ColumnMetaData metadata;
+    page_index index;
+    buffer_chain data;
+    // The bitset of the bloom filter of the chunk, if enabled. It's copied out of the column writer,
+    // which may flush its next chunk before this one is written.
+    std::optional<bytes> bloom_filter_bitset;
+    uint64_t rows = 0;
+};
+
+// The column writers of a sharded_file_writer which live on one shard:
+// columns this_shard_id(), this_shard_id() + smp::count, this_shard_id() + 2 * smp::count, ...
+class column_shard {
+    static constexpr size_t CHUNK_BUFFER_SIZE = 128 * 1024;
+    std::vector<column_chunk_writer_variant> _writers;
+private:
+    static seastar::future<> flush_chunk(column_chunk_writer_variant& writer, flushed_chunk& chunk) {
+        return std::visit([&chunk] (auto& x) {
+            chunk.rows = x.rows_written();
+            auto buffers = seastar::make_lw_shared<buffer_chain>();
+            seastar::output_stream<char> sink = make_memory_output_stream(buffers, CHUNK_BUFFER_SIZE);
+            return seastar::do_with(std::move(sink), [&x, &chunk, buffers] (seastar::output_stream<char>& sink) {
+                return x.flush_chunk(sink).then([&x, &chunk, &sink] (seastar::lw_shared_ptr<format::ColumnMetaData> cmd) {
+                    chunk.metadata = std::move(*cmd);
+                    chunk.index = x.take_page_index();
+                    if (const bloom_filter* filter = x.flushed_bloom_filter()) {
+                        chunk.bloom_filter_bitset = bytes(filter->view());
+                    }
+                    return sink.close();
+                }).then([&chunk, buffers] {
+                    chunk.data = std::move(*buffers);
+                });
+            });
+        }, writer);
+    }
+public:
+    explicit column_shard(const std::vector<column_writer_config>& configs) {
+        for (size_t i = seastar::this_shard_id(); i < configs.size(); i += seastar::smp::count) {
+            _writers.push_back(make_column_chunk_writer(configs[i]));
+        }
+    }
+
+    template <format::Type::type ParquetType>
+    column_chunk_writer<ParquetType>& column(size_t i) {
+        return std::get<column_chunk_writer<ParquetType>>(_writers[i / seastar::smp::count]);
+    }
+
+    // Only meaningful on the shard of column 0.
+    size_t rows_in_row_group() const {
+        if (_writers.empty()) {
+            return 0;
+        }
+        return std::visit([] (const auto& x) { return x.rows_written(); }, _writers[0]);
+    }
+
+    size_t estimated_row_group_size() const {
+        size_t size = 0;
+        for (const auto& writer : _writers) {
+            std::visit([&] (const auto& x) {size += x.estimated_chunk_size();}, writer);
+        }
+        return size;
+    }
+
+    seastar::future<> backpressure() {
+        return seastar::do_for_each(_writers, [] (column_chunk_writer_variant& writer) {
+            return std::visit([] (auto& x) { return x.backpressure(); }, writer);
+        });
+    }
+
+    // Flushes the chunks of all columns of this shard to memory, in column order.
+    seastar::future<seastar::foreign_ptr<std::unique_ptr<std::vector<flushed_chunk>>>> flush_chunks() {
+        using it = boost::counting_iterator<size_t>;
+        auto chunks = std::make_unique<std::vector<flushed_chunk>>(_writers.size());
+        std::vector<flushed_chunk>& chunks_ref = *chunks;
+        return seastar::do_for_each(it(0), it(_writers.size()), [this, &chunks_ref] (size_t i) {
+            return flush_chunk(_writers[i], chunks_ref[i]);
+        }).then([chunks = std::move(chunks)] () mutable {
+            return seastar::make_foreign(std::move(chunks));
+        });
+    }
+
+    seastar::future<> stop() {
+        return seastar::do_for_each(_writers, [] (column_chunk_writer_variant& writer) {
+            return std::visit([] (auto& x) { return x.close(); }, writer);
+        });
+    }
+};
+
+} // namespace sharded_file_writer_internal
+
+/* A file_writer whose columns are encoded and compressed on all shards.
+ * Column i lives on shard shard_of(i) and is written through invoke_on_column().
+ * When a row group is flushed, every shard flushes its chunks to memory in parallel,
+ * and the shard which opened the writer writes them to the file in column order.
+ * All methods other than invoke_on_column() must be called from that shard.
+ *
+ * Row groups are assembled in memory, so file_writer_options::memory_budget is unsupported.
+ * close() has to be called before the writer is destroyed.
+ */
+class sharded_file_writer {
+    using column_shard = sharded_file_writer_internal::column_shard;
+    using flushed_chunk = sharded_file_writer_internal::flushed_chunk;
+    // Assembles the file. Has no column writers of its own.
+    std::unique_ptr<file_writer> _fw;
+    seastar::sharded<column_shard> _shards;
+    size_t _columns = 0;
+private:
+    sharded_file_writer() = default;
+
+    static seastar::future<std::unique_ptr<sharded_file_writer>>
+    start(std::unique_ptr<file_writer> fw, std::vector<column_writer_config> configs) {
+        auto sfw = std::unique_ptr<sharded_file_writer>(new sharded_file_writer{});
+        sfw->_fw = std::move(fw);
+        sfw->_columns = configs.size();
+        seastar::sharded<column_shard>& shards = sfw->_shards;
+        return shards.start(std::move(configs)).then([sfw = std::move(sfw)] () mutable {
+            return std::move(sfw);
+        });
+    }
+
+    template <typename Sink>
+    static seastar::future<std::unique_ptr<sharded_file_writer>>
+    open_sink(Sink&& sink, const writer_schema::schema& schema, file_writer_options options) {
+        return seastar::futurize_invoke([&schema, &sink, options = std::move(options)] () mutable {
+            if (options.memory_budget) {
+                throw parquet_exception("memory_budget is unsupported by sharded_file_writer");
+            }
+            std::vector<column_writer_config> configs = column_writer_configs(schema, options.column_options);
+            auto fw = file_writer::make(schema, std::move(options));
+            return file_writer::open_sink(std::move(fw), std::forward<Sink>(sink)).then(
+            [configs = std::move(configs)] (std::unique_ptr<file_writer> fw) mutable {
+                return start(std::move(fw), std::move(configs));
+            });
+        });
+    }
+public:
+    static seastar::future<std::unique_ptr<sharded_file_writer>>
+    open(const std::string& path, const writer_schema::schema& schema, file_writer_options options = {}) {
+        return open_sink(path, schema, std::move(options));
+    }
+
+    // See file_writer::open().
+    static seastar::future<std::unique_ptr<sharded_file_writer>>
+    open(seastar::output_stream<char> sink, const writer_schema::schema& schema, file_writer_options options = {}) {
+        return open_sink(std::move(sink), schema, std::move(options));
+    }
+
+    seastar::shard_id shard_of(size_t column) const {
+        return column % seastar::smp::count;
+    }
+
+    // Calls func(column_chunk_writer<ParquetType>&) for column i, on the shard of the column.
+    // func may return a future. It is moved to the shard of the column.
+    template <format::Type::type ParquetType, typename Func>
+    auto invoke_on_column(size_t i, Func func) {
+        return _shards.invoke_on(shard_of(i), [i, func = std::move(func)] (column_shard& shard) mutable {
+            return seastar::futurize_invoke(func, shard.column<ParquetType>(i));
+        });
+    }
+
+    seastar::future<size_t> rows_in_row_group() {
+        if (_columns == 0) {
+            return seastar::make_ready_future<size_t>(0);
+        }
+        return _shards.invoke_on(shard_of(0), [] (column_shard& shard) {
+            return shard.rows_in_row_group();
+        });
+    }
+
+    // Includes the unflushed pages.
+    seastar::future<size_t> estimated_row_group_size() {
+        return _shards.map_reduce0([] (column_shard& shard) {
+            return shard.estimated_row_group_size();
+        }, size_t(0), std::plus<size_t>());
+    }
+
+    // Flush the row group if it has reached the target size. Waits for the backpressure
+    // of background compression on all shards first (see column_chunk_writer::backpressure()).
+    // Should be called periodically by the user, but only on row boundaries,
+    // i.e. when all columns received the same rows.
+    seastar::future<> maybe_flush_row_group() {
+        return _shards.invoke_on_all([] (column_shard& shard) {
+            return shard.backpressure();
+        }).then([this] {
+            return estimated_row_group_size();
+        }).then([this] (size_t size) {
+            if (size >= _fw->_options.target_row_group_size) {
+                return flush_row_group();
+            }
+            return seastar::make_ready_future<>();
+        });
+    }
+
+    seastar::future<> flush_row_group() {
+        using it = boost::counting_iterator<size_t>;
+        using shard_chunks = seastar::foreign_ptr<std::unique_ptr<std::vector<flushed_chunk>>>;
+        auto chunks = seastar::make_lw_shared<std::vector<shard_chunks>>(seastar::smp::count);
+        return seastar::parallel_for_each(it(0), it(seastar::smp::count), [this, chunks] (size_t shard) {
+            return _shards.invoke_on(shard, [] (column_shard& s) {
+                return s.flush_chunks();
+            }).then([chunks, shard] (shard_chunks flushed) {
+                (*chunks)[shard] = std::move(flushed);
+            });
+        }).then([this, chunks] {
+            auto chunk = [this, chunks] (size_t i) -> const flushed_chunk& {
+                return (*(*chunks)[shard_of(i)])[i / seastar::smp::count];
+            };
+            _fw->start_row_group(_columns > 0 ? chunk(0).rows : 0);
+            return seastar::do_for_each(it(0), it(_columns), [this, chunk] (size_t i) {
+                const flushed_chunk& c = chunk(i);
+                return seastar::do_for_each(c.data, [this] (const seastar::temporary_buffer<char>& buf) {
+                    return _fw->_sink.write(buf.get(), buf.size());
+                }).then([this, i, &c] {
+                    format::ColumnMetaData cmd = c.metadata;
+                    return _fw->finish_chunk(i, cmd, c.index);
+                });
+            }).then([this, chunk] {
+                return seastar::do_for_each(it(0), it(_columns), [this, chunk] (size_t i) {
+                    const std::optional<bytes>& bitset = chunk(i).bloom_filter_bitset;
+                    if (!bitset) {
+                        return seastar::make_ready_future<>();
+                    }
+                    return _fw->write_bloom_filter(i, bytes_view(*bitset));
+                });
+            });
+        });
+    }
+
+    seastar::future<> close() {
+        return rows_in_row_group().then([this] (size_t rows) {
+            if (!_fw->_metadata.row_groups.empty() && rows == 0) {
+                // Don't leave an empty row group behind maybe_flush_row_group().
+                return seastar::make_ready_future<>();
+            }
+            return flush_row_group();
+        }).then([this] {
+            return _fw->write_footer();
+        }).finally([this] {
+            return _shards.stop();
+        });
+    }
+};
+
+} // namespace parquet4seastar
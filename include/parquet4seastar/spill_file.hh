@@ -0,0 +1,71 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/bytes.hh>
+#include <seastar/core/file.hh>
+#include <seastar/core/fstream.hh>
+#include <seastar/core/temporary_buffer.hh>
+
+namespace parquet4seastar {
+
+/* A temporary file, to which column writers move their buffered pages
+ * when the file writer exceeds its memory budget.
+ * The file is removed from the directory right after it is created,
+ * so it doesn't outlive the writer even if the process crashes.
+ *
+ * Writes are staged in an aligned buffer and written with DMA.
+ * flush() pads the staged data to the disk alignment, so the data
+ * written between two copy_to() calls is a list of contiguous regions.
+ */
+class spill_file {
+    static constexpr size_t STAGING_SIZE = 128 * 1024;
+    static constexpr size_t READ_SIZE = 128 * 1024;
+    struct region {
+        uint64_t pos;
+        uint64_t size;
+    };
+    seastar::file _file;
+    seastar::temporary_buffer<char> _staging;
+    size_t _staged = 0;
+    // The file position of the beginning of the staging buffer.
+    uint64_t _pos = 0;
+    std::vector<region> _regions;
+    uint64_t _size = 0;
+private:
+    explicit spill_file(seastar::file file);
+    seastar::future<> write_staging(size_t len);
+public:
+    static seastar::future<spill_file> open(const std::string& directory);
+    // Append data to the file. data has to stay alive until the returned future resolves.
+    seastar::future<> write(bytes_view data);
+    // Write out the staged data.
+    seastar::future<> flush();
+    // The number of bytes written since the last copy_to().
+    uint64_t size() const { return _size; }
+    // Copy everything written since the last copy_to() to the sink, in order,
+    // and then start over from the beginning of the file.
+    seastar::future<> copy_to(seastar::output_stream<char>& sink);
+    seastar::future<> close();
+};
+
+} // namespace parquet4seastar
@@ -0,0 +1,369 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/record_reader.hh>
+
+namespace parquet4seastar::record {
+
+/* A schema known at compile time, for static_record_reader.
+ * It mirrors reader_schema, e.g. a file with a required INT32 column and an optional
+ * list of strings is described by:
+ *
+ *   static_schema::schema<
+ *       static_schema::primitive_node<logical_type::INT32>,
+ *       static_schema::optional_node<static_schema::list_node<
+ *           static_schema::primitive_node<logical_type::STRING>>>>
+ *
+ * Names aren't part of the description. They are taken from the file.
+ */
+namespace static_schema {
+
+template <typename LogicalType> struct primitive_node {};
+template <typename Child> struct optional_node {};
+template <typename... Fields> struct struct_node {};
+template <typename Element> struct list_node {};
+template <typename Key, typename Value> struct map_node {};
+template <typename... Fields> struct schema {};
+
+} // namespace static_schema
+
+/* The counterparts of the field readers in record_reader.hh, specialized for a static schema.
+ * The whole reader tree is a single type, so the assembly of a record is inlined
+ * into one function, without variant dispatch.
+ */
+template <typename Node>
+class static_field_reader;
+
+template <typename LogicalType>
+class static_field_reader<static_schema::primitive_node<LogicalType>> {
+    typed_primitive_reader<LogicalType> _reader;
+public:
+    explicit static_field_reader(typed_primitive_reader<LogicalType>&& reader) : _reader(std::move(reader)) {}
+
+    template <typename Consumer>
+    void read_field(Consumer& c) { _reader.read_field(c); }
+    void skip_field() { _reader.skip_field(); }
+    std::pair<int, int> current_levels() const { return _reader.current_levels(); }
+    const std::string& name() const { return _reader.name(); }
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves) { leaves.push_back(&_reader); }
+
+    static bool matches(const reader_schema::node& node_variant) {
+        const auto* node = std::get_if<reader_schema::primitive_node>(&node_variant);
+        return node && std::holds_alternative<LogicalType>(node->logical_type);
+    }
+    static seastar::future<static_field_reader>
+    make(file_reader& fr, const reader_schema::node& node_variant, int row_group) {
+        const auto& node = std::get<reader_schema::primitive_node>(node_variant);
+        return fr.open_column_chunk_reader<LogicalType::physical_type>(row_group, node.column_index).then(
+        [&node] (column_chunk_reader<LogicalType::physical_type> ccr) {
+            return static_field_reader{typed_primitive_reader<LogicalType>{node, std::move(ccr)}};
+        });
+    }
+};
+
+template <typename Child>
+class static_field_reader<static_schema::optional_node<Child>> {
+    static_field_reader<Child> _reader;
+    uint32_t _def_level;
+    std::string _name;
+public:
+    static_field_reader(const reader_schema::optional_node& node, static_field_reader<Child>&& reader)
+        : _reader(std::move(reader)), _def_level{node.def_level}, _name(node.info.name) {}
+
+    template <typename Consumer>
+    void read_field(Consumer& c) {
+        if (current_levels().first > static_cast<int>(_def_level)) {
+            _reader.read_field(c);
+        } else {
+            c.append_null();
+            _reader.skip_field();
+        }
+    }
+    void skip_field() { _reader.skip_field(); }
+    std::pair<int, int> current_levels() const { return _reader.current_levels(); }
+    const std::string& name() const { return _name; }
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves) { _reader.collect_leaves(leaves); }
+
+    static bool matches(const reader_schema::node& node_variant) {
+        const auto* node = std::get_if<reader_schema::optional_node>(&node_variant);
+        return node && static_field_reader<Child>::matches(*node->child);
+    }
+    static seastar::future<static_field_reader>
+    make(file_reader& fr, const reader_schema::node& node_variant, int row_group) {
+        const auto& node = std::get<reader_schema::optional_node>(node_variant);
+        return static_field_reader<Child>::make(fr, *node.child, row_group).then(
+        [&node] (static_field_reader<Child> child) {
+            return static_field_reader{node, std::move(child)};
+        });
+    }
+};
+
+template <typename... Fields>
+class static_field_reader<static_schema::struct_node<Fields...>> {
+    static_assert(sizeof...(Fields) > 0, "Empty structs are not supported");
+    std::tuple<static_field_reader<Fields>...> _readers;
+    std::string _name;
+public:
+    static_field_reader(const reader_schema::struct_node& node, std::tuple<static_field_reader<Fields>...>&& readers)
+        : _readers(std::move(readers)), _name(node.info.name) {}
+
+    template <typename Consumer>
+    void read_field(Consumer& c) {
+        c.start_struct();
+        std::apply([&c] (auto&... child) {
+            ((c.start_field(child.name()), child.read_field(c)), ...);
+        }, _readers);
+        c.end_struct();
+    }
+    void skip_field() {
+        std::apply([] (auto&... child) { (child.skip_field(), ...); }, _readers);
+    }
+    std::pair<int, int> current_levels() const { return std::get<0>(_readers).current_levels(); }
+    const std::string& name() const { return _name; }
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves) {
+        std::apply([&leaves] (auto&... child) { (child.collect_leaves(leaves), ...); }, _readers);
+    }
+
+    static bool matches(const reader_schema::node& node_variant) {
+        const auto* node = std::get_if<reader_schema::struct_node>(&node_variant);
+        return node && node->fields.size() == sizeof...(Fields)
+                && fields_match(*node, std::index_sequence_for<Fields...>{});
+    }
+    static seastar::future<static_field_reader>
+    make(file_reader& fr, const reader_schema::node& node_variant, int row_group) {
+        const auto& node = std::get<reader_schema::struct_node>(node_variant);
+        return make_fields(fr, node, row_group, std::index_sequence_for<Fields...>{});
+    }
+private:
+    template <size_t... I>
+    static bool fields_match(const reader_schema::struct_node& node, std::index_sequence<I...>) {
+        return (static_field_reader<Fields>::matches(node.fields[I]) && ...);
+    }
+    template <size_t... I>
+    static seastar::future<static_field_reader>
+    make_fields(file_reader& fr, const reader_schema::struct_node& node, int row_group, std::index_sequence<I...>) {
+        return seastar::when_all_succeed(static_field_reader<Fields>::make(fr, node.fields[I], row_group)...).then(
+        [&node] (static_field_reader<Fields>... readers) {
+            return static_field_reader{node, std::make_tuple(std::move(readers)...)};
+        });
+    }
+};
+
+template <typename Element>
+class static_field_reader<static_schema::list_node<Element>> {
+    static_field_reader<Element> _reader;
+    uint32_t _def_level;
+    uint32_t _rep_level;
+    std::string _name;
+public:
+    static_field_reader(const reader_schema::list_node& node, static_field_reader<Element>&& reader)
+        : _reader(std::move(reader))
+        , _def_level{node.def_level}
+        , _rep_level{node.rep_level}
+        , _name(node.info.name) {}
+
+    template <typename Consumer>
+    void read_field(Consumer& c) {
+        c.start_list();
+        if (current_levels().first > static_cast<int>(_def_level)) {
+            _reader.read_field(c);
+            while (current_levels().second > static_cast<int>(_rep_level)) {
+                c.separate_list_values();
+                _reader.read_field(c);
+            }
+        } else {
+            _reader.skip_field();
+        }
+        c.end_list();
+    }
+    void skip_field() { _reader.skip_field(); }
+    std::pair<int, int> current_levels() const { return _reader.current_levels(); }
+    const std::string& name() const { return _name; }
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves) { _reader.collect_leaves(leaves); }
+
+    static bool matches(const reader_schema::node& node_variant) {
+        const auto* node = std::get_if<reader_schema::list_node>(&node_variant);
+        return node && static_field_reader<Element>::matches(*node->element);
+    }
+    static seastar::future<static_field_reader>
+    make(file_reader& fr, const reader_schema::node& node_variant, int row_group) {
+        const auto& node = std::get<reader_schema::list_node>(node_variant);
+        return static_field_reader<Element>::make(fr, *node.element, row_group).then(
+        [&node] (static_field_reader<Element> element) {
+            return static_field_reader{node, std::move(element)};
+        });
+    }
+};
+
+template <typename Key, typename Value>
+class static_field_reader<static_schema::map_node<Key, Value>> {
+    static_field_reader<Key> _key_reader;
+    static_field_reader<Value> _value_reader;
+    uint32_t _def_level;
+    uint32_t _rep_level;
+    std::string _name;
+public:
+    static_field_reader(
+            const reader_schema::map_node& node,
+            static_field_reader<Key>&& key_reader,
+            static_field_reader<Value>&& value_reader)
+        : _key_reader(std::move(key_reader))
+        , _value_reader(std::move(value_reader))
+        , _def_level{node.def_level}
+        , _rep_level{node.rep_level}
+        , _name(node.info.name) {}
+
+    template <typename Consumer>
+    void read_field(Consumer& c) {
+        c.start_map();
+        if (current_levels().first > static_cast<int>(_def_level)) {
+            read_pair(c);
+            while (current_levels().second > static_cast<int>(_rep_level)) {
+                c.separate_map_values();
+                read_pair(c);
+            }
+        } else {
+            skip_field();
+        }
+        c.end_map();
+    }
+    void skip_field() {
+        _key_reader.skip_field();
+        _value_reader.skip_field();
+    }
+    std::pair<int, int> current_levels() const { return _key_reader.current_levels(); }
+    const std::string& name() const { return _name; }
+    void collect_leaves(std::vector<primitive_reader_base*>& leaves) {
+        _key_reader.collect_leaves(leaves);
+        _value_reader.collect_leaves(leaves);
+    }
+
+    static bool matches(const reader_schema::node& node_variant) {
+        const auto* node = std::get_if<reader_schema::map_node>(&node_variant);
+        return node && static_field_reader<Key>::matches(*node->key) && static_field_reader<Value>::matches(*node->value);
+    }
+    static seastar::future<static_field_reader>
+    make(file_reader& fr, const reader_schema::node& node_variant, int row_group) {
+        const auto& node = std::get<reader_schema::map_node>(node_variant);
+        return seastar::when_all_succeed(
+                static_field_reader<Key>::make(fr, *node.key, row_group),
+                static_field_reader<Value>::make(fr, *node.value, row_group)
+        ).then([&node] (static_field_reader<Key> key, static_field_reader<Value> value) {
+            return static_field_reader{node, std::move(key), std::move(value)};
+        });
+    }
+private:
+    template <typename Consumer>
+    void read_pair(Consumer& c) {
+        _key_reader.read_field(c);
+        c.separate_key_value();
+        _value_reader.read_field(c);
+    }
+};
+
+/* A record_reader for files whose schema is known at compile time.
+ * The interface and the consumer callbacks are the same as those of record_reader,
+ * which remains the fallback for other files:
+ *
+ *   if (static_record_reader<S>::matches(fr.schema())) {
+ *       ... static_record_reader<S>::make(fr, row_group) ...
+ *   } else {
+ *       ... record_reader::make(fr, row_group) ...
+ *   }
+ */
+template <typename Schema>
+class static_record_reader;
+
+template <typename... Fields>
+class static_record_reader<static_schema::schema<Fields...>> {
+    static_assert(sizeof...(Fields) > 0, "Empty schemas are not supported");
+    // Allocated, so that the leaves don't move with the reader.
+    struct tree {
+        std::tuple<static_field_reader<Fields>...> readers;
+        std::vector<primitive_reader_base*> leaves;
+    };
+    std::unique_ptr<tree> _tree;
+    explicit static_record_reader(std::tuple<static_field_reader<Fields>...>&& readers)
+        : _tree{std::make_unique<tree>(tree{std::move(readers), {}})} {
+        std::apply([this] (auto&... reader) { (reader.collect_leaves(_tree->leaves), ...); }, _tree->readers);
+    }
+    template <typename Consumer>
+    void assemble_one(Consumer& c) {
+        c.start_record();
+        std::apply([&c] (auto&... reader) {
+            ((c.start_column(reader.name()), reader.read_field(c)), ...);
+        }, _tree->readers);
+        c.end_record();
+    }
+    template <size_t... I>
+    static bool fields_match(const reader_schema::schema& schema, std::index_sequence<I...>) {
+        return (static_field_reader<Fields>::matches(schema.fields[I]) && ...);
+    }
+    template <size_t... I>
+    static seastar::future<static_record_reader>
+    make_fields(file_reader& fr, int row_group, std::index_sequence<I...>) {
+        const reader_schema::schema& schema = fr.schema();
+        return seastar::when_all_succeed(static_field_reader<Fields>::make(fr, schema.fields[I], row_group)...).then(
+        [] (static_field_reader<Fields>... readers) {
+            return static_record_reader{std::make_tuple(std::move(readers)...)};
+        });
+    }
+public:
+    static bool matches(const reader_schema::schema& schema) {
+        return schema.fields.size() == sizeof...(Fields) && fields_match(schema, std::index_sequence_for<Fields...>{});
+    }
+    static seastar::future<static_record_reader> make(file_reader& fr, int row_group) {
+        if (!matches(fr.schema())) {
+            return seastar::make_exception_future<static_record_reader>(
+                    parquet_exception("The schema of the file doesn't match the static schema"));
+        }
+        return make_fields(fr, row_group, std::index_sequence_for<Fields...>{});
+    }
+
+    template <typename Consumer>
+    seastar::future<> read_one(Consumer& c) {
+        return prepare_leaves(_tree->leaves).then([this, &c] (size_t records) {
+            if (records == 0) {
+                throw parquet_exception("No more records");
+            }
+            assemble_one(c);
+        });
+    }
+    template <typename Consumer>
+    seastar::future<> read_all(Consumer& c) {
+        return seastar::repeat([this, &c] {
+            return prepare_leaves(_tree->leaves).then([this, &c] (size_t records) {
+                if (records == 0) {
+                    return seastar::stop_iteration::yes;
+                }
+                for (size_t i = 0; i < records; ++i) {
+                    assemble_one(c);
+                }
+                return seastar::stop_iteration::no;
+            });
+        });
+    }
+    seastar::future<> prefetch() { return prepare_leaves(_tree->leaves).discard_result(); }
+};
+
+} // namespace parquet4seastar::record
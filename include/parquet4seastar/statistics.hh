@@ -0,0 +1,266 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/bytes.hh>
+#include <parquet4seastar/encoding.hh>
+#include <parquet4seastar/logical_type.hh>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <optional>
+
+namespace parquet4seastar {
+
+struct statistics_options {
+    // The order of min and max. Derived from the logical type of the column by file_writer.
+    // If unset, the natural order of the physical type is used.
+    std::optional<logical_type::sort_order> sort_order;
+    // Longer min and max of byte arrays are truncated to this size.
+    // The truncated max is rounded up, so it stays an upper bound.
+    size_t max_byte_array_size = 64;
+};
+
+namespace statistics_internal {
+
+template <format::Type::type ParquetType>
+constexpr logical_type::sort_order default_sort_order() {
+    if constexpr (ParquetType == format::Type::BYTE_ARRAY || ParquetType == format::Type::FIXED_LEN_BYTE_ARRAY) {
+        return logical_type::sort_order::UNSIGNED;
+    } else {
+        return logical_type::sort_order::SIGNED;
+    }
+}
+
+// Big-endian two's complement integers of any length, e.g. decimals.
+inline bool signed_bytes_less(bytes_view a, bytes_view b) {
+    bool a_negative = !a.empty() && (a[0] & 0x80);
+    bool b_negative = !b.empty() && (b[0] & 0x80);
+    if (a_negative != b_negative) {
+        return a_negative;
+    }
+    // Same sign: compare after sign-extending the shorter one.
+    size_t len = std::max(a.size(), b.size());
+    byte extension = a_negative ? 0xff : 0x00;
+    for (size_t i = 0; i < len; ++i) {
+        byte x = i < len - a.size() ? extension : a[i - (len - a.size())];
+        byte y = i < len - b.size() ? extension : b[i - (len - b.size())];
+        if (x != y) {
+            return x < y;
+        }
+    }
+    return false;
+}
+
+// a < b in the given order, which is ignored for floating point numbers.
+template <typename T>
+bool less(logical_type::sort_order order, const T& a, const T& b) {
+    using logical_type::sort_order;
+    if constexpr (std::is_same_v<T, bytes_view>) {
+        if (order == sort_order::SIGNED) {
+            return signed_bytes_less(a, b);
+        }
+        return a < b;
+    } else if constexpr (std::is_integral_v<T>) {
+        if (order == sort_order::UNSIGNED) {
+            using unsigned_type = std::make_unsigned_t<T>;
+            return static_cast<unsigned_type>(a) < static_cast<unsigned_type>(b);
+        }
+        return a < b;
+    } else {
+        return a < b;
+    }
+}
+
+} // namespace statistics_internal
+
+// Collects min, max and null_count of a page or chunk.
+template <format::Type::type ParquetType>
+class statistics_builder {
+public:
+    using input_type = typename value_decoder_traits<ParquetType>::input_type;
+private:
+    static constexpr bool is_byte_array =
+            ParquetType == format::Type::BYTE_ARRAY || ParquetType == format::Type::FIXED_LEN_BYTE_ARRAY;
+    // Byte arrays are owned by the builder.
+    using stored_type = std::conditional_t<is_byte_array, bytes, input_type>;
+    logical_type::sort_order _order;
+    size_t _max_byte_array_size;
+    std::optional<stored_type> _min;
+    std::optional<stored_type> _max;
+    int64_t _null_count = 0;
+private:
+    bool less(const input_type& a, const input_type& b) const {
+        return statistics_internal::less(_order, a, b);
+    }
+    static input_type view(const stored_type& x) {
+        if constexpr (is_byte_array) {
+            return bytes_view{x};
+        } else {
+            return x;
+        }
+    }
+    static bytes to_bytes(const stored_type& x) {
+        if constexpr (is_byte_array) {
+            return x;
+        } else {
+            // Plain encoding.
+            bytes b(sizeof(x), 0);
+            std::memcpy(b.data(), &x, sizeof(x));
+            return b;
+        }
+    }
+    void update_min(const input_type& x) {
+        if (!_min || less(x, view(*_min))) {
+            _min = stored_type(x);
+        }
+    }
+    void update_max(const input_type& x) {
+        if (!_max || less(view(*_max), x)) {
+            _max = stored_type(x);
+        }
+    }
+    bytes truncated_min() const {
+        bytes min = to_bytes(*_min);
+        if (is_byte_array && _order == logical_type::sort_order::UNSIGNED && min.size() > _max_byte_array_size) {
+            // A prefix is never greater than the string.
+            min.resize(_max_byte_array_size);
+        }
+        return min;
+    }
+    bytes truncated_max() const {
+        bytes max = to_bytes(*_max);
+        if (is_byte_array && _order == logical_type::sort_order::UNSIGNED && max.size() > _max_byte_array_size) {
+            // Increment the last byte of the prefix which can be incremented.
+            max.resize(_max_byte_array_size);
+            while (!max.empty() && max.back() == 0xff) {
+                max.pop_back();
+            }
+            if (max.empty()) {
+                // The prefix is all 0xff, so no upper bound of this size exists.
+                return to_bytes(*_max);
+            }
+            ++max.back();
+        }
+        return max;
+    }
+public:
+    explicit statistics_builder(const statistics_options& options)
+        : _order{options.sort_order.value_or(statistics_internal::default_sort_order<ParquetType>())}
+        , _max_byte_array_size{options.max_byte_array_size} {
+    }
+
+    // Compares min or max values produced by build().
+    bool less_encoded(const std::string& a, const std::string& b) const {
+        if constexpr (is_byte_array) {
+            auto view = [] (const std::string& x) {
+                return bytes_view{reinterpret_cast<const byte*>(x.data()), x.size()};
+            };
+            return less(view(a), view(b));
+        } else {
+            input_type x;
+            input_type y;
+            std::memcpy(&x, a.data(), sizeof(x));
+            std::memcpy(&y, b.data(), sizeof(y));
+            return less(x, y);
+        }
+    }
+
+    void put(const input_type& x) {
+        if (_order == logical_type::sort_order::UNDEFINED) {
+            return;
+        }
+        if constexpr (std::is_floating_point_v<input_type>) {
+            // NaN is unordered, so it can't be a part of min and max.
+            if (std::isnan(x)) {
+                return;
+            }
+        }
+        update_min(x);
+        update_max(x);
+    }
+
+    void put_batch(const input_type data[], size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            put(data[i]);
+        }
+    }
+
+    void put_null() {
+        ++_null_count;
+    }
+
+    void put_nulls(size_t n) {
+        _null_count += n;
+    }
+
+    void merge(const statistics_builder& other) {
+        if (other._min) {
+            update_min(view(*other._min));
+        }
+        if (other._max) {
+            update_max(view(*other._max));
+        }
+        _null_count += other._null_count;
+    }
+
+    void clear() {
+        _min.reset();
+        _max.reset();
+        _null_count = 0;
+    }
+
+    format::Statistics build() const {
+        format::Statistics stats;
+        stats.__set_null_count(_null_count);
+        if (!_min) {
+            return stats;
+        }
+        bytes min = truncated_min();
+        bytes max = truncated_max();
+        if constexpr (std::is_floating_point_v<input_type>) {
+            // Readers can't know the sign of a zero min or max,
+            // so the min is always written as -0.0 and the max as +0.0.
+            if (*_min == 0) {
+                input_type negative_zero = -0.0;
+                std::memcpy(min.data(), &negative_zero, sizeof(negative_zero));
+            }
+            if (*_max == 0) {
+                input_type positive_zero = +0.0;
+                std::memcpy(max.data(), &positive_zero, sizeof(positive_zero));
+            }
+        }
+        std::string min_str(reinterpret_cast<const char*>(min.data()), min.size());
+        std::string max_str(reinterpret_cast<const char*>(max.data()), max.size());
+        if (!is_byte_array && _order == logical_type::sort_order::SIGNED) {
+            // Old readers compare the deprecated fields as signed numbers, or byte by byte
+            // as signed chars, so they would be wrong for anything else.
+            stats.__set_min(min_str);
+            stats.__set_max(max_str);
+        }
+        stats.__set_min_value(std::move(min_str));
+        stats.__set_max_value(std::move(max_str));
+        return stats;
+    }
+};
+
+} // namespace parquet4seastar
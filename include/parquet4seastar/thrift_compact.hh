@@ -0,0 +1,70 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/bytes.hh>
+#include <parquet4seastar/exception.hh>
+#include <parquet4seastar/parquet_types.h>
+
+namespace parquet4seastar::thrift_compact {
+
+/* A decoder of the Thrift compact protocol for the structures read on hot paths:
+ * page headers (read for every page) and the footer. It reads straight from memory,
+ * without the transport and protocol objects and the virtual calls of the generated code.
+ * Decoding a page header allocates only for statistics longer than the small string buffer.
+ * Like the generated code, it skips unknown fields and rejects messages without required fields.
+ * The rare encryption structures are handed over to the generated code.
+ */
+
+// Thrown when the message continues past the end of the buffer.
+class truncated_message : public parquet_exception {
+public:
+    truncated_message() : parquet_exception("Unexpected end of Thrift message") {}
+};
+
+// Each function overwrites the structure and returns the number of bytes used.
+size_t decode(bytes_view serialized, format::PageHeader& out);
+size_t decode(bytes_view serialized, format::ColumnMetaData& out);
+size_t decode(bytes_view serialized, format::ColumnChunk& out);
+size_t decode(bytes_view serialized, format::FileMetaData& out);
+
+/* FileMetaData with the column chunks of its row groups left serialized.
+ * In files with thousands of columns, nearly all of the footer are column chunks,
+ * so this is much cheaper to decode than FileMetaData if only a few columns are read.
+ */
+struct lazy_file_metadata {
+    // The row groups have no columns.
+    format::FileMetaData metadata;
+    // For each row group, the positions of its column chunks in the serialized FileMetaData,
+    // followed by the end of the last one.
+    std::vector<std::vector<uint32_t>> column_chunk_offsets;
+};
+
+size_t decode(bytes_view serialized, lazy_file_metadata& out);
+
+template <typename T>
+constexpr bool has_decoder = std::is_same_v<T, format::PageHeader>
+        || std::is_same_v<T, format::ColumnMetaData>
+        || std::is_same_v<T, format::ColumnChunk>
+        || std::is_same_v<T, format::FileMetaData>;
+
+} // namespace parquet4seastar::thrift_compact
@@ -23,6 +23,7 @@
 
 #include <parquet4seastar/bytes.hh>
 #include <parquet4seastar/exception.hh>
+#include <parquet4seastar/thrift_compact.hh>
 #include <seastar/core/fstream.hh>
 #include <seastar/core/print.hh>
 
@@ -76,11 +77,15 @@ public:
 };
 
 // Deserialize a single thrift structure. Return the number of bytes used.
+// Page headers and file metadata are decoded by thrift_compact, the rest by the generated code.
 template <typename DeserializedType>
 uint32_t deserialize_thrift_msg(
         const byte serialized_msg[],
         uint32_t serialized_len,
         DeserializedType& deserialized_msg) {
+    if constexpr (thrift_compact::has_decoder<DeserializedType>) {
+        return thrift_compact::decode(bytes_view{serialized_msg, serialized_len}, deserialized_msg);
+    }
     using ThriftBuffer = apache::thrift::transport::TMemoryBuffer;
     uint8_t* casted_msg = reinterpret_cast<uint8_t*>(const_cast<byte*>(serialized_msg));
     auto tmem_transport = std::make_shared<ThriftBuffer>(casted_msg, serialized_len);
@@ -131,22 +136,27 @@ seastar::future<bool> read_thrift_from_stream(
         if (len == 0) {
             return seastar::make_ready_future<bool>(false);
         }
+        bool truncated = false;
         try {
             len = deserialize_thrift_msg(peek.data(), len, deserialized_msg);
+        } catch (const thrift_compact::truncated_message&) {
+            truncated = true;
         } catch (const apache::thrift::transport::TTransportException& e) {
-            if (e.getType() == apache::thrift::transport::TTransportException::END_OF_FILE) {
-                // The serialized structure was bigger than expected. Retry with a bigger expectation.
-                if (peek.size() < expected_size) {
-                    throw parquet_exception(seastar::format(
-                            "Could not deserialize thrift: unexpected end of stream at {}B", peek.size()));
-                }
-                return read_thrift_from_stream(stream, deserialized_msg, expected_size * 2, max_allowed_size);
-            } else {
+            if (e.getType() != apache::thrift::transport::TTransportException::END_OF_FILE) {
                 throw parquet_exception(seastar::format("Could not deserialize thrift: {}", e.what()));
             }
+            truncated = true;
         } catch (const std::exception& e) {
             throw parquet_exception(seastar::format("Could not deserialize thrift: {}", e.what()));
         }
+        if (truncated) {
+            // The serialized structure was bigger than expected. Retry with a bigger expectation.
+            if (peek.size() < expected_size) {
+                throw parquet_exception(seastar::format(
+                        "Could not deserialize thrift: unexpected end of stream at {}B", peek.size()));
+            }
+            return read_thrift_from_stream(stream, deserialized_msg, expected_size * 2, max_allowed_size);
+        }
         return stream.advance(len).then([] {
             return true;
         });
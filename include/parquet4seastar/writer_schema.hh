@@ -21,6 +21,9 @@
 
 #pragma once
 
+#include <parquet4seastar/bloom_filter.hh>
+#include <parquet4seastar/compression.hh>
+#include <parquet4seastar/encoding.hh>
 #include <parquet4seastar/logical_type.hh>
 
 namespace parquet4seastar::writer_schema {
@@ -39,6 +42,14 @@ struct primitive_node {
     std::optional<uint32_t> type_length;
     format::Encoding::type encoding;
     format::CompressionCodec::type compression;
+    // If set, compression is chosen automatically for each column chunk and the codec above
+    // is used only for chunks without data pages.
+    std::optional<codec_selection_options> auto_compression;
+    // If set, a bloom filter of the values is written for each column chunk.
+    std::optional<bloom_filter_options> bloom_filter;
+    // With RLE_DICTIONARY, the column chunk falls back to PLAIN when its dictionary page
+    // would grow beyond this size.
+    size_t max_dictionary_size = default_max_dictionary_size;
 };
 
 struct list_node {
@@ -0,0 +1,190 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include <parquet4seastar/bloom_filter.hh>
+#include <parquet4seastar/exception.hh>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace parquet4seastar {
+
+namespace {
+
+constexpr uint64_t PRIME64_1 = 11400714785074694791ULL;
+constexpr uint64_t PRIME64_2 = 14029467366897019727ULL;
+constexpr uint64_t PRIME64_3 = 1609587929392839161ULL;
+constexpr uint64_t PRIME64_4 = 9650029242287828579ULL;
+constexpr uint64_t PRIME64_5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+template <typename T>
+inline T read_le(const byte* p) {
+    T x;
+    std::memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl(acc, 31);
+    return acc * PRIME64_1;
+}
+
+inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+// The salts of the split block bloom filter, from the specification.
+constexpr uint32_t SALT[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+inline uint32_t mask_word(uint32_t key, int i) {
+    return uint32_t(1) << ((key * SALT[i]) >> 27);
+}
+
+size_t round_up_to_power_of_2(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+} // namespace
+
+uint64_t xxhash64(bytes_view data, uint64_t seed) {
+    const byte* p = data.data();
+    const byte* end = p + data.size();
+    uint64_t h;
+    if (data.size() >= 32) {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        do {
+            v1 = xxh64_round(v1, read_le<uint64_t>(p));
+            v2 = xxh64_round(v2, read_le<uint64_t>(p + 8));
+            v3 = xxh64_round(v3, read_le<uint64_t>(p + 16));
+            v4 = xxh64_round(v4, read_le<uint64_t>(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = xxh64_merge_round(h, v1);
+        h = xxh64_merge_round(h, v2);
+        h = xxh64_merge_round(h, v3);
+        h = xxh64_merge_round(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+    h += data.size();
+    for (; end - p >= 8; p += 8) {
+        h ^= xxh64_round(0, read_le<uint64_t>(p));
+        h = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (end - p >= 4) {
+        h ^= uint64_t(read_le<uint32_t>(p)) * PRIME64_1;
+        h = rotl(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= *p * PRIME64_5;
+        h = rotl(h, 11) * PRIME64_1;
+    }
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+size_t bloom_filter::optimal_num_bytes(uint64_t ndv, double fpp) {
+    // From the specification: m = -k * n / ln(1 - p^(1/k)), with k = 8 bits per insertion.
+    double bits = -8.0 * ndv / std::log(1.0 - std::pow(fpp, 1.0 / 8));
+    if (!(bits < MAX_BYTES * 8.0)) {
+        return MAX_BYTES;
+    }
+    return std::clamp(round_up_to_power_of_2(static_cast<size_t>(bits / 8)), MIN_BYTES, MAX_BYTES);
+}
+
+bloom_filter::bloom_filter(size_t num_bytes) {
+    num_bytes = std::clamp(round_up_to_power_of_2(num_bytes), MIN_BYTES, MAX_BYTES);
+    _words.resize(num_bytes / sizeof(uint32_t));
+    _num_blocks = num_bytes / BYTES_PER_BLOCK;
+}
+
+bloom_filter bloom_filter::from_bitset(bytes_view bitset) {
+    if (bitset.empty() || bitset.size() % BYTES_PER_BLOCK != 0 || bitset.size() > MAX_BYTES) {
+        throw parquet_exception::corrupted_file(seastar::format("Invalid bloom filter size: {}", bitset.size()));
+    }
+    bloom_filter filter{MIN_BYTES};
+    filter._words.resize(bitset.size() / sizeof(uint32_t));
+    std::memcpy(filter._words.data(), bitset.data(), bitset.size());
+    filter._num_blocks = bitset.size() / BYTES_PER_BLOCK;
+    return filter;
+}
+
+void bloom_filter::insert(uint64_t hash) {
+    uint32_t* b = block(hash);
+    uint32_t key = static_cast<uint32_t>(hash);
+    for (int i = 0; i < 8; ++i) {
+        b[i] |= mask_word(key, i);
+    }
+}
+
+bool bloom_filter::find(uint64_t hash) const {
+    const uint32_t* b = block(hash);
+    uint32_t key = static_cast<uint32_t>(hash);
+    for (int i = 0; i < 8; ++i) {
+        if (!(b[i] & mask_word(key, i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void bloom_filter::clear() {
+    std::fill(_words.begin(), _words.end(), 0);
+}
+
+format::BloomFilterHeader bloom_filter::header(size_t num_bytes) {
+    format::BloomFilterAlgorithm algorithm;
+    algorithm.__set_BLOCK(format::SplitBlockAlgorithm{});
+    format::BloomFilterHash hash;
+    hash.__set_XXHASH(format::XxHash{});
+    format::BloomFilterCompression compression;
+    compression.__set_UNCOMPRESSED(format::Uncompressed{});
+    format::BloomFilterHeader header;
+    header.__set_numBytes(num_bytes);
+    header.__set_algorithm(algorithm);
+    header.__set_hash(hash);
+    header.__set_compression(compression);
+    return header;
+}
+
+} // namespace parquet4seastar
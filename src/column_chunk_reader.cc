@@ -88,26 +88,38 @@ void column_chunk_reader<T>::load_data_page_v2(page p) {
         throw parquet_exception::corrupted_file(seastar::format(
                 "Negative num_values in header: {}", header));
     }
-    if (header.repetition_levels_byte_length < 0 || header.definition_levels_byte_length < 0) {
-        throw parquet_exception::corrupted_file(seastar::format(
-                "Negative levels byte length in header: {}", header));
-    }
     if (p.header->uncompressed_page_size < 0) {
         throw parquet_exception::corrupted_file(seastar::format(
                 "Negative uncompressed_page_size in header: {}", *p.header));
     }
+    // The lengths are converted to size_t below, so a negative one would wrap around.
+    if (header.repetition_levels_byte_length < 0) {
+        throw parquet_exception::corrupted_file(seastar::format(
+                "Negative repetition_levels_byte_length in header: {}", header));
+    }
+    if (header.definition_levels_byte_length < 0) {
+        throw parquet_exception::corrupted_file(seastar::format(
+                "Negative definition_levels_byte_length in header: {}", header));
+    }
+    size_t levels_size = static_cast<size_t>(header.repetition_levels_byte_length)
+            + static_cast<size_t>(header.definition_levels_byte_length);
+    if (levels_size > p.contents.size() || levels_size > static_cast<size_t>(p.header->uncompressed_page_size)) {
+        throw parquet_exception::corrupted_file(seastar::format(
+                "Levels byte length exceeds the page size in header: {}", *p.header));
+    }
     bytes_view contents = p.contents;
     _rep_decoder.reset_v2(contents.substr(0, header.repetition_levels_byte_length), header.num_values);
     contents.remove_prefix(header.repetition_levels_byte_length);
     _def_decoder.reset_v2(contents.substr(0, header.definition_levels_byte_length), header.num_values);
     contents.remove_prefix(header.definition_levels_byte_length);
-    if (header.__isset.is_compressed && header.is_compressed) {
-        size_t n_read = header.repetition_levels_byte_length + header.definition_levels_byte_length;
-        size_t uncompressed_values_size = static_cast<size_t>(p.header->uncompressed_page_size) - n_read;
+    // is_compressed defaults to true when absent.
+    if (header.is_compressed) {
+        size_t uncompressed_values_size = static_cast<size_t>(p.header->uncompressed_page_size) - levels_size;
         _decompression_buffer.resize(uncompressed_values_size);
         _decompression_buffer = _decompressor->decompress(contents, std::move(_decompression_buffer));
+        contents = _decompression_buffer;
     }
-    _val_decoder.reset(_decompression_buffer, header.encoding);
+    _val_decoder.reset(contents, header.encoding);
 }
 
 template<format::Type::type T>
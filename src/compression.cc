@@ -21,11 +21,37 @@
 
 #include <parquet4seastar/compression.hh>
 #include <parquet4seastar/exception.hh>
+#include <seastar/core/future-util.hh>
+#include <chrono>
+#include <ctime>
 #include <snappy.h>
 #include <zlib.h>
 
 namespace parquet4seastar {
 
+namespace {
+
+// The CPU time of the calling thread. Unlike the wall-clock time, it doesn't advance
+// while other threads run, e.g. when the shard shares its core.
+double thread_cpu_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+} // namespace
+
+seastar::future<bytes> compressor::compress_preemptible(bytes_view in, bytes&& out, double* cpu_seconds) const {
+    return seastar::futurize_invoke([this, in, out = std::move(out), cpu_seconds] () mutable {
+        double start = thread_cpu_seconds();
+        bytes compressed = compress(in, std::move(out));
+        if (cpu_seconds) {
+            *cpu_seconds += thread_cpu_seconds() - start;
+        }
+        return compressed;
+    });
+}
+
 class uncompressed_compressor final : public compressor {
     bytes decompress(bytes_view in, bytes&& out) const override {
         if (out.size() < in.size()) {
@@ -140,11 +166,129 @@ class gzip_compressor final : public compressor {
         }
         return std::move(out);
     }
+    seastar::future<bytes> compress_preemptible(bytes_view in, bytes&& out, double* cpu_seconds) const override {
+        // Deflate is fed with slices of this size, with a preemption check after each.
+        static constexpr size_t SLICE_SIZE = 64 * 1024;
+        // z_stream is referenced from the internal zlib state, so it must not be moved.
+        struct deflate_state {
+            z_stream zs;
+            bytes out;
+            size_t consumed = 0;
+            bool initialized = false;
+            ~deflate_state() {
+                if (initialized) {
+                    deflateEnd(&zs);
+                }
+            }
+        };
+        auto st = std::make_unique<deflate_state>();
+        st->zs.zalloc = Z_NULL;
+        st->zs.zfree = Z_NULL;
+        st->zs.opaque = Z_NULL;
+        st->zs.avail_in = 0;
+        st->zs.next_in = Z_NULL;
+
+        if (deflateInit(&st->zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            return seastar::make_exception_future<bytes>(parquet_exception("deflate compression init failure"));
+        }
+        st->initialized = true;
+
+        st->out = std::move(out);
+        st->out.resize(deflateBound(&st->zs, in.size()));
+        st->zs.next_in = reinterpret_cast<unsigned char*>(const_cast<byte*>(in.data()));
+        st->zs.next_out = reinterpret_cast<unsigned char*>(st->out.data());
+        st->zs.avail_out = st->out.size();
+
+        deflate_state* stp = st.get();
+        return seastar::repeat([stp, in, cpu_seconds] {
+            // next_in always points to the first unconsumed byte, so the next slice is contiguous with it.
+            size_t n = std::min(SLICE_SIZE, in.size() - stp->consumed);
+            stp->consumed += n;
+            stp->zs.avail_in += n;
+            bool last = stp->consumed == in.size();
+            // Only the slices are timed, not the tasks which run between them.
+            double start = thread_cpu_seconds();
+            auto res = deflate(&stp->zs, last ? Z_FINISH : Z_NO_FLUSH);
+            if (cpu_seconds) {
+                *cpu_seconds += thread_cpu_seconds() - start;
+            }
+            if (last) {
+                if (res != Z_STREAM_END) {
+                    throw parquet_exception("deflate compression failure");
+                }
+                return seastar::stop_iteration::yes;
+            }
+            if (res != Z_OK) {
+                throw parquet_exception("deflate compression failure");
+            }
+            return seastar::stop_iteration::no;
+        }).then([st = std::move(st)] {
+            st->out.resize(st->out.size() - st->zs.avail_out);
+            return std::move(st->out);
+        });
+    }
     format::CompressionCodec::type type() const override {
         return format::CompressionCodec::GZIP;
     }
 };
 
+codec_selector::codec_selector(codec_selection_options options)
+        : _options{std::move(options)} {
+    if (_options.candidates.empty()) {
+        throw parquet_exception("No candidate codecs given for automatic codec selection");
+    }
+    for (format::CompressionCodec::type codec : _options.candidates) {
+        _candidates.push_back(candidate{compressor::make(codec)});
+    }
+}
+
+void codec_selector::sample(bytes_view page) {
+    for (candidate& c : _candidates) {
+        auto start = std::chrono::steady_clock::now();
+        bytes compressed = c.codec->compress(page);
+        auto end = std::chrono::steady_clock::now();
+        c.seconds += std::chrono::duration<double>(end - start).count();
+        c.compressed_size += compressed.size();
+        c.compressed_samples.push_back(std::move(compressed));
+    }
+    ++_samples;
+}
+
+seastar::future<> codec_selector::sample_preemptible(bytes_view page) {
+    return seastar::do_for_each(_candidates, [page] (candidate& c) {
+        return c.codec->compress_preemptible(page, bytes(), &c.seconds).then([&c] (bytes compressed) {
+            c.compressed_size += compressed.size();
+            c.compressed_samples.push_back(std::move(compressed));
+        });
+    }).then([this] {
+        ++_samples;
+    });
+}
+
+codec_selector::selection codec_selector::select() {
+    selection result;
+    if (_samples > 0) {
+        auto cost = [this] (const candidate& c) {
+            return c.compressed_size + c.seconds * _options.bytes_per_cpu_second;
+        };
+        candidate* best = &_candidates[0];
+        for (candidate& c : _candidates) {
+            if (cost(c) < cost(*best)) {
+                best = &c;
+            }
+        }
+        result.codec = compressor::make(best->codec->type());
+        result.compressed_samples = std::move(best->compressed_samples);
+    }
+    for (candidate& c : _candidates) {
+        c.compressed_samples.clear();
+        c.compressed_size = 0;
+        c.seconds = 0;
+    }
+    _samples = 0;
+    return result;
+}
+
 std::unique_ptr<compressor> compressor::make(format::CompressionCodec::type compression) {
     if (compression == format::CompressionCodec::UNCOMPRESSED) {
         return std::make_unique<uncompressed_compressor>();
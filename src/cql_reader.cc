@@ -19,11 +19,10 @@
  * Copyright (C) 2020 ScyllaDB
  */
 
-#include <parquet4seastar/record_reader.hh>
+#include <parquet4seastar/multi_record_reader.hh>
 #include <parquet4seastar/cql_reader.hh>
 #include <parquet4seastar/overloaded.hh>
 #include <parquet4seastar/y_combinator.hh>
-#include <boost/iterator/counting_iterator.hpp>
 #include <boost/multiprecision/cpp_int.hpp>
 #include <iomanip>
 
@@ -407,18 +406,10 @@ seastar::future<> parquet_to_cql(file_reader& fr, const std::string& table, cons
     cql_schema schema = parquet_schema_to_cql_schema(fr.schema(), table);
     out << cql_schema_to_cql_create(schema, quoted_table, quoted_pk);
     return seastar::do_with(cql_consumer{out, cql_schema_to_cql_column_list(schema, quoted_table, quoted_pk)},
-    [&fr] (cql_consumer& consumer) {
-        return seastar::do_for_each(
-        boost::counting_iterator<int>(0),
-        boost::counting_iterator<int>(fr.metadata().row_groups.size()),
-        [&fr, &consumer] (int row_group) {
-            return record::record_reader::make(fr, row_group).then(
-            [&consumer] (record::record_reader rr) {
-                return seastar::do_with(std::move(rr),
-                [&consumer] (record::record_reader& rr) {
-                    return rr.read_all(consumer);
-                });
-            });
+    record::multi_record_reader{std::vector<file_reader*>{&fr}},
+    [] (cql_consumer& consumer, record::multi_record_reader& reader) {
+        return reader.read_all(consumer).finally([&reader] {
+            return reader.close();
         });
     });
 }
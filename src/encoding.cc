@@ -20,6 +20,8 @@
  */
 
 #include <parquet4seastar/encoding.hh>
+#include <parquet4seastar/bloom_filter.hh>
+#include <cstring>
 
 namespace parquet4seastar {
 
@@ -97,21 +99,27 @@ public:
 
 class plain_decoder_byte_array final : public decoder<format::Type::BYTE_ARRAY> {
     seastar::temporary_buffer<uint8_t> _buffer;
+    template <typename MakeValue>
+    size_t read_batch(size_t n, output_type out[], MakeValue make_value);
 public:
     using typename decoder<format::Type::BYTE_ARRAY>::output_type;
     void reset(bytes_view data) override;
     size_t read_batch(size_t n, output_type out[]) override;
+    size_t read_batch_unowned(size_t n, output_type out[], byte_arena& arena) override;
 };
 
 class plain_decoder_fixed_len_byte_array final : public decoder<format::Type::FIXED_LEN_BYTE_ARRAY> {
     size_t _fixed_len;
     seastar::temporary_buffer<uint8_t> _buffer;
+    template <typename MakeValue>
+    size_t read_batch(size_t n, output_type out[], MakeValue make_value);
 public:
     using typename decoder<format::Type::FIXED_LEN_BYTE_ARRAY>::output_type;
     explicit plain_decoder_fixed_len_byte_array(size_t fixed_len=0)
             : _fixed_len(fixed_len) {}
     void reset(bytes_view data) override;
     size_t read_batch(size_t n, output_type out[]) override;
+    size_t read_batch_unowned(size_t n, output_type out[], byte_arena& arena) override;
 };
 
 template <format::Type::type ParquetType>
@@ -122,12 +130,15 @@ private:
     output_type* _dict;
     size_t _dict_size;
     RleDecoder _rle_decoder;
+    template <typename MakeValue>
+    size_t read_batch(size_t n, output_type out[], MakeValue make_value);
 public:
     explicit dict_decoder(output_type dict[], size_t dict_size)
             : _dict(dict)
             , _dict_size(dict_size) {};
     void reset(bytes_view data) override;
     size_t read_batch(size_t n, output_type out[]) override;
+    size_t read_batch_unowned(size_t n, output_type out[], byte_arena& arena) override;
 };
 
 class rle_decoder_boolean final : public decoder<format::Type::BOOLEAN> {
@@ -270,6 +281,23 @@ public:
         }
         return n;
     }
+    size_t read_batch_unowned(size_t n, output_type out[], byte_arena& arena) override {
+        if (n > 0 && !_values.empty()) {
+            arena.keep(_values.share());
+        }
+        n = std::min(n, _lengths.size() - _current_idx);
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t len = _lengths[_current_idx];
+            if (len > _values.size()) {
+                throw parquet_exception(
+                        "Unexpected end of values in DELTA_LENGTH_BYTE_ARRAY");
+            }
+            out[i] = unowned_buffer(bytes_view{_values.get(), len});
+            _values.trim_front(len);
+            ++_current_idx;
+        }
+        return n;
+    }
     void reset(bytes_view data) override {
         delta_binary_packed_decoder<format::Type::INT32> _len_decoder;
         _len_decoder.reset(data);
@@ -427,7 +455,8 @@ size_t plain_decoder_boolean::read_batch(size_t n, uint8_t out[]) {
     return _decoder.GetBatch(1, out, n);
 }
 
-size_t plain_decoder_byte_array::read_batch(size_t n, seastar::temporary_buffer<uint8_t> out[]) {
+template <typename MakeValue>
+size_t plain_decoder_byte_array::read_batch(size_t n, seastar::temporary_buffer<uint8_t> out[], MakeValue make_value) {
     for (size_t i = 0; i < n; ++i) {
         if (_buffer.size() == 0) {
             return i;
@@ -443,13 +472,27 @@ size_t plain_decoder_byte_array::read_batch(size_t n, seastar::temporary_buffer<
             throw parquet_exception::corrupted_file(seastar::format(
                     "End of page while reading BYTE_ARRAY (needed {}B, got {}B)", len, _buffer.size()));
         }
-        out[i] = _buffer.share(0, len);
+        out[i] = make_value(len);
         _buffer.trim_front(len);
     }
     return n;
 }
 
-size_t plain_decoder_fixed_len_byte_array::read_batch(size_t n, seastar::temporary_buffer<uint8_t> out[]) {
+size_t plain_decoder_byte_array::read_batch(size_t n, seastar::temporary_buffer<uint8_t> out[]) {
+    return read_batch(n, out, [this] (size_t len) { return _buffer.share(0, len); });
+}
+
+size_t plain_decoder_byte_array::read_batch_unowned(
+        size_t n, seastar::temporary_buffer<uint8_t> out[], byte_arena& arena) {
+    if (n > 0 && !_buffer.empty()) {
+        arena.keep(_buffer.share());
+    }
+    return read_batch(n, out, [this] (size_t len) { return unowned_buffer(bytes_view{_buffer.get(), len}); });
+}
+
+template <typename MakeValue>
+size_t plain_decoder_fixed_len_byte_array::read_batch(
+        size_t n, seastar::temporary_buffer<uint8_t> out[], MakeValue make_value) {
     for (size_t i = 0; i < n; ++i) {
         if (_buffer.size() == 0) {
             return i;
@@ -459,12 +502,24 @@ size_t plain_decoder_fixed_len_byte_array::read_batch(size_t n, seastar::tempora
                     "End of page while reading FIXED_LEN_BYTE_ARRAY (needed {}B, got {}B)",
                     _fixed_len, _buffer.size()));
         }
-        out[i] = _buffer.share(0, _fixed_len);
+        out[i] = make_value();
         _buffer.trim_front(_fixed_len);
     }
     return n;
 }
 
+size_t plain_decoder_fixed_len_byte_array::read_batch(size_t n, seastar::temporary_buffer<uint8_t> out[]) {
+    return read_batch(n, out, [this] { return _buffer.share(0, _fixed_len); });
+}
+
+size_t plain_decoder_fixed_len_byte_array::read_batch_unowned(
+        size_t n, seastar::temporary_buffer<uint8_t> out[], byte_arena& arena) {
+    if (n > 0 && !_buffer.empty()) {
+        arena.keep(_buffer.share());
+    }
+    return read_batch(n, out, [this] { return unowned_buffer(bytes_view{_buffer.get(), _fixed_len}); });
+}
+
 template <format::Type::type ParquetType>
 void dict_decoder<ParquetType>::reset(bytes_view data) {
     if (data.size() == 0) {
@@ -479,7 +534,8 @@ void dict_decoder<ParquetType>::reset(bytes_view data) {
 }
 
 template <format::Type::type ParquetType>
-size_t dict_decoder<ParquetType>::read_batch(size_t n, output_type out[]) {
+template <typename MakeValue>
+size_t dict_decoder<ParquetType>::read_batch(size_t n, output_type out[], MakeValue make_value) {
     std::array<uint32_t, 1000> buf;
     size_t completed = 0;
     while (completed < n) {
@@ -492,12 +548,7 @@ size_t dict_decoder<ParquetType>::read_batch(size_t n, output_type out[]) {
             }
         }
         for (size_t i = 0; i < n_read; ++i) {
-            if constexpr (std::is_trivially_copyable_v<output_type>) {
-                out[completed + i] = _dict[buf[i]];
-            } else {
-                // Why isn't seastar::temporary_buffer copyable though?
-                out[completed + i] = _dict[buf[i]].share();
-            }
+            out[completed + i] = make_value(_dict[buf[i]]);
         }
         completed += n_read;
         if (n_read < n_to_read) {
@@ -507,6 +558,29 @@ size_t dict_decoder<ParquetType>::read_batch(size_t n, output_type out[]) {
     return n;
 }
 
+template <format::Type::type ParquetType>
+size_t dict_decoder<ParquetType>::read_batch(size_t n, output_type out[]) {
+    return read_batch(n, out, [] (output_type& value) {
+        if constexpr (std::is_trivially_copyable_v<output_type>) {
+            return value;
+        } else {
+            // Why isn't seastar::temporary_buffer copyable though?
+            return value.share();
+        }
+    });
+}
+
+template <format::Type::type ParquetType>
+size_t dict_decoder<ParquetType>::read_batch_unowned(size_t n, output_type out[], byte_arena&) {
+    return read_batch(n, out, [] (output_type& value) {
+        if constexpr (std::is_trivially_copyable_v<output_type>) {
+            return value;
+        } else {
+            return unowned_buffer(bytes_view{value.get(), value.size()});
+        }
+    });
+}
+
 void rle_decoder_boolean::reset(bytes_view data) {
     _rle_decoder.Reset(data.data(), data.size(), 1);
 }
@@ -590,6 +664,11 @@ size_t value_decoder<ParquetType>::read_batch(size_t n, output_type out[]) {
     return _decoder->read_batch(n, out);
 };
 
+template<format::Type::type ParquetType>
+size_t value_decoder<ParquetType>::read_batch_unowned(size_t n, output_type out[], byte_arena& arena) {
+    return _decoder->read_batch_unowned(n, out, arena);
+};
+
 /*
  * Explicit instantiation of value_decoder shouldn't be needed,
  * because column_chunk_reader<T> has a value_decoder<T> member.
@@ -707,57 +786,141 @@ public:
     uint64_t cardinality() override { return 0; }
 };
 
+/* Maps values to their indices in the dictionary.
+ * It's an open-addressing hash table with linear probing, but the keys are not stored
+ * in the table. They are appended to the dictionary page (plain-encoded) as they arrive,
+ * and the table only holds their indices and hashes. This way a probe touches only
+ * 8 bytes (and the key, on a hash match), and no key is stored twice.
+ * Keys are compared bitwise, so e.g. NaNs are deduplicated, but -0.0 and +0.0 are not.
+ */
 template <format::Type::type ParquetType>
 class dict_builder {
 public:
     using input_type = typename value_decoder_traits<ParquetType>::input_type;
 private:
-    std::unordered_map<input_type, uint32_t> _accumulator;
-    plain_encoder<ParquetType> _dict;
-public:
-    uint32_t put(input_type key) {
-        auto [iter, was_new_key] = _accumulator.try_emplace(key, _accumulator.size());
-        if (was_new_key) {
-            _dict.put_batch(&key, 1);
+    static constexpr bool is_byte_array =
+            ParquetType == format::Type::BYTE_ARRAY || ParquetType == format::Type::FIXED_LEN_BYTE_ARRAY;
+    static constexpr size_t INITIAL_CAPACITY = 256;
+    struct slot {
+        uint32_t hash;
+        // Index of the key + 1. 0 marks an empty slot.
+        uint32_t index;
+    };
+    std::vector<slot> _table = std::vector<slot>(INITIAL_CAPACITY);
+    size_t _cardinality = 0;
+    // The dictionary page.
+    bytes _dict;
+    // For byte arrays: the offset of each entry in _dict, and a sentinel at the end.
+    std::vector<uint32_t> _offsets = {0};
+private:
+    static uint32_t hash(const input_type& key) {
+        uint64_t h;
+        if constexpr (is_byte_array) {
+            h = xxhash64(key);
+        } else {
+            // The finalizer of splitmix64. Good enough for fixed-size values, and much cheaper.
+            h = 0;
+            std::memcpy(&h, &key, sizeof(key));
+            h ^= h >> 30;
+            h *= 0xbf58476d1ce4e5b9ULL;
+            h ^= h >> 27;
+            h *= 0x94d049bb133111ebULL;
+            h ^= h >> 31;
         }
-        return iter->second;
+        return static_cast<uint32_t>(h ^ (h >> 32));
     }
-    size_t cardinality() const { return _accumulator.size(); }
-    bytes_view view() const { return _dict.view(); }
-};
-
-template <>
-class dict_builder<format::Type::BYTE_ARRAY> {
-private:
-    std::unordered_map<bytes, uint32_t, bytes_hasher> _accumulator;
-    plain_encoder<format::Type::BYTE_ARRAY> _dict;
-public:
-    uint32_t put(bytes_view key) {
-        auto [it, was_new_key] = _accumulator.try_emplace(bytes{key}, _accumulator.size());
-        if (was_new_key) {
-            _dict.put_batch(&key, 1);
+    bool key_equals(uint32_t index, const input_type& key) const {
+        if constexpr (is_byte_array) {
+            size_t prefix = ParquetType == format::Type::BYTE_ARRAY ? sizeof(uint32_t) : 0;
+            bytes_view entry{_dict.data() + _offsets[index] + prefix, _offsets[index + 1] - _offsets[index] - prefix};
+            return entry == key;
+        } else {
+            return std::memcmp(_dict.data() + index * sizeof(key), &key, sizeof(key)) == 0;
         }
-        return it->second;
     }
-    size_t cardinality() const { return _accumulator.size(); }
-    bytes_view view() const { return _dict.view(); }
-};
-
-template <>
-class dict_builder<format::Type::FIXED_LEN_BYTE_ARRAY> {
-private:
-    std::unordered_map<bytes, uint32_t, bytes_hasher> _accumulator;
-    plain_encoder<format::Type::FIXED_LEN_BYTE_ARRAY> _dict;
+    void append(const input_type& key) {
+        if constexpr (is_byte_array) {
+            if constexpr (ParquetType == format::Type::BYTE_ARRAY) {
+                append_raw_bytes<uint32_t>(_dict, key.size());
+            }
+            _dict.insert(_dict.end(), key.begin(), key.end());
+            _offsets.push_back(_dict.size());
+        } else {
+            append_raw_bytes<input_type>(_dict, key);
+        }
+    }
+    void insert_slot(std::vector<slot>& table, slot s) {
+        size_t mask = table.size() - 1;
+        size_t pos = s.hash & mask;
+        while (table[pos].index != 0) {
+            pos = (pos + 1) & mask;
+        }
+        table[pos] = s;
+    }
+    // Rebuilds the table with the given capacity, keeping only the first n keys.
+    void rehash(size_t capacity, size_t n) {
+        std::vector<slot> table(capacity);
+        for (const slot& s : _table) {
+            if (s.index != 0 && s.index <= n) {
+                insert_slot(table, s);
+            }
+        }
+        _table = std::move(table);
+    }
 public:
-    uint32_t put(bytes_view key) {
-        auto [it, was_new_key] = _accumulator.try_emplace(bytes{key}, _accumulator.size());
-        if (was_new_key) {
-            _dict.put_batch(&key, 1);
+    uint32_t put(const input_type& key) {
+        uint32_t h = hash(key);
+        size_t mask = _table.size() - 1;
+        size_t pos = h & mask;
+        while (_table[pos].index != 0) {
+            const slot& s = _table[pos];
+            if (s.hash == h && key_equals(s.index - 1, key)) {
+                return s.index - 1;
+            }
+            pos = (pos + 1) & mask;
+        }
+        uint32_t index = _cardinality++;
+        _table[pos] = slot{h, index + 1};
+        append(key);
+        // Keep the load factor at most 1/2.
+        if (_cardinality * 2 > _table.size()) {
+            rehash(_table.size() * 2, _cardinality);
+        }
+        return index;
+    }
+    size_t cardinality() const { return _cardinality; }
+    bytes_view view() const { return _dict; }
+    // The key with the given index. Byte arrays are valid until the next put() or truncate().
+    input_type at(uint32_t index) const {
+        if constexpr (is_byte_array) {
+            size_t prefix = ParquetType == format::Type::BYTE_ARRAY ? sizeof(uint32_t) : 0;
+            return bytes_view{_dict.data() + _offsets[index] + prefix, _offsets[index + 1] - _offsets[index] - prefix};
+        } else {
+            input_type key;
+            std::memcpy(&key, _dict.data() + index * sizeof(key), sizeof(key));
+            return key;
+        }
+    }
+    // Forget all keys except the first n.
+    void truncate(size_t n) {
+        if (n >= _cardinality) {
+            return;
+        }
+        if constexpr (is_byte_array) {
+            _dict.resize(_offsets[n]);
+            _offsets.resize(n + 1);
+        } else {
+            _dict.resize(n * sizeof(input_type));
         }
-        return it->second;
+        _cardinality = n;
+        rehash(_table.size(), n);
+    }
+    void clear() {
+        _table.assign(INITIAL_CAPACITY, slot{});
+        _cardinality = 0;
+        _dict.clear();
+        _offsets.assign(1, 0);
     }
-    size_t cardinality() const { return _accumulator.size(); }
-    bytes_view view() const { return _dict.view(); }
 };
 
 template <format::Type::type ParquetType>
@@ -765,6 +928,10 @@ class dict_encoder : public value_encoder<ParquetType> {
 private:
     std::vector<uint32_t> _indices;
     dict_builder<ParquetType> _values;
+    // The cardinality at the last flush. Flushed pages only use these entries.
+    size_t _flushed_cardinality = 0;
+    // The size of the unflushed values, if they were plain-encoded.
+    size_t _unflushed_plain_size = 0;
 private:
     int index_bit_width() const {
         return bit_width(_values.cardinality());
@@ -777,6 +944,17 @@ public:
         for (size_t i = 0; i < size; ++i) {
             _indices.push_back(_values.put(data[i]));
         }
+        if constexpr (ParquetType == format::Type::BYTE_ARRAY) {
+            for (size_t i = 0; i < size; ++i) {
+                _unflushed_plain_size += sizeof(uint32_t) + data[i].size();
+            }
+        } else if constexpr (ParquetType == format::Type::FIXED_LEN_BYTE_ARRAY) {
+            for (size_t i = 0; i < size; ++i) {
+                _unflushed_plain_size += data[i].size();
+            }
+        } else {
+            _unflushed_plain_size += size * sizeof(input_type);
+        }
     }
     size_t max_encoded_size() const override {
         return 1
@@ -791,50 +969,88 @@ public:
         }
         encoder.Flush();
         _indices.clear();
+        _flushed_cardinality = _values.cardinality();
+        _unflushed_plain_size = 0;
         size_t size = 1 + encoder.len();
         return {size, format::Encoding::RLE_DICTIONARY};
     }
     std::optional<bytes_view> view_dict() override { return _values.view(); }
     uint64_t cardinality() override { return _values.cardinality(); }
+    void reset_dict() override {
+        _indices.clear();
+        _values.clear();
+        _flushed_cardinality = 0;
+        _unflushed_plain_size = 0;
+    }
+    size_t unflushed_plain_size() const { return _unflushed_plain_size; }
+    size_t dict_size() const { return _values.view().size(); }
+    // Moves the unflushed values to the plain encoder and drops the dictionary entries
+    // added since the last flush. The flushed pages don't use them, so they stay valid.
+    void move_unflushed_to(plain_encoder<ParquetType>& plain) {
+        for (uint32_t index : _indices) {
+            input_type value = _values.at(index);
+            plain.put_batch(&value, 1);
+        }
+        _indices.clear();
+        _unflushed_plain_size = 0;
+        _values.truncate(_flushed_cardinality);
+    }
 };
 
-// Dict encoder, but it falls back to plain encoding
-// when the dict page grows too big.
+// Dict encoder, but it falls back to plain encoding for the rest of the column chunk
+// when the dictionary grows too big, or when it doesn't make the pages smaller.
 template <format::Type::type ParquetType>
 class dict_or_plain_encoder : public value_encoder<ParquetType> {
 private:
     dict_encoder<ParquetType> _dict_encoder;
     plain_encoder<ParquetType> _plain_encoder;
-    bool fallen_back = false; // Have we fallen back to plain yet?
+    size_t _max_dictionary_size;
+    bool _fallen_back = false; // Have we fallen back to plain in this chunk yet?
+    // The size of the dictionary-encoded pages of this chunk,
+    // and the size they would have if they were plain-encoded.
+    size_t _dict_encoded_size = 0;
+    size_t _plain_size = 0;
 public:
     using typename value_encoder<ParquetType>::input_type;
     using typename value_encoder<ParquetType>::flush_result;
-    // Will fall back to plain encoding when dict page grows
-    // beyond this threshold.
-    static constexpr size_t fallback_threshold = 16 * 1024;
+    explicit dict_or_plain_encoder(size_t max_dictionary_size)
+        : _max_dictionary_size{max_dictionary_size} {
+    }
     void put_batch(const input_type data[], size_t size) override {
-        if (fallen_back) {
+        if (_fallen_back) {
             _plain_encoder.put_batch(data, size);
         } else {
             _dict_encoder.put_batch(data, size);
+            if (_dict_encoder.dict_size() > _max_dictionary_size) {
+                // The current page is written plain, so the dictionary
+                // is cut back to the entries used by the flushed pages.
+                _dict_encoder.move_unflushed_to(_plain_encoder);
+                _fallen_back = true;
+            }
         }
     }
     size_t max_encoded_size() const override {
-        if (fallen_back) {
+        if (_fallen_back) {
             return _plain_encoder.max_encoded_size();
         } else {
             return _dict_encoder.max_encoded_size();
         }
     }
     flush_result flush(byte sink[]) override {
-        if (fallen_back) {
+        if (_fallen_back) {
             return _plain_encoder.flush(sink);
-        } else {
-            if (_dict_encoder.view_dict()->size() > fallback_threshold) {
-                fallen_back = true;
+        }
+        size_t plain_size = _dict_encoder.unflushed_plain_size();
+        flush_result result = _dict_encoder.flush(sink);
+        if (plain_size > 0) {
+            _plain_size += plain_size;
+            _dict_encoded_size += result.size;
+            if (_dict_encoded_size + _dict_encoder.dict_size() > _plain_size) {
+                // The dictionary doesn't pay for itself. It is still written, for the flushed pages.
+                _fallen_back = true;
             }
-            return _dict_encoder.flush(sink);
         }
+        return result;
     }
     std::optional<bytes_view> view_dict() override {
         return _dict_encoder.view_dict();
@@ -842,6 +1058,12 @@ public:
     uint64_t cardinality() override {
         return _dict_encoder.cardinality();
     }
+    void reset_dict() override {
+        _dict_encoder.reset_dict();
+        _fallen_back = false;
+        _dict_encoded_size = 0;
+        _plain_size = 0;
+    }
 };
 
 template <format::Type::type ParquetType>
@@ -997,7 +1219,7 @@ public:
 
 template <format::Type::type ParquetType>
 std::unique_ptr<value_encoder<ParquetType>>
-make_value_encoder(format::Encoding::type encoding) {
+make_value_encoder(format::Encoding::type encoding, size_t max_dictionary_size) {
     if constexpr (ParquetType == format::Type::INT96) {
         throw parquet_exception(
                 "INT96 is deprecated and writes of this type are unsupported");
@@ -1040,7 +1262,7 @@ make_value_encoder(format::Encoding::type encoding) {
         }
         throw invalid();
     } else if (encoding == format::Encoding::RLE_DICTIONARY) {
-        return std::make_unique<dict_or_plain_encoder<ParquetType>>();
+        return std::make_unique<dict_or_plain_encoder<ParquetType>>(max_dictionary_size);
     } else if (encoding == format::Encoding::BYTE_STREAM_SPLIT) {
         throw not_implemented();
     }
@@ -1048,18 +1270,18 @@ make_value_encoder(format::Encoding::type encoding) {
 }
 
 template std::unique_ptr<value_encoder<format::Type::INT32>>
-make_value_encoder<format::Type::INT32>(format::Encoding::type);
+make_value_encoder<format::Type::INT32>(format::Encoding::type, size_t);
 template std::unique_ptr<value_encoder<format::Type::INT64>>
-make_value_encoder<format::Type::INT64>(format::Encoding::type);
+make_value_encoder<format::Type::INT64>(format::Encoding::type, size_t);
 template std::unique_ptr<value_encoder<format::Type::FLOAT>>
-make_value_encoder<format::Type::FLOAT>(format::Encoding::type);
+make_value_encoder<format::Type::FLOAT>(format::Encoding::type, size_t);
 template std::unique_ptr<value_encoder<format::Type::DOUBLE>>
-make_value_encoder<format::Type::DOUBLE>(format::Encoding::type);
+make_value_encoder<format::Type::DOUBLE>(format::Encoding::type, size_t);
 template std::unique_ptr<value_encoder<format::Type::BOOLEAN>>
-make_value_encoder<format::Type::BOOLEAN>(format::Encoding::type);
+make_value_encoder<format::Type::BOOLEAN>(format::Encoding::type, size_t);
 template std::unique_ptr<value_encoder<format::Type::BYTE_ARRAY>>
-make_value_encoder<format::Type::BYTE_ARRAY>(format::Encoding::type);
+make_value_encoder<format::Type::BYTE_ARRAY>(format::Encoding::type, size_t);
 template std::unique_ptr<value_encoder<format::Type::FIXED_LEN_BYTE_ARRAY>>
-make_value_encoder<format::Type::FIXED_LEN_BYTE_ARRAY>(format::Encoding::type);
+make_value_encoder<format::Type::FIXED_LEN_BYTE_ARRAY>(format::Encoding::type, size_t);
 
 } // namespace parquet4seastar
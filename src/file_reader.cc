@@ -22,11 +22,13 @@
 #include <parquet4seastar/file_reader.hh>
 #include <parquet4seastar/exception.hh>
 #include <seastar/core/seastar.hh>
+#include <algorithm>
 
 namespace parquet4seastar {
 
-seastar::future<std::unique_ptr<format::FileMetaData>> file_reader::read_file_metadata(seastar::file file) {
-    return file.size().then([file] (uint64_t size) mutable {
+seastar::future<seastar::temporary_buffer<uint8_t>>
+file_reader::read_serialized_metadata(seastar::shared_ptr<random_access_source> source) {
+    return source->size().then([source] (uint64_t size) {
         if (size < 8) {
             throw parquet_exception::corrupted_file(seastar::format(
                     "File too small ({}B) to be a parquet file", size));
@@ -38,8 +40,8 @@ seastar::future<std::unique_ptr<format::FileMetaData>> file_reader::read_file_me
         // 4-byte length in bytes of file metadata (little endian)
         // 4-byte magic number "PAR1"
         // EOF
-        return file.dma_read_exactly<uint8_t>(size - 8, 8).then(
-        [file, size] (seastar::temporary_buffer<uint8_t> footer) mutable {
+        return source->read(size - 8, 8).then(
+        [source, size] (seastar::temporary_buffer<uint8_t> footer) {
             if (std::memcmp(footer.get() + 4, "PARE", 4) == 0) {
                 throw parquet_exception("Parquet encryption is currently unsupported");
             } else if (std::memcmp(footer.get() + 4, "PAR1", 4) != 0) {
@@ -54,24 +56,63 @@ seastar::future<std::unique_ptr<format::FileMetaData>> file_reader::read_file_me
                         metadata_len + 8, size));
             }
 
-            return file.dma_read_exactly<uint8_t>(size - 8 - metadata_len, metadata_len);
-        }).then([file] (seastar::temporary_buffer<uint8_t> serialized_metadata) {
-            auto deserialized_metadata = std::make_unique<format::FileMetaData>();
-            deserialize_thrift_msg(serialized_metadata.get(), serialized_metadata.size(), *deserialized_metadata);
-            return deserialized_metadata;
+            return source->read(size - 8 - metadata_len, metadata_len);
         });
     });
 }
 
+void file_reader::set_serialized_metadata(seastar::temporary_buffer<uint8_t> serialized) {
+    auto lazy_metadata = std::make_unique<thrift_compact::lazy_file_metadata>();
+    thrift_compact::decode(bytes_view{serialized.get(), serialized.size()}, *lazy_metadata);
+    _serialized_metadata = std::move(serialized);
+    _lazy_metadata = std::move(lazy_metadata);
+}
+
+const format::FileMetaData& file_reader::metadata() {
+    if (!_metadata) {
+        auto metadata = std::make_unique<format::FileMetaData>();
+        thrift_compact::decode(bytes_view{_serialized_metadata.get(), _serialized_metadata.size()}, *metadata);
+        _metadata = std::move(metadata);
+    }
+    return *_metadata;
+}
+
+uint32_t file_reader::column_chunk_count(uint32_t row_group) const {
+    const auto& offsets = _lazy_metadata->column_chunk_offsets;
+    if (row_group >= offsets.size() || offsets[row_group].empty()) {
+        return 0;
+    }
+    return offsets[row_group].size() - 1;
+}
+
+const format::ColumnChunk& file_reader::column_chunk(uint32_t row_group, uint32_t column) {
+    if (column >= column_chunk_count(row_group)) {
+        throw parquet_exception::corrupted_file(seastar::format(
+                "Column chunk {} of row group {} is missing from the metadata", column, row_group));
+    }
+    std::unique_ptr<format::ColumnChunk>& chunk = _column_chunks[(uint64_t(row_group) << 32) | column];
+    if (!chunk) {
+        const std::vector<uint32_t>& offsets = _lazy_metadata->column_chunk_offsets[row_group];
+        auto decoded = std::make_unique<format::ColumnChunk>();
+        thrift_compact::decode(bytes_view{
+                _serialized_metadata.get() + offsets[column],
+                offsets[column + 1] - offsets[column]}, *decoded);
+        chunk = std::move(decoded);
+    }
+    return *chunk;
+}
+
 seastar::future<file_reader> file_reader::open(std::string path) {
     return seastar::open_file_dma(path, seastar::open_flags::ro).then(
     [path] (seastar::file file) {
-        return read_file_metadata(file).then(
-        [path = std::move(path), file] (std::unique_ptr<format::FileMetaData> metadata) {
+        seastar::shared_ptr<random_access_source> source = make_file_source(file);
+        return read_serialized_metadata(source).then(
+        [path = std::move(path), file, source] (seastar::temporary_buffer<uint8_t> metadata) {
             file_reader fr;
             fr._path = std::move(path);
             fr._file = std::move(file);
-            fr._metadata = std::move(metadata);
+            fr._source = std::move(source);
+            fr.set_serialized_metadata(std::move(metadata));
             return fr;
         });
     }).handle_exception([path = std::move(path)] (std::exception_ptr eptr) {
@@ -84,6 +125,22 @@ seastar::future<file_reader> file_reader::open(std::string path) {
     });
 }
 
+seastar::future<file_reader> file_reader::open(seastar::shared_ptr<random_access_source> source) {
+    return read_serialized_metadata(source).then([source] (seastar::temporary_buffer<uint8_t> metadata) {
+        file_reader fr;
+        fr._source = std::move(source);
+        fr.set_serialized_metadata(std::move(metadata));
+        return fr;
+    }).handle_exception([] (std::exception_ptr eptr) {
+        try {
+            std::rethrow_exception(eptr);
+        } catch (const std::exception& e) {
+            return seastar::make_exception_future<file_reader>(parquet_exception(seastar::format(
+                    "Could not open parquet source for reading: {}", e.what())));
+        }
+    });
+}
+
 namespace {
 
 seastar::future<std::unique_ptr<format::ColumnMetaData>> read_chunk_metadata(seastar::input_stream<char> &&s) {
@@ -101,6 +158,29 @@ seastar::future<std::unique_ptr<format::ColumnMetaData>> read_chunk_metadata(sea
     });
 }
 
+// The offset index of the chunk, if it has one and it's needed to find the row.
+seastar::future<std::optional<format::OffsetIndex>>
+read_offset_index(random_access_source& source, const format::ColumnChunk& column_chunk, uint64_t row) {
+    if (row == 0 || !column_chunk.__isset.offset_index_offset || !column_chunk.__isset.offset_index_length) {
+        return seastar::make_ready_future<std::optional<format::OffsetIndex>>();
+    }
+    if (column_chunk.offset_index_offset < 0 || column_chunk.offset_index_length <= 0) {
+        return seastar::make_exception_future<std::optional<format::OffsetIndex>>(
+                parquet_exception::corrupted_file(seastar::format(
+                        "Invalid offset index location: {}, {}B",
+                        column_chunk.offset_index_offset, column_chunk.offset_index_length)));
+    }
+    return source.read(column_chunk.offset_index_offset, column_chunk.offset_index_length).then(
+    [] (seastar::temporary_buffer<uint8_t> buf) {
+        format::OffsetIndex index;
+        deserialize_thrift_msg(buf.get(), buf.size(), index);
+        if (index.page_locations.empty()) {
+            return std::optional<format::OffsetIndex>{};
+        }
+        return std::optional<format::OffsetIndex>{std::move(index)};
+    });
+}
+
 } // namespace
 
 /* ColumnMetaData is a structure that has to be read in order to find the beginning of a column chunk.
@@ -112,43 +192,89 @@ seastar::future<std::unique_ptr<format::ColumnMetaData>> read_chunk_metadata(sea
  * different than ColumnMetaData), so I'm not sure whether this entire function is needed.
  */
 template <format::Type::type T>
-seastar::future<column_chunk_reader<T>>
-file_reader::open_column_chunk_reader_internal(uint32_t row_group, uint32_t column) {
+seastar::future<std::pair<column_chunk_reader<T>, uint64_t>>
+file_reader::open_column_chunk_reader_internal(uint32_t row_group, uint32_t column, uint64_t row) {
     assert(column < raw_schema().leaves.size());
-    assert(row_group < metadata().row_groups.size());
-    if (column >= metadata().row_groups[row_group].columns.size()) {
-        return seastar::make_exception_future<column_chunk_reader<T>>(
-                parquet_exception::corrupted_file(seastar::format(
-                        "Selected column metadata is missing from row group metadata: {}",
-                        metadata().row_groups[row_group])));
+    assert(row_group < shallow_metadata().row_groups.size());
+    const format::ColumnChunk* chunk;
+    try {
+        chunk = &this->column_chunk(row_group, column);
+    } catch (...) {
+        return seastar::make_exception_future<std::pair<column_chunk_reader<T>, uint64_t>>(std::current_exception());
     }
-    const format::ColumnChunk& column_chunk = metadata().row_groups[row_group].columns[column];
+    const format::ColumnChunk& column_chunk = *chunk;
     const reader_schema::raw_node& leaf = *raw_schema().leaves[column];
     return [this, &column_chunk] {
         if (!column_chunk.__isset.file_path) {
-            return seastar::make_ready_future<seastar::file>(file());
+            return seastar::make_ready_future<seastar::shared_ptr<random_access_source>>(_source);
+        } else if (path().empty()) {
+            return seastar::make_exception_future<seastar::shared_ptr<random_access_source>>(
+                    parquet_exception(seastar::format(
+                            "Column chunk is in another file ({}), but the reader has no path", column_chunk.file_path)));
         } else {
-            return seastar::open_file_dma(path() + column_chunk.file_path, seastar::open_flags::ro);
+            return seastar::open_file_dma(path() + column_chunk.file_path, seastar::open_flags::ro).then(
+            [] (seastar::file f) {
+                return make_file_source(std::move(f));
+            });
         }
-    }().then([&column_chunk, &leaf] (seastar::file f) {
-        return [&column_chunk, f] {
+    }().then([&column_chunk, &leaf, row] (seastar::shared_ptr<random_access_source> source) {
+        return [&column_chunk, source] {
             if (column_chunk.__isset.meta_data) {
                 return seastar::make_ready_future<std::unique_ptr<format::ColumnMetaData>>(
                         std::make_unique<format::ColumnMetaData>(column_chunk.meta_data));
             } else {
-                return read_chunk_metadata(seastar::make_file_input_stream(f, column_chunk.file_offset, {8192, 16}));
+                return source->size().then([&column_chunk, source] (uint64_t size) {
+                    uint64_t offset = column_chunk.file_offset;
+                    if (offset > size) {
+                        throw parquet_exception::corrupted_file(seastar::format(
+                                "ColumnChunk.file_offset ({}) beyond the end of the file ({}B)", offset, size));
+                    }
+                    return read_chunk_metadata(source->make_stream(offset, size - offset));
+                });
             }
-        }().then([f, &leaf] (std::unique_ptr<format::ColumnMetaData> column_metadata) {
-            size_t file_offset = column_metadata->__isset.dictionary_page_offset
-                                 ? column_metadata->dictionary_page_offset
-                                 : column_metadata->data_page_offset;
-
-            return column_chunk_reader<T>{
-                    page_reader{seastar::make_file_input_stream(f, file_offset, column_metadata->total_compressed_size, {8192, 16})},
-                    column_metadata->codec,
-                    leaf.def_level,
-                    leaf.rep_level,
-                    (leaf.info.__isset.type_length ? std::optional<uint32_t>(leaf.info.type_length) : std::optional<uint32_t>{})};
+        }().then([source, &column_chunk, &leaf, row] (std::unique_ptr<format::ColumnMetaData> column_metadata) {
+            return read_offset_index(*source, column_chunk, row).then(
+            [source, &leaf, column_metadata = std::move(column_metadata), row] (std::optional<format::OffsetIndex> index) {
+                uint64_t chunk_start = column_metadata->__isset.dictionary_page_offset
+                                       ? column_metadata->dictionary_page_offset
+                                       : column_metadata->data_page_offset;
+                uint64_t chunk_end = chunk_start + column_metadata->total_compressed_size;
+                seastar::input_stream<char> stream;
+                uint64_t rows_before = 0;
+                // The last page which starts at or before the row.
+                auto page = index ? std::upper_bound(
+                        index->page_locations.begin(), index->page_locations.end(), row,
+                        [] (uint64_t row, const format::PageLocation& location) {
+                            return row < static_cast<uint64_t>(location.first_row_index);
+                        }) : std::vector<format::PageLocation>::iterator{};
+                if (!index || page - index->page_locations.begin() <= 1) {
+                    stream = source->make_stream(chunk_start, chunk_end - chunk_start);
+                } else {
+                    --page;
+                    uint64_t first_data_page = index->page_locations[0].offset;
+                    uint64_t offset = page->offset;
+                    if (first_data_page < chunk_start || offset < first_data_page || offset > chunk_end) {
+                        throw parquet_exception::corrupted_file(seastar::format(
+                                "Page location {} outside of the column chunk [{}, {})", offset, chunk_start, chunk_end));
+                    }
+                    std::vector<seastar::input_stream<char>> streams;
+                    if (first_data_page > chunk_start) {
+                        // The dictionary page.
+                        streams.push_back(source->make_stream(chunk_start, first_data_page - chunk_start));
+                    }
+                    streams.push_back(source->make_stream(offset, chunk_end - offset));
+                    stream = make_concatenated_stream(std::move(streams));
+                    rows_before = page->first_row_index;
+                }
+                return std::pair{
+                        column_chunk_reader<T>{
+                                page_reader{std::move(stream)},
+                                column_metadata->codec,
+                                leaf.def_level,
+                                leaf.rep_level,
+                                (leaf.info.__isset.type_length ? std::optional<uint32_t>(leaf.info.type_length) : std::optional<uint32_t>{})},
+                        rows_before};
+            });
         });
     });
 }
@@ -156,12 +282,21 @@ file_reader::open_column_chunk_reader_internal(uint32_t row_group, uint32_t colu
 template <format::Type::type T>
 seastar::future<column_chunk_reader<T>>
 file_reader::open_column_chunk_reader(uint32_t row_group, uint32_t column) {
-    return open_column_chunk_reader_internal<T>(row_group, column).handle_exception(
+    return open_column_chunk_reader_at<T>(row_group, column, 0).then(
+    [] (std::pair<column_chunk_reader<T>, uint64_t> result) {
+        return std::move(result.first);
+    });
+}
+
+template <format::Type::type T>
+seastar::future<std::pair<column_chunk_reader<T>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row) {
+    return open_column_chunk_reader_internal<T>(row_group, column, row).handle_exception(
     [column, row_group] (std::exception_ptr eptr) {
         try {
             std::rethrow_exception(eptr);
         } catch (const std::exception& e) {
-            return seastar::make_exception_future<column_chunk_reader<T>>(parquet_exception(seastar::format(
+            return seastar::make_exception_future<std::pair<column_chunk_reader<T>, uint64_t>>(parquet_exception(seastar::format(
                     "Could not open column chunk {} in row group {}: {}", column, row_group, e.what())));
         }
     });
@@ -183,5 +318,21 @@ template seastar::future<column_chunk_reader<format::Type::BYTE_ARRAY>>
 file_reader::open_column_chunk_reader(uint32_t row_group, uint32_t column);
 template seastar::future<column_chunk_reader<format::Type::FIXED_LEN_BYTE_ARRAY>>
 file_reader::open_column_chunk_reader(uint32_t row_group, uint32_t column);
+template seastar::future<std::pair<column_chunk_reader<format::Type::INT32>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+template seastar::future<std::pair<column_chunk_reader<format::Type::INT64>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+template seastar::future<std::pair<column_chunk_reader<format::Type::INT96>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+template seastar::future<std::pair<column_chunk_reader<format::Type::FLOAT>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+template seastar::future<std::pair<column_chunk_reader<format::Type::DOUBLE>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+template seastar::future<std::pair<column_chunk_reader<format::Type::BOOLEAN>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+template seastar::future<std::pair<column_chunk_reader<format::Type::BYTE_ARRAY>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
+template seastar::future<std::pair<column_chunk_reader<format::Type::FIXED_LEN_BYTE_ARRAY>, uint64_t>>
+file_reader::open_column_chunk_reader_at(uint32_t row_group, uint32_t column, uint64_t row);
 
 } // namespace parquet4seastar
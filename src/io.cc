@@ -0,0 +1,300 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include <parquet4seastar/io.hh>
+#include <parquet4seastar/exception.hh>
+#include <seastar/core/fstream.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/net/packet.hh>
+#include <algorithm>
+#include <cstring>
+
+namespace parquet4seastar {
+
+namespace {
+
+seastar::temporary_buffer<uint8_t> to_bytes(seastar::temporary_buffer<char> buf) {
+    uint8_t* data = reinterpret_cast<uint8_t*>(buf.get_write());
+    size_t size = buf.size();
+    return seastar::temporary_buffer<uint8_t>(data, size, buf.release());
+}
+
+seastar::temporary_buffer<char> to_chars(seastar::temporary_buffer<uint8_t> buf) {
+    char* data = reinterpret_cast<char*>(buf.get_write());
+    size_t size = buf.size();
+    return seastar::temporary_buffer<char>(data, size, buf.release());
+}
+
+void check_range(uint64_t pos, uint64_t len, uint64_t size) {
+    if (pos > size || len > size - pos) {
+        throw parquet_exception::corrupted_file(seastar::format(
+                "Read of [{}, {}) beyond the end of the source ({}B)", pos, pos + len, size));
+    }
+}
+
+class file_source final : public random_access_source {
+    seastar::file _file;
+public:
+    explicit file_source(seastar::file file) : _file{std::move(file)} {}
+    seastar::future<uint64_t> size() override {
+        return _file.size();
+    }
+    seastar::future<seastar::temporary_buffer<uint8_t>> read(uint64_t pos, size_t len) override {
+        return _file.dma_read_exactly<uint8_t>(pos, len);
+    }
+    seastar::input_stream<char> make_stream(uint64_t pos, uint64_t len) override {
+        return seastar::make_file_input_stream(_file, pos, len, {8192, 16});
+    }
+    seastar::future<> close() override {
+        return _file.close();
+    }
+};
+
+class buffers_data_source final : public seastar::data_source_impl {
+    buffer_chain _buffers;
+    size_t _next = 0;
+public:
+    explicit buffers_data_source(buffer_chain buffers) : _buffers{std::move(buffers)} {}
+    seastar::future<seastar::temporary_buffer<char>> get() override {
+        if (_next == _buffers.size()) {
+            return seastar::make_ready_future<seastar::temporary_buffer<char>>();
+        }
+        return seastar::make_ready_future<seastar::temporary_buffer<char>>(std::move(_buffers[_next++]));
+    }
+};
+
+class memory_source final : public random_access_source {
+    buffer_chain _buffers;
+    // _starts[i] is the position of _buffers[i]. The last element is the size of the source.
+    std::vector<uint64_t> _starts;
+private:
+    // Calls func(i, begin, end) for the part [begin, end) of each buffer i overlapping [pos, pos + len).
+    template <typename Func>
+    void for_each_part(uint64_t pos, uint64_t len, Func func) const {
+        check_range(pos, len, _starts.back());
+        size_t i = std::upper_bound(_starts.begin(), _starts.end(), pos) - _starts.begin() - 1;
+        for (; i < _buffers.size() && _starts[i] < pos + len; ++i) {
+            uint64_t begin = std::max(pos, _starts[i]) - _starts[i];
+            uint64_t end = std::min(pos + len, _starts[i + 1]) - _starts[i];
+            // An empty buffer would end the stream.
+            if (end > begin) {
+                func(i, begin, end);
+            }
+        }
+    }
+public:
+    explicit memory_source(buffer_chain buffers) : _buffers{std::move(buffers)} {
+        _starts.reserve(_buffers.size() + 1);
+        uint64_t pos = 0;
+        for (const seastar::temporary_buffer<char>& buf : _buffers) {
+            _starts.push_back(pos);
+            pos += buf.size();
+        }
+        _starts.push_back(pos);
+    }
+    seastar::future<uint64_t> size() override {
+        return seastar::make_ready_future<uint64_t>(_starts.back());
+    }
+    seastar::future<seastar::temporary_buffer<uint8_t>> read(uint64_t pos, size_t len) override {
+        return seastar::futurize_invoke([this, pos, len] {
+            buffer_chain parts;
+            for_each_part(pos, len, [&] (size_t i, uint64_t begin, uint64_t end) {
+                parts.push_back(_buffers[i].share(begin, end - begin));
+            });
+            if (parts.size() == 1) {
+                return to_bytes(std::move(parts[0]));
+            }
+            seastar::temporary_buffer<uint8_t> result(len);
+            size_t offset = 0;
+            for (const seastar::temporary_buffer<char>& part : parts) {
+                std::memcpy(result.get_write() + offset, part.get(), part.size());
+                offset += part.size();
+            }
+            return result;
+        });
+    }
+    seastar::input_stream<char> make_stream(uint64_t pos, uint64_t len) override {
+        buffer_chain parts;
+        for_each_part(pos, len, [&] (size_t i, uint64_t begin, uint64_t end) {
+            parts.push_back(_buffers[i].share(begin, end - begin));
+        });
+        return seastar::input_stream<char>(seastar::data_source(std::make_unique<buffers_data_source>(std::move(parts))));
+    }
+    seastar::future<> close() override {
+        _buffers.clear();
+        return seastar::make_ready_future<>();
+    }
+};
+
+class callback_data_source final : public seastar::data_source_impl {
+    read_callback _read;
+    uint64_t _pos;
+    uint64_t _end;
+    size_t _read_size;
+public:
+    callback_data_source(read_callback read, uint64_t pos, uint64_t end, size_t read_size)
+        : _read{std::move(read)}, _pos{pos}, _end{end}, _read_size{read_size} {}
+    seastar::future<seastar::temporary_buffer<char>> get() override {
+        if (_pos == _end) {
+            return seastar::make_ready_future<seastar::temporary_buffer<char>>();
+        }
+        size_t len = std::min<uint64_t>(_end - _pos, _read_size);
+        uint64_t pos = _pos;
+        _pos += len;
+        return _read(pos, len).then([pos, len] (seastar::temporary_buffer<uint8_t> buf) {
+            if (buf.size() != len) {
+                throw parquet_exception(seastar::format(
+                        "Read callback returned {}B instead of {}B at {}", buf.size(), len, pos));
+            }
+            return to_chars(std::move(buf));
+        });
+    }
+};
+
+class callback_source final : public random_access_source {
+    uint64_t _size;
+    read_callback _read;
+    size_t _stream_read_size;
+public:
+    callback_source(uint64_t size, read_callback read, size_t stream_read_size)
+        : _size{size}, _read{std::move(read)}, _stream_read_size{stream_read_size} {}
+    seastar::future<uint64_t> size() override {
+        return seastar::make_ready_future<uint64_t>(_size);
+    }
+    seastar::future<seastar::temporary_buffer<uint8_t>> read(uint64_t pos, size_t len) override {
+        return seastar::futurize_invoke([this, pos, len] {
+            check_range(pos, len, _size);
+            return _read(pos, len);
+        }).then([pos, len] (seastar::temporary_buffer<uint8_t> buf) {
+            if (buf.size() != len) {
+                throw parquet_exception(seastar::format(
+                        "Read callback returned {}B instead of {}B at {}", buf.size(), len, pos));
+            }
+            return buf;
+        });
+    }
+    seastar::input_stream<char> make_stream(uint64_t pos, uint64_t len) override {
+        check_range(pos, len, _size);
+        return seastar::input_stream<char>(seastar::data_source(
+                std::make_unique<callback_data_source>(_read, pos, pos + len, _stream_read_size)));
+    }
+    seastar::future<> close() override {
+        return seastar::make_ready_future<>();
+    }
+};
+
+class concatenated_data_source final : public seastar::data_source_impl {
+    std::vector<seastar::input_stream<char>> _streams;
+    size_t _current = 0;
+public:
+    explicit concatenated_data_source(std::vector<seastar::input_stream<char>> streams)
+        : _streams{std::move(streams)} {}
+    seastar::future<seastar::temporary_buffer<char>> get() override {
+        if (_current == _streams.size()) {
+            return seastar::make_ready_future<seastar::temporary_buffer<char>>();
+        }
+        return _streams[_current].read().then([this] (seastar::temporary_buffer<char> buf) {
+            if (buf.empty()) {
+                ++_current;
+                return get();
+            }
+            return seastar::make_ready_future<seastar::temporary_buffer<char>>(std::move(buf));
+        });
+    }
+};
+
+class memory_data_sink final : public seastar::data_sink_impl {
+    seastar::lw_shared_ptr<buffer_chain> _buffers;
+public:
+    explicit memory_data_sink(seastar::lw_shared_ptr<buffer_chain> buffers) : _buffers{std::move(buffers)} {}
+    seastar::future<> put(seastar::net::packet data) override {
+        for (seastar::temporary_buffer<char>& buf : data.release()) {
+            _buffers->push_back(std::move(buf));
+        }
+        return seastar::make_ready_future<>();
+    }
+    seastar::future<> put(seastar::temporary_buffer<char> buf) override {
+        _buffers->push_back(std::move(buf));
+        return seastar::make_ready_future<>();
+    }
+    seastar::future<> flush() override {
+        return seastar::make_ready_future<>();
+    }
+    seastar::future<> close() override {
+        return seastar::make_ready_future<>();
+    }
+};
+
+class callback_data_sink final : public seastar::data_sink_impl {
+    write_callback _write;
+public:
+    explicit callback_data_sink(write_callback write) : _write{std::move(write)} {}
+    seastar::future<> put(seastar::net::packet data) override {
+        return seastar::do_with(data.release(), [this] (buffer_chain& buffers) {
+            return seastar::do_for_each(buffers, [this] (seastar::temporary_buffer<char>& buf) {
+                return _write(std::move(buf));
+            });
+        });
+    }
+    seastar::future<> put(seastar::temporary_buffer<char> buf) override {
+        return _write(std::move(buf));
+    }
+    seastar::future<> flush() override {
+        return seastar::make_ready_future<>();
+    }
+    seastar::future<> close() override {
+        return seastar::make_ready_future<>();
+    }
+};
+
+} // namespace
+
+seastar::shared_ptr<random_access_source> make_file_source(seastar::file file) {
+    return seastar::make_shared<file_source>(std::move(file));
+}
+
+seastar::shared_ptr<random_access_source> make_memory_source(buffer_chain buffers) {
+    return seastar::make_shared<memory_source>(std::move(buffers));
+}
+
+seastar::shared_ptr<random_access_source>
+make_callback_source(uint64_t size, read_callback read, size_t stream_read_size) {
+    return seastar::make_shared<callback_source>(size, std::move(read), stream_read_size);
+}
+
+seastar::input_stream<char> make_concatenated_stream(std::vector<seastar::input_stream<char>> streams) {
+    return seastar::input_stream<char>(seastar::data_source(
+            std::make_unique<concatenated_data_source>(std::move(streams))));
+}
+
+seastar::output_stream<char>
+make_memory_output_stream(seastar::lw_shared_ptr<buffer_chain> buffers, size_t buffer_size) {
+    return seastar::output_stream<char>(
+            seastar::data_sink(std::make_unique<memory_data_sink>(std::move(buffers))), buffer_size);
+}
+
+seastar::output_stream<char>
+make_callback_output_stream(write_callback write, size_t buffer_size) {
+    return seastar::output_stream<char>(
+            seastar::data_sink(std::make_unique<callback_data_sink>(std::move(write))), buffer_size);
+}
+
+} // namespace parquet4seastar
@@ -325,4 +325,26 @@ void write_logical_type(logical_type logical_type, format::SchemaElement& leaf)
     }, logical_type);
 }
 
+
+// The sort orders are defined in parquet.thrift, in the comment to ColumnOrder.
+sort_order get_sort_order(const logical_type& logical_type) {
+    using namespace logical_type;
+    return std::visit(overloaded {
+            [] (const UINT8&) { return sort_order::UNSIGNED; },
+            [] (const UINT16&) { return sort_order::UNSIGNED; },
+            [] (const UINT32&) { return sort_order::UNSIGNED; },
+            [] (const UINT64&) { return sort_order::UNSIGNED; },
+            [] (const STRING&) { return sort_order::UNSIGNED; },
+            [] (const ENUM&) { return sort_order::UNSIGNED; },
+            [] (const UUID&) { return sort_order::UNSIGNED; },
+            [] (const JSON&) { return sort_order::UNSIGNED; },
+            [] (const BSON&) { return sort_order::UNSIGNED; },
+            [] (const BYTE_ARRAY&) { return sort_order::UNSIGNED; },
+            [] (const FIXED_LEN_BYTE_ARRAY&) { return sort_order::UNSIGNED; },
+            [] (const INTERVAL&) { return sort_order::UNDEFINED; },
+            [] (const INT96&) { return sort_order::UNDEFINED; },
+            [] (const auto&) { return sort_order::SIGNED; },
+    }, logical_type);
+}
+
 } // namespace parquet4seastar::logical_type
@@ -0,0 +1,149 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include <parquet4seastar/multi_record_reader.hh>
+
+namespace parquet4seastar::record {
+
+void multi_record_reader::check_schema(file_reader& fr) {
+    std::vector<column> columns;
+    for (const reader_schema::primitive_node* leaf : fr.schema().leaves) {
+        columns.push_back(column{leaf->path, leaf->info.type, leaf->def_level, leaf->rep_level});
+    }
+    if (!_columns) {
+        _columns = std::move(columns);
+        return;
+    }
+    bool compatible = columns.size() == _columns->size()
+            && std::equal(columns.begin(), columns.end(), _columns->begin(), [] (const column& a, const column& b) {
+                return a.path == b.path && a.type == b.type && a.def_level == b.def_level && a.rep_level == b.rep_level;
+            });
+    if (!compatible) {
+        throw parquet_exception(seastar::format(
+                "The schema of file {} is incompatible with the first file", _next_file - 1));
+    }
+}
+
+// Closes the file of the row group if no other row group (or the prefetch) uses it.
+seastar::future<> multi_record_reader::release(std::optional<row_group> rg) {
+    if (!rg) {
+        return seastar::make_ready_future<>();
+    }
+    rg->reader.reset();
+    seastar::lw_shared_ptr<file_reader> file = std::move(rg->owned_file);
+    if (!file || file.use_count() > 1) {
+        return seastar::make_ready_future<>();
+    }
+    return file->close().finally([file] {});
+}
+
+seastar::future<> multi_record_reader::open_next_file() {
+    size_t i = _next_file++;
+    _next_row_group = 0;
+    // The previous file is closed here only if it had no row groups.
+    return release(row_group{_file, std::move(_owned_file), nullptr}).then([this, i] {
+        _file = nullptr;
+        if (i < _files.size()) {
+            check_schema(*_files[i]);
+            _file = _files[i];
+            return seastar::make_ready_future<>();
+        }
+        return file_reader::open(_paths[i - _files.size()]).then([this] (file_reader fr) {
+            auto file = seastar::make_lw_shared<file_reader>(std::move(fr));
+            try {
+                check_schema(*file);
+            } catch (...) {
+                return file->close().finally([file] {}).then([ex = std::current_exception()] {
+                    return seastar::make_exception_future<>(ex);
+                });
+            }
+            _owned_file = std::move(file);
+            _file = _owned_file.get();
+            return seastar::make_ready_future<>();
+        });
+    });
+}
+
+// Opens the next row group (of this or a following file) and buffers its first records.
+seastar::future<std::optional<multi_record_reader::row_group>> multi_record_reader::open_next_row_group() {
+    using result = std::optional<std::optional<row_group>>;
+    return seastar::repeat_until_value([this] {
+        if (_file && _next_row_group < static_cast<int>(_file->shallow_metadata().row_groups.size())) {
+            int rg = _next_row_group++;
+            return row_group_may_match(*_file, rg, _filter).then([this, rg] (bool may_match) {
+                if (!may_match) {
+                    return seastar::make_ready_future<result>(result{});
+                }
+                return record_reader::make(*_file, rg, _projection, _filter).then([this] (record_reader rr) {
+                    auto reader = std::make_unique<record_reader>(std::move(rr));
+                    seastar::future<> prefetched = reader->prefetch();
+                    return prefetched.then([this, reader = std::move(reader)] () mutable {
+                        return result{row_group{_file, _owned_file, std::move(reader)}};
+                    });
+                });
+            });
+        }
+        if (_next_file == file_count()) {
+            return seastar::make_ready_future<result>(result{std::in_place});
+        }
+        return open_next_file().then([] {
+            return result{};
+        });
+    });
+}
+
+// Makes the next row group current and starts opening the one after it.
+seastar::future<bool> multi_record_reader::advance() {
+    seastar::future<std::optional<row_group>> next = _next ? std::move(*_next) : open_next_row_group();
+    _next.reset();
+    return next.then([this] (std::optional<row_group> rg) {
+        std::optional<row_group> previous = std::move(_current);
+        _current = std::move(rg);
+        if (_current) {
+            _next = open_next_row_group();
+        }
+        return release(std::move(previous)).then([this] {
+            return _current.has_value();
+        });
+    });
+}
+
+seastar::future<> multi_record_reader::close() {
+    seastar::future<> pending = seastar::make_ready_future<>();
+    if (_next) {
+        pending = std::move(*_next).then_wrapped([] (seastar::future<std::optional<row_group>> f) {
+            if (f.failed()) {
+                f.ignore_ready_future();
+                return seastar::make_ready_future<>();
+            }
+            return release(f.get0());
+        });
+        _next.reset();
+    }
+    return pending.then([this] {
+        return release(std::exchange(_current, std::nullopt));
+    }).then([this] {
+        // A file opened in the background, whose row groups weren't opened.
+        return release(row_group{_file, std::move(_owned_file), nullptr});
+    });
+}
+
+} // namespace parquet4seastar::record
@@ -0,0 +1,232 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include <parquet4seastar/predicate.hh>
+#include <parquet4seastar/bloom_filter.hh>
+#include <parquet4seastar/thrift_serdes.hh>
+#include <seastar/core/future-util.hh>
+
+namespace parquet4seastar::record {
+
+using predicate_internal::evaluator;
+
+namespace {
+
+bool has_value(comparison op) {
+    return op != comparison::is_null && op != comparison::is_not_null;
+}
+
+bool is_ordered(comparison op) {
+    return op != comparison::eq && op != comparison::ne && has_value(op);
+}
+
+template <format::Type::type ParquetType>
+bool statistics_may_match(const predicate& p, logical_type::sort_order order, const format::ColumnMetaData& md) {
+    using output_type = typename evaluator<ParquetType>::output_type;
+    constexpr bool is_byte_array =
+            ParquetType == format::Type::BYTE_ARRAY || ParquetType == format::Type::FIXED_LEN_BYTE_ARRAY;
+    if (!md.__isset.statistics) {
+        return true;
+    }
+    const format::Statistics& stats = md.statistics;
+    if (stats.__isset.null_count) {
+        bool all_null = stats.null_count == md.num_values;
+        if (p.op == comparison::is_null) {
+            return stats.null_count > 0;
+        } else if (p.op == comparison::is_not_null || all_null) {
+            return !all_null;
+        }
+    }
+    if (!has_value(p.op) || order == logical_type::sort_order::UNDEFINED) {
+        return true;
+    }
+    const std::string* min;
+    const std::string* max;
+    if (stats.__isset.min_value && stats.__isset.max_value) {
+        min = &stats.min_value;
+        max = &stats.max_value;
+    } else if (stats.__isset.min && stats.__isset.max && !is_byte_array
+            && order == logical_type::sort_order::SIGNED) {
+        // The deprecated fields are ordered as signed numbers.
+        min = &stats.min;
+        max = &stats.max;
+    } else {
+        return true;
+    }
+    evaluator<ParquetType> e{p, order};
+    if constexpr (is_byte_array) {
+        auto view = [] (const std::string& x) {
+            return bytes_view{reinterpret_cast<const byte*>(x.data()), x.size()};
+        };
+        return e.may_match_range(view(*min), view(*max));
+    } else {
+        if (min->size() != sizeof(output_type) || max->size() != sizeof(output_type)) {
+            return true;
+        }
+        output_type min_value;
+        output_type max_value;
+        std::memcpy(&min_value, min->data(), sizeof(min_value));
+        std::memcpy(&max_value, max->data(), sizeof(max_value));
+        if constexpr (std::is_floating_point_v<output_type>) {
+            if (std::isnan(min_value) || std::isnan(max_value)) {
+                return true;
+            }
+        }
+        return e.may_match_range(min_value, max_value);
+    }
+}
+
+bool statistics_may_match(const predicate& p, const reader_schema::primitive_node& leaf, const format::ColumnMetaData& md) {
+    logical_type::sort_order order = logical_type::get_sort_order(leaf.logical_type);
+    switch (leaf.info.type) {
+    case format::Type::BOOLEAN: return statistics_may_match<format::Type::BOOLEAN>(p, order, md);
+    case format::Type::INT32: return statistics_may_match<format::Type::INT32>(p, order, md);
+    case format::Type::INT64: return statistics_may_match<format::Type::INT64>(p, order, md);
+    case format::Type::FLOAT: return statistics_may_match<format::Type::FLOAT>(p, order, md);
+    case format::Type::DOUBLE: return statistics_may_match<format::Type::DOUBLE>(p, order, md);
+    case format::Type::BYTE_ARRAY: return statistics_may_match<format::Type::BYTE_ARRAY>(p, order, md);
+    case format::Type::FIXED_LEN_BYTE_ARRAY:
+        return statistics_may_match<format::Type::FIXED_LEN_BYTE_ARRAY>(p, order, md);
+    default: return true;
+    }
+}
+
+// The header of a bloom filter is a few bytes long.
+constexpr size_t MAX_BLOOM_FILTER_HEADER_SIZE = 64;
+
+seastar::future<bool> bloom_filter_may_contain(random_access_source& source, int64_t offset, uint64_t hash) {
+    return source.size().then([&source, offset, hash] (uint64_t size) {
+        if (offset < 0 || static_cast<uint64_t>(offset) >= size) {
+            throw parquet_exception::corrupted_file(seastar::format("Invalid bloom filter offset: {}", offset));
+        }
+        size_t header_len = std::min<uint64_t>(size - offset, MAX_BLOOM_FILTER_HEADER_SIZE);
+        return source.read(offset, header_len).then(
+        [&source, offset, hash, size] (seastar::temporary_buffer<uint8_t> buf) {
+            format::BloomFilterHeader header;
+            uint64_t header_size = deserialize_thrift_msg(buf.get(), buf.size(), header);
+            if (!header.algorithm.__isset.BLOCK || !header.hash.__isset.XXHASH
+                    || !header.compression.__isset.UNCOMPRESSED) {
+                // Unknown kind of filter.
+                return seastar::make_ready_future<bool>(true);
+            }
+            if (header.numBytes <= 0 || offset + header_size + header.numBytes > size) {
+                throw parquet_exception::corrupted_file(seastar::format(
+                        "Invalid bloom filter size: {}", header.numBytes));
+            }
+            return source.read(offset + header_size, header.numBytes).then(
+            [hash] (seastar::temporary_buffer<uint8_t> bitset) {
+                return bloom_filter::from_bitset(bytes_view{bitset.get(), bitset.size()}).find(hash);
+            });
+        });
+    });
+}
+
+} // namespace
+
+void check_predicates(file_reader& fr, const std::vector<predicate>& predicates) {
+    const reader_schema::schema& schema = fr.schema();
+    for (const predicate& p : predicates) {
+        if (p.column_index >= schema.leaves.size()) {
+            throw parquet_exception(seastar::format(
+                    "Predicate on column {}, but the schema has {} columns", p.column_index, schema.leaves.size()));
+        }
+        const reader_schema::primitive_node& leaf = *schema.leaves[p.column_index];
+        if (leaf.rep_level > 0) {
+            throw parquet_exception(seastar::format("Predicate on repeated column {}", leaf.path));
+        }
+        if (leaf.info.type == format::Type::INT96) {
+            throw parquet_exception(seastar::format("Predicate on INT96 column {}", leaf.path));
+        }
+        if (!has_value(p.op)) {
+            continue;
+        }
+        size_t expected_size;
+        switch (leaf.info.type) {
+        case format::Type::BOOLEAN: expected_size = 1; break;
+        case format::Type::INT32: expected_size = sizeof(int32_t); break;
+        case format::Type::INT64: expected_size = sizeof(int64_t); break;
+        case format::Type::FLOAT: expected_size = sizeof(float); break;
+        case format::Type::DOUBLE: expected_size = sizeof(double); break;
+        case format::Type::FIXED_LEN_BYTE_ARRAY: expected_size = leaf.info.type_length; break;
+        default: expected_size = p.value.size(); break;
+        }
+        if (p.value.size() != expected_size) {
+            throw parquet_exception(seastar::format(
+                    "Predicate value of size {} for column {} of type {}", p.value.size(), leaf.path, leaf.info.type));
+        }
+        if (is_ordered(p.op) && logical_type::get_sort_order(leaf.logical_type) == logical_type::sort_order::UNDEFINED) {
+            throw parquet_exception(seastar::format("Ordered comparison on unordered column {}", leaf.path));
+        }
+        bool is_nan = false;
+        if (leaf.info.type == format::Type::FLOAT) {
+            float x;
+            std::memcpy(&x, p.value.data(), sizeof(x));
+            is_nan = std::isnan(x);
+        } else if (leaf.info.type == format::Type::DOUBLE) {
+            double x;
+            std::memcpy(&x, p.value.data(), sizeof(x));
+            is_nan = std::isnan(x);
+        }
+        if (is_nan) {
+            throw parquet_exception(seastar::format("Predicate compares column {} with NaN", leaf.path));
+        }
+    }
+}
+
+seastar::future<bool> row_group_may_match(file_reader& fr, int row_group, const std::vector<predicate>& predicates) {
+    // Bloom filters are read only if the statistics don't rule the row group out.
+    std::vector<std::pair<int64_t, uint64_t>> bloom_checks;
+    try {
+        check_predicates(fr, predicates);
+        for (const predicate& p : predicates) {
+            const reader_schema::primitive_node& leaf = *fr.schema().leaves[p.column_index];
+            const format::ColumnChunk& chunk = fr.column_chunk(row_group, p.column_index);
+            if (!chunk.__isset.meta_data) {
+                continue;
+            }
+            const format::ColumnMetaData& md = chunk.meta_data;
+            if (!statistics_may_match(p, leaf, md)) {
+                return seastar::make_ready_future<bool>(false);
+            }
+            // Equal floating point numbers (0.0 and -0.0) may have different hashes.
+            if (p.op == comparison::eq && md.__isset.bloom_filter_offset
+                    && leaf.info.type != format::Type::FLOAT && leaf.info.type != format::Type::DOUBLE) {
+                bloom_checks.emplace_back(md.bloom_filter_offset, bloom_filter_hash(bytes_view{p.value}));
+            }
+        }
+    } catch (...) {
+        return seastar::make_exception_future<bool>(std::current_exception());
+    }
+    return seastar::do_with(std::move(bloom_checks), size_t(0),
+    [&fr] (std::vector<std::pair<int64_t, uint64_t>>& bloom_checks, size_t& i) {
+        return seastar::repeat_until_value([&fr, &bloom_checks, &i] {
+            if (i == bloom_checks.size()) {
+                return seastar::make_ready_future<std::optional<bool>>(true);
+            }
+            auto [offset, hash] = bloom_checks[i++];
+            return bloom_filter_may_contain(fr.source(), offset, hash).then([] (bool may_contain) {
+                return may_contain ? std::optional<bool>{} : std::optional<bool>{false};
+            });
+        });
+    });
+}
+
+} // namespace parquet4seastar::record
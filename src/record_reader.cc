@@ -22,33 +22,217 @@
 #include <parquet4seastar/record_reader.hh>
 #include <parquet4seastar/file_reader.hh>
 #include <parquet4seastar/overloaded.hh>
+#include <parquet4seastar/y_combinator.hh>
+#include <algorithm>
+#include <random>
+#include <unordered_set>
 
 namespace parquet4seastar::record {
 
-seastar::future<field_reader> field_reader::make(file_reader& fr, const reader_schema::node& node_variant, int row_group) {
+projection projection::of_columns(const reader_schema::schema& schema, const std::vector<uint32_t>& column_indices) {
+    projection p;
+    p._all = false;
+    p._columns.resize(schema.leaves.size());
+    for (uint32_t i : column_indices) {
+        if (i >= schema.leaves.size()) {
+            throw parquet_exception(seastar::format(
+                    "Column index {} out of range (the schema has {} columns)", i, schema.leaves.size()));
+        }
+        p._columns[i] = true;
+    }
+    return p;
+}
+
+projection projection::of_paths(const reader_schema::schema& schema, const std::vector<std::vector<std::string>>& paths) {
+    projection p;
+    p._all = false;
+    p._columns.resize(schema.leaves.size());
+    for (const std::vector<std::string>& path : paths) {
+        bool found = false;
+        for (const reader_schema::primitive_node* leaf : schema.leaves) {
+            if (path.size() <= leaf->path.size() && std::equal(path.begin(), path.end(), leaf->path.begin())) {
+                p._columns[leaf->column_index] = true;
+                found = true;
+            }
+        }
+        if (!found) {
+            throw parquet_exception(seastar::format("No node with path {} in the schema", path));
+        }
+    }
+    return p;
+}
+
+bool projection::selects(const reader_schema::node& node) const {
+    if (_all) {
+        return true;
+    }
+    return y_combinator{[this] (auto&& selects, const reader_schema::node& node_variant) -> bool {
+        return std::visit(overloaded {
+            [&] (const reader_schema::primitive_node& node) { return selects_column(node.column_index); },
+            [&] (const reader_schema::list_node& node) { return selects(*node.element); },
+            [&] (const reader_schema::optional_node& node) { return selects(*node.child); },
+            [&] (const reader_schema::map_node& node) { return selects(*node.key) || selects(*node.value); },
+            [&] (const reader_schema::struct_node& node) {
+                return std::any_of(node.fields.begin(), node.fields.end(), selects);
+            }
+        }, node_variant);
+    }}(node);
+}
+
+namespace {
+
+seastar::future<field_reader> make_primitive_reader(
+        file_reader& fr, const reader_schema::primitive_node& node, int row_group,
+        uint64_t first_row, bool use_arena) {
+    return std::visit([&] (auto lt) {
+        return fr.open_column_chunk_reader_at<lt.physical_type>(row_group, node.column_index, first_row).then(
+        [&node, first_row, use_arena] (std::pair<column_chunk_reader<lt.physical_type>, uint64_t> opened) {
+            using reader_type = typed_primitive_reader<decltype(lt)>;
+            auto& [ccr, rows_before] = opened;
+            reader_type reader{node, std::move(ccr), reader_type::DEFAULT_BATCH_SIZE, use_arena};
+            reader.skip_records(first_row - rows_before);
+            return field_reader{std::move(reader)};
+        });
+    }, node.logical_type);
+}
+
+// Splits the rows [first, end) of the file by row group. Each selection gets the rows
+// of the row group which the selector picks from [first, end), relative to the row group.
+template <typename Selector>
+std::vector<std::pair<int, row_selection>>
+select_rows(const format::FileMetaData& metadata, uint64_t first, uint64_t end, Selector select) {
+    std::vector<std::pair<int, row_selection>> result;
+    uint64_t row_group_start = 0;
+    for (size_t i = 0; i < metadata.row_groups.size(); ++i) {
+        int64_t num_rows = metadata.row_groups[i].num_rows;
+        if (num_rows < 0) {
+            throw parquet_exception::corrupted_file(seastar::format(
+                    "Negative row count in row group {}: {}", i, num_rows));
+        }
+        uint64_t row_group_end = row_group_start + num_rows;
+        if (row_group_end > first && row_group_start < end) {
+            row_selection rows;
+            rows.first = std::max(first, row_group_start) - row_group_start;
+            rows.end = std::min(end, row_group_end) - row_group_start;
+            select(rows, row_group_start);
+            if (!rows.rows || !rows.rows->empty()) {
+                result.emplace_back(i, std::move(rows));
+            }
+        }
+        row_group_start = row_group_end;
+    }
+    return result;
+}
+
+// Distributes sorted rows of the file among the row groups.
+std::vector<std::pair<int, row_selection>>
+select_sorted_rows(const format::FileMetaData& metadata, const std::vector<uint64_t>& rows) {
+    auto next = rows.begin();
+    return select_rows(metadata, 0, std::numeric_limits<uint64_t>::max(),
+    [&] (row_selection& selection, uint64_t row_group_start) {
+        selection.rows.emplace();
+        for (; next != rows.end() && *next < row_group_start + selection.end; ++next) {
+            selection.rows->push_back(*next - row_group_start);
+        }
+        if (!selection.rows->empty()) {
+            selection.first = selection.rows->front();
+            selection.end = selection.rows->back() + 1;
+        }
+    });
+}
+
+uint64_t total_rows(const format::FileMetaData& metadata) {
+    uint64_t rows = 0;
+    for (const format::RowGroup& rg : metadata.row_groups) {
+        rows += std::max<int64_t>(rg.num_rows, 0);
+    }
+    return rows;
+}
+
+} // namespace
+
+std::vector<std::pair<int, row_selection>>
+select_row_range(const format::FileMetaData& metadata, uint64_t first, uint64_t end) {
+    return select_rows(metadata, first, end, [] (row_selection&, uint64_t) {});
+}
+
+std::vector<std::pair<int, row_selection>>
+select_bernoulli_sample(const format::FileMetaData& metadata, double probability, uint64_t seed) {
+    if (!(probability >= 0 && probability <= 1)) {
+        throw parquet_exception(seastar::format("Invalid sampling probability: {}", probability));
+    }
+    uint64_t size = total_rows(metadata);
+    if (probability == 1) {
+        // geometric_distribution requires p < 1.
+        return select_row_range(metadata, 0, size);
+    }
+    std::vector<uint64_t> rows;
+    if (probability > 0) {
+        // The gaps between selected rows are geometrically distributed,
+        // so only the selected rows cost a random number.
+        std::mt19937_64 rng{seed};
+        std::geometric_distribution<uint64_t> gap{probability};
+        uint64_t row = gap(rng);
+        while (row < size) {
+            rows.push_back(row);
+            uint64_t next_gap = gap(rng);
+            if (next_gap >= size - row - 1) {
+                break;
+            }
+            row += next_gap + 1;
+        }
+    }
+    return select_sorted_rows(metadata, rows);
+}
+
+std::vector<std::pair<int, row_selection>>
+select_uniform_sample(const format::FileMetaData& metadata, uint64_t sample_size, uint64_t seed) {
+    uint64_t size = total_rows(metadata);
+    if (sample_size >= size) {
+        return select_row_range(metadata, 0, size);
+    }
+    // Floyd's algorithm: one random number per selected row.
+    std::mt19937_64 rng{seed};
+    std::unordered_set<uint64_t> selected;
+    for (uint64_t i = size - sample_size; i < size; ++i) {
+        uint64_t row = std::uniform_int_distribution<uint64_t>{0, i}(rng);
+        if (!selected.insert(row).second) {
+            selected.insert(i);
+        }
+    }
+    std::vector<uint64_t> rows{selected.begin(), selected.end()};
+    std::sort(rows.begin(), rows.end());
+    return select_sorted_rows(metadata, rows);
+}
+
+seastar::future<field_reader> field_reader::make(
+        file_reader& fr, const reader_schema::node& node_variant, int row_group,
+        const projection& proj, uint64_t first_row, bool use_arena) {
     return std::visit(overloaded {
         [&] (const reader_schema::primitive_node& node) -> seastar::future<field_reader> {
-            return std::visit([&] (auto lt) {
-                return fr.open_column_chunk_reader<lt.physical_type>(row_group, node.column_index).then(
-                [&node] (column_chunk_reader<lt.physical_type> ccr) {
-                    return field_reader{typed_primitive_reader<decltype(lt)>{node, std::move(ccr)}};
-                });
-            }, node.logical_type);
+            return make_primitive_reader(fr, node, row_group, first_row, use_arena);
         },
         [&] (const reader_schema::list_node& node) {
-            return field_reader::make(fr, *node.element, row_group).then([&node] (field_reader child) {
+            return field_reader::make(fr, *node.element, row_group, proj, first_row, use_arena).then(
+            [&node] (field_reader child) {
                 return field_reader{list_reader{node, std::make_unique<field_reader>(std::move(child))}};
             });
         },
         [&] (const reader_schema::optional_node& node) {
-            return field_reader::make(fr, *node.child, row_group).then([&node] (field_reader child) {
+            return field_reader::make(fr, *node.child, row_group, proj, first_row, use_arena).then(
+            [&node] (field_reader child) {
                 return field_reader{optional_reader{node, std::make_unique<field_reader>(std::move(child))}};
             });
         },
         [&] (const reader_schema::map_node& node) {
+            // Keys and values are inseparable, so an unselected side is read whole.
+            const projection all;
+            auto side_projection = [&] (const reader_schema::node& side) -> const projection& {
+                return proj.selects(side) ? proj : all;
+            };
             return seastar::when_all_succeed(
-                    field_reader::make(fr, *node.key, row_group),
-                    field_reader::make(fr, *node.value, row_group)
+                    field_reader::make(fr, *node.key, row_group, side_projection(*node.key), first_row, use_arena),
+                    field_reader::make(fr, *node.value, row_group, side_projection(*node.value), first_row, use_arena)
             ).then([&node] (field_reader key, field_reader value) {
                 return field_reader{map_reader{
                         node,
@@ -60,7 +244,9 @@ seastar::future<field_reader> field_reader::make(file_reader& fr, const reader_s
             std::vector<seastar::future<field_reader>> field_readers;
             field_readers.reserve(node.fields.size());
             for (const reader_schema::node& child : node.fields) {
-                field_readers.push_back(field_reader::make(fr, child, row_group));
+                if (proj.selects(child)) {
+                    field_readers.push_back(field_reader::make(fr, child, row_group, proj, first_row, use_arena));
+                }
             }
             return seastar::when_all_succeed(field_readers.begin(), field_readers.end()).then(
             [&node] (std::vector<field_reader> field_readers) {
@@ -70,14 +256,58 @@ seastar::future<field_reader> field_reader::make(file_reader& fr, const reader_s
     }, node_variant);
 }
 
-seastar::future<record_reader> record_reader::make(file_reader& fr, int row_group) {
+seastar::future<record_reader> record_reader::make(
+        file_reader& fr, int row_group, const projection& proj, std::vector<predicate> filter,
+        row_selection rows, bool use_arena) {
+    try {
+        check_predicates(fr, filter);
+    } catch (...) {
+        return seastar::make_exception_future<record_reader>(std::current_exception());
+    }
+    if (rows.rows) {
+        // Start at the first selected row.
+        auto& selected = *rows.rows;
+        selected.erase(selected.begin(), std::lower_bound(selected.begin(), selected.end(), rows.first));
+        selected.erase(std::lower_bound(selected.begin(), selected.end(), rows.end), selected.end());
+        if (!selected.empty()) {
+            rows.first = selected.front();
+        }
+    }
+    uint64_t first_row = rows.first;
     std::vector<seastar::future<field_reader>> field_readers;
     for (const reader_schema::node& field_node : fr.schema().fields) {
-        field_readers.push_back(field_reader::make(fr, field_node, row_group));
+        if (proj.selects(field_node)) {
+            field_readers.push_back(field_reader::make(fr, field_node, row_group, proj, first_row, use_arena));
+        }
     }
     return seastar::when_all_succeed(field_readers.begin(), field_readers.end()).then(
-    [&fr] (std::vector<field_reader> field_readers) {
-        return record_reader{fr.schema(), std::move(field_readers)};
+    [&fr, row_group, first_row, use_arena, filter = std::move(filter), rows = std::move(rows)]
+    (std::vector<field_reader> field_readers) mutable {
+        // Open the filtered columns which aren't a part of the projected fields.
+        std::vector<primitive_reader_base*> leaves;
+        for (field_reader& reader : field_readers) {
+            reader.collect_leaves(leaves);
+        }
+        std::vector<uint32_t> missing;
+        for (const predicate& p : filter) {
+            bool found = std::any_of(leaves.begin(), leaves.end(), [&p] (primitive_reader_base* leaf) {
+                return leaf->column_index() == p.column_index;
+            });
+            if (!found && std::find(missing.begin(), missing.end(), p.column_index) == missing.end()) {
+                missing.push_back(p.column_index);
+            }
+        }
+        std::vector<seastar::future<field_reader>> filter_readers;
+        for (uint32_t column : missing) {
+            filter_readers.push_back(make_primitive_reader(
+                    fr, *fr.schema().leaves[column], row_group, first_row, use_arena));
+        }
+        return seastar::when_all_succeed(filter_readers.begin(), filter_readers.end()).then(
+        [&fr, field_readers = std::move(field_readers), filter = std::move(filter), rows = std::move(rows)]
+        (std::vector<field_reader> filter_readers) mutable {
+            return record_reader{fr.schema(), std::move(field_readers), std::move(filter_readers),
+                    std::move(filter), std::move(rows)};
+        });
     });
 }
 
@@ -0,0 +1,247 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include <parquet4seastar/record_writer.hh>
+#include <parquet4seastar/overloaded.hh>
+#include <parquet4seastar/y_combinator.hh>
+
+namespace parquet4seastar::record {
+
+using namespace record_writer_internal;
+
+record_writer::record_writer(file_writer& fw, const writer_schema::schema& schema, record_writer_options options)
+    : _file_writer{fw}
+    , _options{options} {
+    auto convert = y_combinator{[&](auto&& convert, const writer_schema::node& node_variant, uint32_t rep) -> node {
+        return std::visit(overloaded {
+            [&] (const writer_schema::list_node& x) {
+                node n{node_kind::list, x.name, x.optional, rep + 1, _columns.size(), 0, {}};
+                n.children.push_back(convert(*x.element, rep + 1));
+                n.end_column = _columns.size();
+                return n;
+            },
+            [&] (const writer_schema::map_node& x) {
+                node n{node_kind::map, x.name, x.optional, rep + 1, _columns.size(), 0, {}};
+                n.children.push_back(convert(*x.key, rep + 1));
+                n.children.push_back(convert(*x.value, rep + 1));
+                n.end_column = _columns.size();
+                return n;
+            },
+            [&] (const writer_schema::struct_node& x) {
+                node n{node_kind::group, x.name, x.optional, rep, _columns.size(), 0, {}};
+                for (const writer_schema::node& child : x.fields) {
+                    n.children.push_back(convert(child, rep));
+                }
+                n.end_column = _columns.size();
+                return n;
+            },
+            [&] (const writer_schema::primitive_node& x) {
+                std::visit(overloaded {
+                    [&] (logical_type::INT96) {
+                        throw parquet_exception("INT96 is deprecated. Writing INT96 is unsupported.");
+                    },
+                    [&] (auto logical_type) {
+                        constexpr format::Type::type parquet_type = decltype(logical_type)::physical_type;
+                        _columns.emplace_back(column_buffer<parquet_type>{x.name, x.type_length});
+                    }
+                }, x.logical_type);
+                return node{node_kind::primitive, x.name, x.optional, rep, _columns.size() - 1, _columns.size(), {}};
+            }
+        }, node_variant);
+    }};
+    _root = node{node_kind::group, "schema", false, 0, 0, 0, {}};
+    for (const writer_schema::node& field : schema.fields) {
+        _root.children.push_back(convert(field, 0));
+    }
+    _root.end_column = _columns.size();
+    _next_rep.resize(_columns.size());
+}
+
+record_writer::frame& record_writer::top() {
+    if (_stack.empty()) {
+        throw parquet_exception("No record started");
+    }
+    return _stack.back();
+}
+
+// Returns the node which the next value of the current struct, list or map belongs to.
+const node& record_writer::start_value() {
+    frame& f = top();
+    const node& n = *f.n;
+    switch (n.kind) {
+    case node_kind::group:
+        if (f.filled == n.children.size()) {
+            throw parquet_exception(seastar::format("Too many fields in {}", n.name));
+        }
+        return n.children[f.filled++];
+    case node_kind::list:
+        if (f.filled++ > 0) {
+            // The next element repeats the list.
+            std::fill(_next_rep.begin() + n.first_column, _next_rep.begin() + n.end_column, n.rep_level);
+        }
+        return n.children[0];
+    case node_kind::map:
+        if (f.filled % 2 == 0 && f.filled > 0) {
+            std::fill(_next_rep.begin() + n.first_column, _next_rep.begin() + n.end_column, n.rep_level);
+        }
+        return n.children[f.filled++ % 2];
+    default:
+        throw parquet_exception(seastar::format("{} is not a struct, list or map", n.name));
+    }
+}
+
+// A null (or empty, for lists and maps) node is a single level without value in each of its columns.
+void record_writer::put_nulls(const node& n, uint32_t def) {
+    for (size_t i = n.first_column; i < n.end_column; ++i) {
+        std::visit([&] (auto& column) { column.put_null(def, _next_rep[i]); }, _columns[i]);
+    }
+}
+
+// Fields which weren't filled are null.
+void record_writer::fill_group() {
+    frame& f = top();
+    for (; f.filled < f.n->children.size(); ++f.filled) {
+        const node& field = f.n->children[f.filled];
+        if (!field.optional) {
+            throw parquet_exception(seastar::format("Required field {} is missing", field.name));
+        }
+        put_nulls(field, f.def_level);
+    }
+}
+
+void record_writer::start_record() {
+    if (!_stack.empty()) {
+        throw parquet_exception("The previous record was not ended");
+    }
+    std::fill(_next_rep.begin(), _next_rep.end(), 0);
+    _stack.push_back(frame{&_root, 0});
+}
+
+void record_writer::end_record() {
+    if (_stack.size() != 1) {
+        throw parquet_exception("end_record() called inside a struct, list or map");
+    }
+    fill_group();
+    _stack.pop_back();
+    if (++_buffered_records >= _options.batch_size) {
+        flush();
+    }
+}
+
+void record_writer::start_field(const std::string& name) {
+    frame& f = top();
+    if (f.n->kind != node_kind::group) {
+        throw parquet_exception(seastar::format("{} is not a struct", f.n->name));
+    }
+    const std::vector<node>& fields = f.n->children;
+    auto it = std::find_if(fields.begin() + f.filled, fields.end(), [&] (const node& field) {
+        return field.name == name;
+    });
+    if (it == fields.end()) {
+        throw parquet_exception(seastar::format(
+                "No field {} in {} after the fields already written", name, f.n->name));
+    }
+    size_t index = it - fields.begin();
+    for (; f.filled < index; ++f.filled) {
+        if (!fields[f.filled].optional) {
+            throw parquet_exception(seastar::format("Required field {} is missing", fields[f.filled].name));
+        }
+        put_nulls(fields[f.filled], f.def_level);
+    }
+}
+
+void record_writer::start_struct() {
+    const node& n = start_value();
+    if (n.kind != node_kind::group) {
+        throw parquet_exception(seastar::format("{} is not a struct", n.name));
+    }
+    _stack.push_back(frame{&n, top().def_level + n.optional});
+}
+
+void record_writer::end_struct() {
+    if (_stack.size() < 2 || top().n->kind != node_kind::group) {
+        throw parquet_exception("end_struct() called outside of a struct");
+    }
+    fill_group();
+    _stack.pop_back();
+}
+
+void record_writer::start_list() {
+    const node& n = start_value();
+    if (n.kind != node_kind::list) {
+        throw parquet_exception(seastar::format("{} is not a list", n.name));
+    }
+    // The elements are one level deeper than the (non-null) list.
+    _stack.push_back(frame{&n, top().def_level + n.optional + 1});
+}
+
+void record_writer::end_list() {
+    frame& f = top();
+    if (f.n->kind != node_kind::list) {
+        throw parquet_exception("end_list() called outside of a list");
+    }
+    if (f.filled == 0) {
+        put_nulls(*f.n, f.def_level - 1);
+    }
+    _stack.pop_back();
+}
+
+void record_writer::start_map() {
+    const node& n = start_value();
+    if (n.kind != node_kind::map) {
+        throw parquet_exception(seastar::format("{} is not a map", n.name));
+    }
+    _stack.push_back(frame{&n, top().def_level + n.optional + 1});
+}
+
+void record_writer::end_map() {
+    frame& f = top();
+    if (f.n->kind != node_kind::map) {
+        throw parquet_exception("end_map() called outside of a map");
+    }
+    if (f.filled % 2 != 0) {
+        throw parquet_exception(seastar::format("A key without a value in {}", f.n->name));
+    }
+    if (f.filled == 0) {
+        put_nulls(*f.n, f.def_level - 1);
+    }
+    _stack.pop_back();
+}
+
+void record_writer::append_null() {
+    const node& n = start_value();
+    if (!n.optional) {
+        throw parquet_exception(seastar::format("A null appended to required {}", n.name));
+    }
+    put_nulls(n, top().def_level);
+}
+
+void record_writer::flush() {
+    for (size_t i = 0; i < _columns.size(); ++i) {
+        std::visit([&] (auto& column) {
+            constexpr format::Type::type parquet_type = std::decay_t<decltype(column)>::parquet_type;
+            column.flush(_file_writer.column<parquet_type>(i));
+        }, _columns[i]);
+    }
+    _buffered_records = 0;
+}
+
+} // namespace parquet4seastar::record
@@ -0,0 +1,117 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include <parquet4seastar/spill_file.hh>
+#include <parquet4seastar/exception.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/core/seastar.hh>
+#include <boost/iterator/counting_iterator.hpp>
+#include <unistd.h>
+
+namespace parquet4seastar {
+
+spill_file::spill_file(seastar::file file)
+    : _file{std::move(file)}
+    , _staging{seastar::temporary_buffer<char>::aligned(_file.memory_dma_alignment(), STAGING_SIZE)}
+    , _regions{{0, 0}} {
+}
+
+seastar::future<spill_file> spill_file::open(const std::string& directory) {
+    static thread_local uint64_t counter = 0;
+    std::string path = seastar::format("{}/parquet4seastar-spill-{}-{}-{}",
+            directory, ::getpid(), seastar::this_shard_id(), counter++);
+    seastar::open_flags flags
+            = seastar::open_flags::rw
+            | seastar::open_flags::create
+            | seastar::open_flags::exclusive;
+    return seastar::open_file_dma(path, flags).then([path] (seastar::file file) {
+        return seastar::remove_file(path).then([file] () mutable {
+            return spill_file{std::move(file)};
+        });
+    });
+}
+
+seastar::future<> spill_file::write_staging(size_t len) {
+    return _file.dma_write(_pos, _staging.get(), len).then([this, len] (size_t written) {
+        if (written != len) {
+            throw parquet_exception(seastar::format(
+                    "Short write to spill file (expected {}B, wrote {}B)", len, written));
+        }
+        _pos += len;
+        _staged = 0;
+    });
+}
+
+seastar::future<> spill_file::write(bytes_view data) {
+    _regions.back().size += data.size();
+    _size += data.size();
+    return seastar::do_with(data, [this] (bytes_view& data) {
+        return seastar::do_until([&data] { return data.empty(); }, [this, &data] {
+            size_t n = std::min(data.size(), _staging.size() - _staged);
+            std::memcpy(_staging.get_write() + _staged, data.data(), n);
+            _staged += n;
+            data.remove_prefix(n);
+            if (_staged == _staging.size()) {
+                return write_staging(_staged);
+            }
+            return seastar::make_ready_future<>();
+        });
+    });
+}
+
+seastar::future<> spill_file::flush() {
+    if (_staged == 0) {
+        return seastar::make_ready_future<>();
+    }
+    size_t alignment = _file.disk_write_dma_alignment();
+    size_t padded = (_staged + alignment - 1) / alignment * alignment;
+    std::memset(_staging.get_write() + _staged, 0, padded - _staged);
+    return write_staging(padded).then([this] {
+        _regions.push_back(region{_pos, 0});
+    });
+}
+
+seastar::future<> spill_file::copy_to(seastar::output_stream<char>& sink) {
+    return flush().then([this, &sink] {
+        return seastar::do_for_each(_regions, [this, &sink] (const region& r) {
+            using it = boost::counting_iterator<uint64_t>;
+            uint64_t n_reads = (r.size + READ_SIZE - 1) / READ_SIZE;
+            return seastar::do_for_each(it(0), it(n_reads), [this, &r, &sink] (uint64_t i) {
+                uint64_t offset = i * READ_SIZE;
+                size_t len = std::min<uint64_t>(READ_SIZE, r.size - offset);
+                return _file.dma_read_exactly<char>(r.pos + offset, len).then(
+                [&sink] (seastar::temporary_buffer<char> buf) {
+                    return sink.write(buf.get(), buf.size()).finally([buf = std::move(buf)] {});
+                });
+            });
+        });
+    }).then([this] {
+        _regions = {region{0, 0}};
+        _pos = 0;
+        _size = 0;
+    });
+}
+
+seastar::future<> spill_file::close() {
+    return _file.close();
+}
+
+} // namespace parquet4seastar
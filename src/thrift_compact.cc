@@ -0,0 +1,819 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include <parquet4seastar/thrift_compact.hh>
+#include <parquet4seastar/thrift_serdes.hh>
+#include <cstring>
+
+namespace parquet4seastar::thrift_compact {
+
+namespace {
+
+// The types of the compact protocol.
+enum ctype : uint8_t {
+    STOP = 0,
+    BOOLEAN_TRUE = 1,
+    BOOLEAN_FALSE = 2,
+    BYTE = 3,
+    I16 = 4,
+    I32 = 5,
+    I64 = 6,
+    DOUBLE = 7,
+    BINARY = 8,
+    LIST = 9,
+    SET = 10,
+    MAP = 11,
+    STRUCT = 12,
+};
+
+// Deeper messages are rejected, so that skipping them can't overflow the stack.
+constexpr int MAX_DEPTH = 64;
+
+struct field {
+    int16_t id;
+    uint8_t type;
+};
+
+class reader {
+    const byte* _begin;
+    const byte* _pos;
+    const byte* _end;
+    int _depth = 0;
+
+    struct nesting {
+        int& depth;
+        explicit nesting(int& d) : depth{d} {
+            if (++depth > MAX_DEPTH) {
+                throw parquet_exception::corrupted_file("Thrift message nested too deeply");
+            }
+        }
+        ~nesting() { --depth; }
+    };
+    void ensure(uint64_t n) const {
+        if (n > static_cast<uint64_t>(_end - _pos)) {
+            throw truncated_message();
+        }
+    }
+public:
+    explicit reader(bytes_view data)
+        : _begin{data.data()}, _pos{data.data()}, _end{data.data() + data.size()} {}
+    size_t bytes_read() const { return _pos - _begin; }
+    const byte* position() const { return _pos; }
+
+    uint8_t read_byte() {
+        ensure(1);
+        return *_pos++;
+    }
+    uint64_t read_varint() {
+        uint64_t result = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = read_byte();
+            result |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return result;
+            }
+        }
+        throw parquet_exception::corrupted_file("Thrift varint longer than 10 bytes");
+    }
+    int64_t read_zigzag() {
+        uint64_t n = read_varint();
+        return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+    }
+    double read_double() {
+        ensure(sizeof(double));
+        double result;
+        std::memcpy(&result, _pos, sizeof(result));
+        _pos += sizeof(result);
+        return result;
+    }
+    bytes_view read_binary() {
+        uint64_t len = read_varint();
+        ensure(len);
+        bytes_view result{_pos, static_cast<size_t>(len)};
+        _pos += len;
+        return result;
+    }
+    // Returns the element type and the size. Each element takes at least a byte.
+    std::pair<uint8_t, uint32_t> read_list_header() {
+        uint8_t b = read_byte();
+        uint64_t size = b >> 4;
+        if (size == 15) {
+            size = read_varint();
+        }
+        ensure(size);
+        return {b & 0x0f, static_cast<uint32_t>(size)};
+    }
+
+    // Calls on_field for each field of a struct. Fields for which it returns false are skipped.
+    template <typename OnField>
+    void read_struct(OnField on_field) {
+        nesting n{_depth};
+        int16_t last_id = 0;
+        while (true) {
+            uint8_t b = read_byte();
+            field f;
+            f.type = b & 0x0f;
+            if (f.type == STOP) {
+                return;
+            }
+            uint8_t delta = b >> 4;
+            f.id = delta ? last_id + delta : static_cast<int16_t>(read_zigzag());
+            last_id = f.id;
+            if (!on_field(f)) {
+                skip(f.type);
+            }
+        }
+    }
+
+    // Skips the value of a field. Boolean fields have no value.
+    void skip(uint8_t type) {
+        switch (type) {
+        case BOOLEAN_TRUE:
+        case BOOLEAN_FALSE:
+            return;
+        case BYTE:
+            read_byte();
+            return;
+        case I16:
+        case I32:
+        case I64:
+            read_varint();
+            return;
+        case DOUBLE:
+            read_double();
+            return;
+        case BINARY:
+            read_binary();
+            return;
+        case LIST:
+        case SET: {
+            nesting n{_depth};
+            auto [element_type, size] = read_list_header();
+            for (uint32_t i = 0; i < size; ++i) {
+                skip_element(element_type);
+            }
+            return;
+        }
+        case MAP: {
+            nesting n{_depth};
+            uint64_t size = read_varint();
+            if (size == 0) {
+                return;
+            }
+            uint8_t types = read_byte();
+            ensure(size);
+            for (uint64_t i = 0; i < size; ++i) {
+                skip_element(types >> 4);
+                skip_element(types & 0x0f);
+            }
+            return;
+        }
+        case STRUCT:
+            read_struct([] (const field&) { return false; });
+            return;
+        default:
+            throw parquet_exception::corrupted_file(seastar::format("Unknown Thrift compact type {}", type));
+        }
+    }
+    // Skips an element of a container. Boolean elements take a byte.
+    void skip_element(uint8_t type) {
+        if (type == BOOLEAN_TRUE || type == BOOLEAN_FALSE) {
+            read_byte();
+        } else {
+            skip(type);
+        }
+    }
+};
+
+void require(bool isset, const char* name) {
+    if (!isset) {
+        throw parquet_exception::corrupted_file(seastar::format("Required Thrift field {} is missing", name));
+    }
+}
+
+// The structures are read with read(reader&, T&). They are declared upfront,
+// because the templates below find them by ordinary lookup.
+void read(reader& r, format::Statistics& out);
+void read(reader& r, format::DataPageHeader& out);
+void read(reader& r, format::IndexPageHeader& out);
+void read(reader& r, format::DictionaryPageHeader& out);
+void read(reader& r, format::DataPageHeaderV2& out);
+void read(reader& r, format::PageHeader& out);
+void read(reader& r, format::KeyValue& out);
+void read(reader& r, format::PageEncodingStats& out);
+void read(reader& r, format::ColumnMetaData& out);
+void read(reader& r, format::ColumnChunk& out);
+void read(reader& r, format::SortingColumn& out);
+void read(reader& r, format::RowGroup& out);
+void read(reader& r, format::TimeUnit& out);
+void read(reader& r, format::DecimalType& out);
+void read(reader& r, format::TimeType& out);
+void read(reader& r, format::TimestampType& out);
+void read(reader& r, format::IntType& out);
+void read(reader& r, format::LogicalType& out);
+void read(reader& r, format::SchemaElement& out);
+void read(reader& r, format::ColumnOrder& out);
+void read(reader& r, format::EncryptionAlgorithm& out);
+void read(reader& r, format::ColumnCryptoMetaData& out);
+void read(reader& r, format::FileMetaData& out);
+
+template <typename T> struct is_vector : std::false_type {};
+template <typename T> struct is_vector<std::vector<T>> : std::true_type {};
+
+// The compact type of the values of T.
+template <typename T>
+constexpr uint8_t type_of() {
+    if constexpr (std::is_same_v<T, bool>) {
+        return BOOLEAN_TRUE;
+    } else if constexpr (std::is_same_v<T, int8_t>) {
+        return BYTE;
+    } else if constexpr (std::is_same_v<T, int16_t>) {
+        return I16;
+    } else if constexpr (std::is_same_v<T, int32_t> || std::is_enum_v<T>) {
+        return I32;
+    } else if constexpr (std::is_same_v<T, int64_t>) {
+        return I64;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return BINARY;
+    } else if constexpr (is_vector<T>::value) {
+        return LIST;
+    } else {
+        return STRUCT;
+    }
+}
+
+template <typename T>
+void read(reader& r, T& out) {
+    if constexpr (std::is_same_v<T, int8_t>) {
+        out = static_cast<int8_t>(r.read_byte());
+    } else if constexpr (std::is_integral_v<T>) {
+        out = static_cast<T>(r.read_zigzag());
+    } else if constexpr (std::is_enum_v<T>) {
+        out = static_cast<T>(static_cast<int32_t>(r.read_zigzag()));
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        bytes_view v = r.read_binary();
+        out.assign(reinterpret_cast<const char*>(v.data()), v.size());
+    } else {
+        static_assert(is_vector<T>::value);
+        using element_type = typename T::value_type;
+        static_assert(!std::is_same_v<element_type, bool>);
+        auto [type, size] = r.read_list_header();
+        out.clear();
+        if (type != type_of<element_type>()) {
+            for (uint32_t i = 0; i < size; ++i) {
+                r.skip_element(type);
+            }
+            return;
+        }
+        out.resize(size);
+        for (element_type& element : out) {
+            read(r, element);
+        }
+    }
+}
+
+// Reads the value of the field into out and returns true if it has the type of out.
+// Otherwise returns false, and the field is skipped.
+template <typename T>
+bool read_field(reader& r, const field& f, T& out) {
+    if constexpr (std::is_same_v<T, bool>) {
+        if (f.type != BOOLEAN_TRUE && f.type != BOOLEAN_FALSE) {
+            return false;
+        }
+        out = f.type == BOOLEAN_TRUE;
+    } else {
+        if (f.type != type_of<T>()) {
+            return false;
+        }
+        read(r, out);
+    }
+    return true;
+}
+
+// Like read_field, but also sets the flag.
+template <typename T>
+bool read_field(reader& r, const field& f, T& out, bool& isset) {
+    if (read_field(r, f, out)) {
+        isset = true;
+        return true;
+    }
+    return false;
+}
+
+// Like read_field, but also marks an optional field as set. The __isset flags
+// generated by Thrift are bit-fields, so they can't be bound to a bool&.
+template <typename T, typename SetFlag>
+bool read_optional(reader& r, const field& f, T& out, SetFlag set_flag) {
+    if (read_field(r, f, out)) {
+        set_flag();
+        return true;
+    }
+    return false;
+}
+
+// An empty structure, or a member of a union of empty structures.
+template <typename T, typename SetFlag>
+bool read_empty(reader& r, const field& f, T&, SetFlag set_flag) {
+    if (f.type != STRUCT) {
+        return false;
+    }
+    r.skip(STRUCT);
+    set_flag();
+    return true;
+}
+
+void read(reader& r, format::Statistics& out) {
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_optional(r, f, out.max, [&] { out.__isset.max = true; });
+        case 2: return read_optional(r, f, out.min, [&] { out.__isset.min = true; });
+        case 3: return read_optional(r, f, out.null_count, [&] { out.__isset.null_count = true; });
+        case 4: return read_optional(r, f, out.distinct_count, [&] { out.__isset.distinct_count = true; });
+        case 5: return read_optional(r, f, out.max_value, [&] { out.__isset.max_value = true; });
+        case 6: return read_optional(r, f, out.min_value, [&] { out.__isset.min_value = true; });
+        default: return false;
+        }
+    });
+}
+
+void read(reader& r, format::DataPageHeader& out) {
+    bool num_values = false;
+    bool encoding = false;
+    bool definition_level_encoding = false;
+    bool repetition_level_encoding = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.num_values, num_values);
+        case 2: return read_field(r, f, out.encoding, encoding);
+        case 3: return read_field(r, f, out.definition_level_encoding, definition_level_encoding);
+        case 4: return read_field(r, f, out.repetition_level_encoding, repetition_level_encoding);
+        case 5: return read_optional(r, f, out.statistics, [&] { out.__isset.statistics = true; });
+        default: return false;
+        }
+    });
+    require(num_values, "DataPageHeader.num_values");
+    require(encoding, "DataPageHeader.encoding");
+    require(definition_level_encoding, "DataPageHeader.definition_level_encoding");
+    require(repetition_level_encoding, "DataPageHeader.repetition_level_encoding");
+}
+
+void read(reader& r, format::IndexPageHeader&) {
+    r.skip(STRUCT);
+}
+
+void read(reader& r, format::DictionaryPageHeader& out) {
+    bool num_values = false;
+    bool encoding = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.num_values, num_values);
+        case 2: return read_field(r, f, out.encoding, encoding);
+        case 3: return read_optional(r, f, out.is_sorted, [&] { out.__isset.is_sorted = true; });
+        default: return false;
+        }
+    });
+    require(num_values, "DictionaryPageHeader.num_values");
+    require(encoding, "DictionaryPageHeader.encoding");
+}
+
+void read(reader& r, format::DataPageHeaderV2& out) {
+    bool num_values = false;
+    bool num_nulls = false;
+    bool num_rows = false;
+    bool encoding = false;
+    bool definition_levels_byte_length = false;
+    bool repetition_levels_byte_length = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.num_values, num_values);
+        case 2: return read_field(r, f, out.num_nulls, num_nulls);
+        case 3: return read_field(r, f, out.num_rows, num_rows);
+        case 4: return read_field(r, f, out.encoding, encoding);
+        case 5: return read_field(r, f, out.definition_levels_byte_length, definition_levels_byte_length);
+        case 6: return read_field(r, f, out.repetition_levels_byte_length, repetition_levels_byte_length);
+        case 7: return read_optional(r, f, out.is_compressed, [&] { out.__isset.is_compressed = true; });
+        case 8: return read_optional(r, f, out.statistics, [&] { out.__isset.statistics = true; });
+        default: return false;
+        }
+    });
+    require(num_values, "DataPageHeaderV2.num_values");
+    require(num_nulls, "DataPageHeaderV2.num_nulls");
+    require(num_rows, "DataPageHeaderV2.num_rows");
+    require(encoding, "DataPageHeaderV2.encoding");
+    require(definition_levels_byte_length, "DataPageHeaderV2.definition_levels_byte_length");
+    require(repetition_levels_byte_length, "DataPageHeaderV2.repetition_levels_byte_length");
+}
+
+void read(reader& r, format::PageHeader& out) {
+    bool type = false;
+    bool uncompressed_page_size = false;
+    bool compressed_page_size = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.type, type);
+        case 2: return read_field(r, f, out.uncompressed_page_size, uncompressed_page_size);
+        case 3: return read_field(r, f, out.compressed_page_size, compressed_page_size);
+        case 4: return read_optional(r, f, out.crc, [&] { out.__isset.crc = true; });
+        case 5: return read_optional(r, f, out.data_page_header, [&] { out.__isset.data_page_header = true; });
+        case 6: return read_optional(r, f, out.index_page_header, [&] { out.__isset.index_page_header = true; });
+        case 7: return read_optional(r, f, out.dictionary_page_header, [&] { out.__isset.dictionary_page_header = true; });
+        case 8: return read_optional(r, f, out.data_page_header_v2, [&] { out.__isset.data_page_header_v2 = true; });
+        default: return false;
+        }
+    });
+    require(type, "PageHeader.type");
+    require(uncompressed_page_size, "PageHeader.uncompressed_page_size");
+    require(compressed_page_size, "PageHeader.compressed_page_size");
+}
+
+void read(reader& r, format::KeyValue& out) {
+    bool key = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.key, key);
+        case 2: return read_optional(r, f, out.value, [&] { out.__isset.value = true; });
+        default: return false;
+        }
+    });
+    require(key, "KeyValue.key");
+}
+
+void read(reader& r, format::PageEncodingStats& out) {
+    bool page_type = false;
+    bool encoding = false;
+    bool count = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.page_type, page_type);
+        case 2: return read_field(r, f, out.encoding, encoding);
+        case 3: return read_field(r, f, out.count, count);
+        default: return false;
+        }
+    });
+    require(page_type, "PageEncodingStats.page_type");
+    require(encoding, "PageEncodingStats.encoding");
+    require(count, "PageEncodingStats.count");
+}
+
+void read(reader& r, format::ColumnMetaData& out) {
+    bool type = false;
+    bool encodings = false;
+    bool path_in_schema = false;
+    bool codec = false;
+    bool num_values = false;
+    bool total_uncompressed_size = false;
+    bool total_compressed_size = false;
+    bool data_page_offset = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.type, type);
+        case 2: return read_field(r, f, out.encodings, encodings);
+        case 3: return read_field(r, f, out.path_in_schema, path_in_schema);
+        case 4: return read_field(r, f, out.codec, codec);
+        case 5: return read_field(r, f, out.num_values, num_values);
+        case 6: return read_field(r, f, out.total_uncompressed_size, total_uncompressed_size);
+        case 7: return read_field(r, f, out.total_compressed_size, total_compressed_size);
+        case 8: return read_optional(r, f, out.key_value_metadata, [&] { out.__isset.key_value_metadata = true; });
+        case 9: return read_field(r, f, out.data_page_offset, data_page_offset);
+        case 10: return read_optional(r, f, out.index_page_offset, [&] { out.__isset.index_page_offset = true; });
+        case 11: return read_optional(r, f, out.dictionary_page_offset, [&] { out.__isset.dictionary_page_offset = true; });
+        case 12: return read_optional(r, f, out.statistics, [&] { out.__isset.statistics = true; });
+        case 13: return read_optional(r, f, out.encoding_stats, [&] { out.__isset.encoding_stats = true; });
+        case 14: return read_optional(r, f, out.bloom_filter_offset, [&] { out.__isset.bloom_filter_offset = true; });
+        default: return false;
+        }
+    });
+    require(type, "ColumnMetaData.type");
+    require(encodings, "ColumnMetaData.encodings");
+    require(path_in_schema, "ColumnMetaData.path_in_schema");
+    require(codec, "ColumnMetaData.codec");
+    require(num_values, "ColumnMetaData.num_values");
+    require(total_uncompressed_size, "ColumnMetaData.total_uncompressed_size");
+    require(total_compressed_size, "ColumnMetaData.total_compressed_size");
+    require(data_page_offset, "ColumnMetaData.data_page_offset");
+}
+
+void read(reader& r, format::ColumnChunk& out) {
+    bool file_offset = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_optional(r, f, out.file_path, [&] { out.__isset.file_path = true; });
+        case 2: return read_field(r, f, out.file_offset, file_offset);
+        case 3: return read_optional(r, f, out.meta_data, [&] { out.__isset.meta_data = true; });
+        case 4: return read_optional(r, f, out.offset_index_offset, [&] { out.__isset.offset_index_offset = true; });
+        case 5: return read_optional(r, f, out.offset_index_length, [&] { out.__isset.offset_index_length = true; });
+        case 6: return read_optional(r, f, out.column_index_offset, [&] { out.__isset.column_index_offset = true; });
+        case 7: return read_optional(r, f, out.column_index_length, [&] { out.__isset.column_index_length = true; });
+        case 8: return read_optional(r, f, out.crypto_metadata, [&] { out.__isset.crypto_metadata = true; });
+        case 9: return read_optional(r, f, out.encrypted_column_metadata, [&] { out.__isset.encrypted_column_metadata = true; });
+        default: return false;
+        }
+    });
+    require(file_offset, "ColumnChunk.file_offset");
+}
+
+void read(reader& r, format::SortingColumn& out) {
+    bool column_idx = false;
+    bool descending = false;
+    bool nulls_first = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.column_idx, column_idx);
+        case 2: return read_field(r, f, out.descending, descending);
+        case 3: return read_field(r, f, out.nulls_first, nulls_first);
+        default: return false;
+        }
+    });
+    require(column_idx, "SortingColumn.column_idx");
+    require(descending, "SortingColumn.descending");
+    require(nulls_first, "SortingColumn.nulls_first");
+}
+
+// Skips the elements of a list of structures, remembering where each begins and where the last ends.
+void index_list(reader& r, std::vector<uint32_t>& offsets) {
+    auto [type, size] = r.read_list_header();
+    offsets.clear();
+    if (type == STRUCT) {
+        offsets.reserve(size + 1);
+        for (uint32_t i = 0; i < size; ++i) {
+            offsets.push_back(r.bytes_read());
+            r.skip(STRUCT);
+        }
+    } else {
+        for (uint32_t i = 0; i < size; ++i) {
+            r.skip_element(type);
+        }
+    }
+    offsets.push_back(r.bytes_read());
+}
+
+// If column_chunk_offsets is given, the columns are indexed instead of read.
+void read_row_group(reader& r, format::RowGroup& out, std::vector<uint32_t>* column_chunk_offsets) {
+    bool columns = false;
+    bool total_byte_size = false;
+    bool num_rows = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1:
+            if (!column_chunk_offsets) {
+                return read_field(r, f, out.columns, columns);
+            } else if (f.type != LIST) {
+                return false;
+            }
+            index_list(r, *column_chunk_offsets);
+            columns = true;
+            return true;
+        case 2: return read_field(r, f, out.total_byte_size, total_byte_size);
+        case 3: return read_field(r, f, out.num_rows, num_rows);
+        case 4: return read_optional(r, f, out.sorting_columns, [&] { out.__isset.sorting_columns = true; });
+        case 5: return read_optional(r, f, out.file_offset, [&] { out.__isset.file_offset = true; });
+        case 6: return read_optional(r, f, out.total_compressed_size, [&] { out.__isset.total_compressed_size = true; });
+        case 7: return read_optional(r, f, out.ordinal, [&] { out.__isset.ordinal = true; });
+        default: return false;
+        }
+    });
+    require(columns, "RowGroup.columns");
+    require(total_byte_size, "RowGroup.total_byte_size");
+    require(num_rows, "RowGroup.num_rows");
+}
+
+void read(reader& r, format::RowGroup& out) {
+    read_row_group(r, out, nullptr);
+}
+
+void read(reader& r, format::TimeUnit& out) {
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_empty(r, f, out.MILLIS, [&] { out.__isset.MILLIS = true; });
+        case 2: return read_empty(r, f, out.MICROS, [&] { out.__isset.MICROS = true; });
+        case 3: return read_empty(r, f, out.NANOS, [&] { out.__isset.NANOS = true; });
+        default: return false;
+        }
+    });
+}
+
+void read(reader& r, format::DecimalType& out) {
+    bool scale = false;
+    bool precision = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.scale, scale);
+        case 2: return read_field(r, f, out.precision, precision);
+        default: return false;
+        }
+    });
+    require(scale, "DecimalType.scale");
+    require(precision, "DecimalType.precision");
+}
+
+template <typename TimeOrTimestamp>
+void read_time(reader& r, TimeOrTimestamp& out) {
+    bool is_adjusted_to_utc = false;
+    bool unit = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.isAdjustedToUTC, is_adjusted_to_utc);
+        case 2: return read_field(r, f, out.unit, unit);
+        default: return false;
+        }
+    });
+    require(is_adjusted_to_utc, "isAdjustedToUTC");
+    require(unit, "unit");
+}
+
+void read(reader& r, format::TimeType& out) {
+    read_time(r, out);
+}
+
+void read(reader& r, format::TimestampType& out) {
+    read_time(r, out);
+}
+
+void read(reader& r, format::IntType& out) {
+    bool bit_width = false;
+    bool is_signed = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.bitWidth, bit_width);
+        case 2: return read_field(r, f, out.isSigned, is_signed);
+        default: return false;
+        }
+    });
+    require(bit_width, "IntType.bitWidth");
+    require(is_signed, "IntType.isSigned");
+}
+
+void read(reader& r, format::LogicalType& out) {
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_empty(r, f, out.STRING, [&] { out.__isset.STRING = true; });
+        case 2: return read_empty(r, f, out.MAP, [&] { out.__isset.MAP = true; });
+        case 3: return read_empty(r, f, out.LIST, [&] { out.__isset.LIST = true; });
+        case 4: return read_empty(r, f, out.ENUM, [&] { out.__isset.ENUM = true; });
+        case 5: return read_optional(r, f, out.DECIMAL, [&] { out.__isset.DECIMAL = true; });
+        case 6: return read_empty(r, f, out.DATE, [&] { out.__isset.DATE = true; });
+        case 7: return read_optional(r, f, out.TIME, [&] { out.__isset.TIME = true; });
+        case 8: return read_optional(r, f, out.TIMESTAMP, [&] { out.__isset.TIMESTAMP = true; });
+        case 10: return read_optional(r, f, out.INTEGER, [&] { out.__isset.INTEGER = true; });
+        case 11: return read_empty(r, f, out.UNKNOWN, [&] { out.__isset.UNKNOWN = true; });
+        case 12: return read_empty(r, f, out.JSON, [&] { out.__isset.JSON = true; });
+        case 13: return read_empty(r, f, out.BSON, [&] { out.__isset.BSON = true; });
+        case 14: return read_empty(r, f, out.UUID, [&] { out.__isset.UUID = true; });
+        default: return false;
+        }
+    });
+}
+
+void read(reader& r, format::SchemaElement& out) {
+    bool name = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_optional(r, f, out.type, [&] { out.__isset.type = true; });
+        case 2: return read_optional(r, f, out.type_length, [&] { out.__isset.type_length = true; });
+        case 3: return read_optional(r, f, out.repetition_type, [&] { out.__isset.repetition_type = true; });
+        case 4: return read_field(r, f, out.name, name);
+        case 5: return read_optional(r, f, out.num_children, [&] { out.__isset.num_children = true; });
+        case 6: return read_optional(r, f, out.converted_type, [&] { out.__isset.converted_type = true; });
+        case 7: return read_optional(r, f, out.scale, [&] { out.__isset.scale = true; });
+        case 8: return read_optional(r, f, out.precision, [&] { out.__isset.precision = true; });
+        case 9: return read_optional(r, f, out.field_id, [&] { out.__isset.field_id = true; });
+        case 10: return read_optional(r, f, out.logicalType, [&] { out.__isset.logicalType = true; });
+        default: return false;
+        }
+    });
+    require(name, "SchemaElement.name");
+}
+
+void read(reader& r, format::ColumnOrder& out) {
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_empty(r, f, out.TYPE_ORDER, [&] { out.__isset.TYPE_ORDER = true; });
+        default: return false;
+        }
+    });
+}
+
+// Encryption is rare, so its structures are read by the generated code.
+template <typename T>
+void read_generated(reader& r, T& out) {
+    const byte* start = r.position();
+    r.skip(STRUCT);
+    deserialize_thrift_msg(start, r.position() - start, out);
+}
+
+void read(reader& r, format::EncryptionAlgorithm& out) {
+    read_generated(r, out);
+}
+
+void read(reader& r, format::ColumnCryptoMetaData& out) {
+    read_generated(r, out);
+}
+
+void index_row_groups(reader& r, std::vector<format::RowGroup>& out, std::vector<std::vector<uint32_t>>& offsets) {
+    auto [type, size] = r.read_list_header();
+    out.clear();
+    offsets.clear();
+    if (type != STRUCT) {
+        for (uint32_t i = 0; i < size; ++i) {
+            r.skip_element(type);
+        }
+        return;
+    }
+    out.resize(size);
+    offsets.resize(size);
+    for (uint32_t i = 0; i < size; ++i) {
+        read_row_group(r, out[i], &offsets[i]);
+    }
+}
+
+// If column_chunk_offsets is given, the columns of row groups are indexed instead of read.
+void read_file_metadata(reader& r, format::FileMetaData& out,
+        std::vector<std::vector<uint32_t>>* column_chunk_offsets) {
+    bool version = false;
+    bool schema = false;
+    bool num_rows = false;
+    bool row_groups = false;
+    r.read_struct([&] (const field& f) {
+        switch (f.id) {
+        case 1: return read_field(r, f, out.version, version);
+        case 2: return read_field(r, f, out.schema, schema);
+        case 3: return read_field(r, f, out.num_rows, num_rows);
+        case 4:
+            if (!column_chunk_offsets) {
+                return read_field(r, f, out.row_groups, row_groups);
+            } else if (f.type != LIST) {
+                return false;
+            }
+            index_row_groups(r, out.row_groups, *column_chunk_offsets);
+            row_groups = true;
+            return true;
+        case 5: return read_optional(r, f, out.key_value_metadata, [&] { out.__isset.key_value_metadata = true; });
+        case 6: return read_optional(r, f, out.created_by, [&] { out.__isset.created_by = true; });
+        case 7: return read_optional(r, f, out.column_orders, [&] { out.__isset.column_orders = true; });
+        case 8: return read_optional(r, f, out.encryption_algorithm, [&] { out.__isset.encryption_algorithm = true; });
+        case 9: return read_optional(r, f, out.footer_signing_key_metadata, [&] { out.__isset.footer_signing_key_metadata = true; });
+        default: return false;
+        }
+    });
+    require(version, "FileMetaData.version");
+    require(schema, "FileMetaData.schema");
+    require(num_rows, "FileMetaData.num_rows");
+    require(row_groups, "FileMetaData.row_groups");
+}
+
+void read(reader& r, format::FileMetaData& out) {
+    read_file_metadata(r, out, nullptr);
+}
+
+template <typename T>
+size_t decode_message(bytes_view serialized, T& out) {
+    out = T{};
+    reader r{serialized};
+    read(r, out);
+    return r.bytes_read();
+}
+
+} // namespace
+
+size_t decode(bytes_view serialized, format::PageHeader& out) {
+    return decode_message(serialized, out);
+}
+
+size_t decode(bytes_view serialized, format::ColumnMetaData& out) {
+    return decode_message(serialized, out);
+}
+
+size_t decode(bytes_view serialized, format::ColumnChunk& out) {
+    return decode_message(serialized, out);
+}
+
+size_t decode(bytes_view serialized, format::FileMetaData& out) {
+    return decode_message(serialized, out);
+}
+
+size_t decode(bytes_view serialized, lazy_file_metadata& out) {
+    out = lazy_file_metadata{};
+    reader r{serialized};
+    read_file_metadata(r, out.metadata, &out.column_chunk_offsets);
+    return r.bytes_read();
+}
+
+} // namespace parquet4seastar::thrift_compact
@@ -0,0 +1,75 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#define BOOST_TEST_MODULE parquet
+
+#include <parquet4seastar/bloom_filter.hh>
+#include <boost/test/included/unit_test.hpp>
+#include <cstring>
+
+namespace parquet4seastar {
+
+namespace {
+
+bytes_view to_bv(const char* str) {
+    return {reinterpret_cast<const uint8_t*>(str), std::strlen(str)};
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(xxhash64_reference_values) {
+    BOOST_CHECK_EQUAL(xxhash64(to_bv("")), 0xef46db3751d8e999ULL);
+    BOOST_CHECK_EQUAL(xxhash64(to_bv("a")), 0xd24ec4f1a98c6e5bULL);
+    BOOST_CHECK_EQUAL(xxhash64(to_bv("abc")), 0x44bc2cf5ad770999ULL);
+    BOOST_CHECK_EQUAL(xxhash64(to_bv("Nobody inspects the spammish repetition")), 0xfbcea83c8a378bf1ULL);
+}
+
+BOOST_AUTO_TEST_CASE(bloom_filter_sizes) {
+    BOOST_CHECK_EQUAL(bloom_filter::optimal_num_bytes(0, 0.01), bloom_filter::MIN_BYTES);
+    BOOST_CHECK_EQUAL(bloom_filter::optimal_num_bytes(1ULL << 40, 0.01), bloom_filter::MAX_BYTES);
+    size_t size = bloom_filter::optimal_num_bytes(100000, 0.01);
+    BOOST_CHECK_EQUAL(size & (size - 1), 0);
+    BOOST_CHECK_GE(size, 100000);
+    BOOST_CHECK_EQUAL(bloom_filter(1000).num_bytes(), 1024);
+}
+
+BOOST_AUTO_TEST_CASE(bloom_filter_false_positives) {
+    constexpr int64_t ndv = 100000;
+    constexpr double fpp = 0.01;
+    bloom_filter bf{bloom_filter_options{ndv, fpp}};
+    for (int64_t i = 0; i < ndv; ++i) {
+        bf.insert(bloom_filter_hash(i));
+    }
+    for (int64_t i = 0; i < ndv; ++i) {
+        BOOST_REQUIRE(bf.find(bloom_filter_hash(i)));
+    }
+    int64_t false_positives = 0;
+    for (int64_t i = ndv; i < 2 * ndv; ++i) {
+        false_positives += bf.find(bloom_filter_hash(i));
+    }
+    BOOST_CHECK_LT(false_positives, ndv * fpp * 2);
+
+    bf.clear();
+    BOOST_CHECK(!bf.find(bloom_filter_hash(int64_t(0))));
+    BOOST_CHECK_EQUAL(bf.header().numBytes, bf.num_bytes());
+}
+
+} // namespace parquet4seastar
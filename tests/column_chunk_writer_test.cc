@@ -38,6 +38,62 @@ seastar::temporary_buffer<uint8_t> operator ""_tb(const char* str, size_t len) n
 
 constexpr std::string_view test_file_name = "/tmp/parquet4seastar_column_chunk_writer_test.bin";
 
+template <format::Type::type ParquetType>
+struct roundtrip_result {
+    seastar::lw_shared_ptr<format::ColumnMetaData> metadata;
+    std::vector<int32_t> def;
+    std::vector<int32_t> rep;
+    std::vector<typename column_chunk_reader<ParquetType>::output_type> values;
+    // The number of levels returned by each read_batch(). A batch doesn't span pages.
+    std::vector<size_t> batches;
+};
+
+// Writes a column chunk to test_file_name with write(), then reads all of it back.
+// Must be called in a seastar thread.
+template <format::Type::type ParquetType, typename Write>
+roundtrip_result<ParquetType> write_then_read(
+        const writer_options& options, const column_chunk_writer_options& chunk_options, Write write) {
+    roundtrip_result<ParquetType> result;
+
+    // Write
+    seastar::file output_file = seastar::open_file_dma(
+            test_file_name.data(), seastar::open_flags::wo | seastar::open_flags::truncate | seastar::open_flags::create).get0();
+    seastar::output_stream<char> output = seastar::make_file_output_stream(output_file);
+    column_chunk_writer<ParquetType> w = make_column_chunk_writer<ParquetType>(options, chunk_options);
+    write(w);
+    result.metadata = w.flush_chunk(output).get0();
+    output.flush().get();
+    output.close().get();
+    w.close().get();
+
+    // Read
+    seastar::file input_file = seastar::open_file_dma(test_file_name.data(), seastar::open_flags::ro).get0();
+    column_chunk_reader<ParquetType> r{
+        page_reader{seastar::make_file_input_stream(std::move(input_file))},
+        result.metadata->codec,
+        options.def_level,
+        options.rep_level,
+        std::optional<uint32_t>()};
+    constexpr size_t batch_size = 100000;
+    while (true) {
+        size_t levels = result.def.size();
+        size_t values = result.values.size();
+        result.def.resize(levels + batch_size);
+        result.rep.resize(levels + batch_size);
+        result.values.resize(values + batch_size);
+        size_t n_read = r.read_batch(batch_size, &result.def[levels], &result.rep[levels], &result.values[values]).get0();
+        result.def.resize(levels + n_read);
+        result.rep.resize(levels + n_read);
+        result.values.resize(values + std::count(
+                result.def.begin() + levels, result.def.end(), static_cast<int32_t>(options.def_level)));
+        if (n_read == 0) {
+            break;
+        }
+        result.batches.push_back(n_read);
+    }
+    return result;
+}
+
 SEASTAR_TEST_CASE(column_roundtrip) {
     return seastar::async([] {
         seastar::file output_file = seastar::open_file_dma(
@@ -108,4 +164,278 @@ SEASTAR_TEST_CASE(column_roundtrip) {
     });
 }
 
+SEASTAR_TEST_CASE(column_roundtrip_background_compression) {
+    return seastar::async([] {
+        constexpr format::Type::type INT32 = format::Type::INT32;
+        column_chunk_writer_options options;
+        options.compression_group = seastar::create_scheduling_group("compression", 100).get0();
+        options.max_pages_in_compression = 2;
+        constexpr int32_t n_pages = 10;
+        constexpr int32_t values_per_page = 100000;
+        auto result = write_then_read<INT32>(
+                writer_options{0, 0, format::Encoding::PLAIN, format::CompressionCodec::GZIP}, options,
+                [&] (column_chunk_writer<INT32>& w) {
+            for (int32_t page = 0; page < n_pages; ++page) {
+                for (int32_t i = 0; i < values_per_page; ++i) {
+                    w.put(0, 0, page * values_per_page + i);
+                }
+                w.flush_page();
+                w.backpressure().get();
+                // Pages in compression are counted with their uncompressed size, the rest with the compressed one.
+                BOOST_CHECK_LE(w.buffered_size(), (page + 1) * values_per_page * sizeof(int32_t));
+            }
+        });
+
+        BOOST_CHECK_EQUAL(result.metadata->num_values, n_pages * values_per_page);
+        BOOST_CHECK_EQUAL(result.metadata->codec, format::CompressionCodec::GZIP);
+        BOOST_REQUIRE_EQUAL(result.values.size(), n_pages * values_per_page);
+        for (int32_t i = 0; i < n_pages * values_per_page; ++i) {
+            BOOST_REQUIRE_EQUAL(result.values[i], i);
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(column_roundtrip_background_codec_selection) {
+    return seastar::async([] {
+        constexpr format::Type::type INT32 = format::Type::INT32;
+        column_chunk_writer_options options;
+        options.compression_group = seastar::create_scheduling_group("compression", 100).get0();
+        options.max_pages_in_compression = 2;
+        options.auto_compression = codec_selection_options{};
+        options.auto_compression->candidates = {format::CompressionCodec::SNAPPY, format::CompressionCodec::GZIP};
+        constexpr int32_t n_pages = 6;
+        constexpr int32_t values_per_page = 10000;
+        auto result = write_then_read<INT32>(
+                writer_options{0, 0, format::Encoding::PLAIN, format::CompressionCodec::UNCOMPRESSED}, options,
+                [&] (column_chunk_writer<INT32>& w) {
+            for (int32_t page = 0; page < n_pages; ++page) {
+                for (int32_t i = 0; i < values_per_page; ++i) {
+                    w.put(0, 0, page * values_per_page + i);
+                }
+                // The pages after the samples wait for the codec, which is selected in the background.
+                w.flush_page();
+            }
+        });
+
+        BOOST_CHECK_EQUAL(result.metadata->num_values, n_pages * values_per_page);
+        BOOST_CHECK_NE(result.metadata->codec, format::CompressionCodec::UNCOMPRESSED);
+        BOOST_CHECK_LT(result.metadata->total_compressed_size, result.metadata->total_uncompressed_size);
+        BOOST_REQUIRE_EQUAL(result.values.size(), n_pages * values_per_page);
+        for (int32_t i = 0; i < n_pages * values_per_page; ++i) {
+            BOOST_REQUIRE_EQUAL(result.values[i], i);
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(codec_selection_is_per_chunk) {
+    return seastar::async([] {
+        seastar::file output_file = seastar::open_file_dma(
+                test_file_name.data(), seastar::open_flags::wo | seastar::open_flags::truncate | seastar::open_flags::create).get0();
+        seastar::output_stream<char> output = seastar::make_file_output_stream(output_file);
+        constexpr format::Type::type INT32 = format::Type::INT32;
+        column_chunk_writer_options options;
+        options.auto_compression = codec_selection_options{};
+        options.auto_compression->candidates = {format::CompressionCodec::SNAPPY, format::CompressionCodec::GZIP};
+        column_chunk_writer<INT32> w = make_column_chunk_writer<INT32>(
+                writer_options{0, 0, format::Encoding::PLAIN, format::CompressionCodec::UNCOMPRESSED}, options);
+        for (int32_t i = 0; i < 10000; ++i) {
+            w.put(0, 0, i);
+        }
+        BOOST_CHECK_NE(w.flush_chunk(output).get0()->codec, format::CompressionCodec::UNCOMPRESSED);
+        // The codec selected for the previous chunk isn't kept. A chunk without data pages
+        // uses the compressor given to the writer.
+        BOOST_CHECK_EQUAL(w.flush_chunk(output).get0()->codec, format::CompressionCodec::UNCOMPRESSED);
+        output.close().get();
+    });
+}
+
+SEASTAR_TEST_CASE(column_roundtrip_spill) {
+    return seastar::async([] {
+        constexpr format::Type::type INT32 = format::Type::INT32;
+        column_chunk_writer_options options;
+        options.spill_directory = "/tmp";
+        constexpr int32_t n_pages = 10;
+        constexpr int32_t values_per_page = 10000;
+        constexpr int32_t dict_size = 1000;
+        auto result = write_then_read<INT32>(
+                writer_options{0, 0, format::Encoding::RLE_DICTIONARY, format::CompressionCodec::SNAPPY}, options,
+                [&] (column_chunk_writer<INT32>& w) {
+            for (int32_t page = 0; page < n_pages; ++page) {
+                for (int32_t i = 0; i < values_per_page; ++i) {
+                    w.put(0, 0, (page * values_per_page + i) % dict_size);
+                }
+                w.flush_page();
+                if (page % 4 == 3) {
+                    w.spill().get();
+                    BOOST_CHECK_EQUAL(w.spillable_size(), 0);
+                }
+            }
+        });
+
+        BOOST_CHECK_EQUAL(result.metadata->num_values, n_pages * values_per_page);
+        BOOST_REQUIRE_EQUAL(result.values.size(), n_pages * values_per_page);
+        for (int32_t i = 0; i < n_pages * values_per_page; ++i) {
+            BOOST_REQUIRE_EQUAL(result.values[i], i % dict_size);
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(column_roundtrip_put_batch) {
+    return seastar::async([] {
+        // Lists of lengths 0, 1, 2, 3, 0, 1, ... with every third element null.
+        // The lists of even rows are null instead of empty.
+        std::vector<int32_t> def;
+        std::vector<int32_t> rep;
+        std::vector<int64_t> spaced_values;
+        std::vector<uint8_t> valid_bits;
+        int64_t next_value = 0;
+        constexpr size_t n_rows = 10000;
+        for (size_t row = 0; row < n_rows; ++row) {
+            size_t len = row % 4;
+            if (len == 0) {
+                def.push_back(row % 2 ? 1 : 0);
+                rep.push_back(0);
+                spaced_values.push_back(0);
+            }
+            for (size_t i = 0; i < len; ++i) {
+                bool null = (next_value % 3) == 0;
+                def.push_back(null ? 1 : 2);
+                rep.push_back(i == 0 ? 0 : 1);
+                spaced_values.push_back(next_value++);
+            }
+        }
+        valid_bits.resize((def.size() + 7) / 8);
+        std::vector<int64_t> values;
+        for (size_t i = 0; i < def.size(); ++i) {
+            if (def[i] == 2) {
+                valid_bits[i / 8] |= 1 << (i % 8);
+                values.push_back(spaced_values[i]);
+            }
+        }
+
+        constexpr format::Type::type INT64 = format::Type::INT64;
+        column_chunk_writer_options options;
+        options.max_rows_per_page = 100;
+        // The first half with put_batch, the second with put_batch_spaced.
+        // The batches begin in the middle of rows.
+        size_t half = def.size() / 2 + 1;
+        size_t values_in_first_half = std::count(def.begin(), def.begin() + half, 2);
+        auto result = write_then_read<INT64>(
+                writer_options{2, 1, format::Encoding::PLAIN, format::CompressionCodec::SNAPPY}, options,
+                [&] (column_chunk_writer<INT64>& w) {
+            for (size_t i = 0; i < half; i += 777) {
+                size_t n = std::min<size_t>(777, half - i);
+                size_t values_before = std::count(def.begin(), def.begin() + i, 2);
+                w.put_batch(n, &def[i], &rep[i], &values[values_before]);
+            }
+            w.put_batch_spaced(def.size() - half, &def[half], &rep[half], valid_bits.data(), half, &spaced_values[half]);
+            BOOST_CHECK_EQUAL(w.rows_written(), n_rows);
+        });
+
+        BOOST_CHECK_EQUAL(result.metadata->num_values, def.size());
+        BOOST_CHECK_EQUAL(result.metadata->statistics.null_count, def.size() - values.size());
+        BOOST_CHECK_GT(values_in_first_half, 0);
+        // Every page begins on a row boundary and has at most 100 rows.
+        size_t levels = 0;
+        for (size_t n_read : result.batches) {
+            BOOST_REQUIRE_EQUAL(result.rep[levels], 0);
+            BOOST_REQUIRE_LE(std::count(&result.rep[levels], &result.rep[levels] + n_read, 0), 100);
+            levels += n_read;
+        }
+        BOOST_CHECK_GE(result.batches.size(), n_rows / 100);
+        BOOST_CHECK(result.def == def);
+        BOOST_CHECK(result.rep == rep);
+        BOOST_CHECK(result.values == values);
+    });
+}
+
+SEASTAR_TEST_CASE(column_roundtrip_page_v2) {
+    return seastar::async([] {
+        constexpr format::Type::type INT32 = format::Type::INT32;
+        column_chunk_writer_options options;
+        options.data_page_v2 = true;
+        constexpr int32_t values_per_page = 10000;
+        std::vector<int32_t> def;
+        std::vector<int32_t> values;
+        auto result = write_then_read<INT32>(
+                writer_options{1, 0, format::Encoding::PLAIN, format::CompressionCodec::SNAPPY}, options,
+                [&] (column_chunk_writer<INT32>& w) {
+            // The first page compresses well, the second one (noise) doesn't.
+            uint32_t x = 1;
+            for (int32_t page = 0; page < 2; ++page) {
+                for (int32_t i = 0; i < values_per_page; ++i) {
+                    x = x * 1103515245 + 12345;
+                    int32_t value = page == 0 ? 42 : static_cast<int32_t>(x);
+                    def.push_back(i % 5 != 0);
+                    if (def.back()) {
+                        values.push_back(value);
+                    }
+                    w.put(def.back(), 0, value);
+                }
+                w.flush_page();
+            }
+        });
+
+        BOOST_CHECK_EQUAL(result.metadata->num_values, def.size());
+        BOOST_CHECK(result.def == def);
+        BOOST_CHECK(result.values == values);
+
+        // Headers
+        seastar::file input_file = seastar::open_file_dma(test_file_name.data(), seastar::open_flags::ro).get0();
+        page_reader pages{seastar::make_file_input_stream(input_file)};
+        for (bool expect_compressed : {true, false}) {
+            std::optional<page> p = pages.next_page().get0();
+            BOOST_REQUIRE(p);
+            BOOST_REQUIRE_EQUAL(p->header->type, format::PageType::DATA_PAGE_V2);
+            const format::DataPageHeaderV2& header = p->header->data_page_header_v2;
+            BOOST_CHECK_EQUAL(header.num_values, values_per_page);
+            BOOST_CHECK_EQUAL(header.num_rows, values_per_page);
+            BOOST_CHECK_EQUAL(header.num_nulls, values_per_page / 5);
+            BOOST_CHECK_EQUAL(header.repetition_levels_byte_length, 0);
+            BOOST_CHECK_GT(header.definition_levels_byte_length, 0);
+            BOOST_CHECK_EQUAL(header.is_compressed, expect_compressed);
+            BOOST_CHECK_EQUAL(p->header->compressed_page_size < p->header->uncompressed_page_size, expect_compressed);
+        }
+        BOOST_CHECK(!pages.next_page().get0());
+    });
+}
+
+SEASTAR_TEST_CASE(page_v2_negative_levels_length) {
+    return seastar::async([] {
+        format::DataPageHeaderV2 data_page_header;
+        data_page_header.__set_num_values(1);
+        data_page_header.__set_num_nulls(0);
+        data_page_header.__set_num_rows(1);
+        data_page_header.__set_encoding(format::Encoding::PLAIN);
+        data_page_header.__set_definition_levels_byte_length(-1);
+        data_page_header.__set_repetition_levels_byte_length(0);
+        format::PageHeader header;
+        header.__set_type(format::PageType::DATA_PAGE_V2);
+        header.__set_uncompressed_page_size(4);
+        header.__set_compressed_page_size(4);
+        header.__set_data_page_header_v2(data_page_header);
+
+        seastar::file output_file = seastar::open_file_dma(
+                test_file_name.data(), seastar::open_flags::wo | seastar::open_flags::truncate | seastar::open_flags::create).get0();
+        seastar::output_stream<char> output = seastar::make_file_output_stream(output_file);
+        thrift_serializer serializer;
+        bytes_view serialized_header = serializer.serialize(header);
+        output.write(reinterpret_cast<const char*>(serialized_header.data()), serialized_header.size()).get();
+        output.write("\x2a\0\0\0", 4).get();
+        output.close().get();
+
+        seastar::file input_file = seastar::open_file_dma(test_file_name.data(), seastar::open_flags::ro).get0();
+        column_chunk_reader<format::Type::INT32> r{
+            page_reader{seastar::make_file_input_stream(std::move(input_file))},
+            format::CompressionCodec::UNCOMPRESSED,
+            1,
+            0,
+            std::optional<uint32_t>()};
+        int32_t def;
+        int32_t rep;
+        int32_t val;
+        BOOST_CHECK_THROW(r.read_batch(1, &def, &rep, &val).get0(), parquet_exception);
+    });
+}
+
 } // namespace parquet4seastar
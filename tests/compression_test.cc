@@ -60,4 +60,41 @@ BOOST_AUTO_TEST_CASE(compression_snappy) {
     test_compression_overflow(format::CompressionCodec::SNAPPY);
 }
 
+BOOST_AUTO_TEST_CASE(codec_selection) {
+    codec_selection_options options;
+    options.sample_pages = 2;
+    options.bytes_per_cpu_second = 0; // Only the compression ratio matters.
+    codec_selector selector{options};
+
+    // Compressible data.
+    bytes zeros(70000, 0);
+    selector.sample(zeros);
+    BOOST_CHECK(!selector.enough_samples());
+    selector.sample(zeros);
+    BOOST_CHECK(selector.enough_samples());
+    codec_selector::selection selection = selector.select();
+    BOOST_CHECK_EQUAL(selection.codec->type(), format::CompressionCodec::GZIP);
+    BOOST_REQUIRE_EQUAL(selection.compressed_samples.size(), 2);
+    for (const bytes& compressed : selection.compressed_samples) {
+        BOOST_CHECK(selection.codec->decompress(compressed, bytes(zeros.size(), 0)) == zeros);
+    }
+
+    // Incompressible data.
+    bytes noise;
+    uint32_t x = 1;
+    for (size_t i = 0; i < 70000; ++i) {
+        x = x * 1103515245 + 12345;
+        noise.push_back(static_cast<byte>(x >> 24));
+    }
+    BOOST_CHECK_EQUAL(selector.samples(), 0);
+    selector.sample(noise);
+    selection = selector.select();
+    BOOST_CHECK_EQUAL(selection.codec->type(), format::CompressionCodec::UNCOMPRESSED);
+    BOOST_CHECK(selection.compressed_samples.at(0) == noise);
+
+    // Nothing sampled.
+    selection = selector.select();
+    BOOST_CHECK(!selection.codec);
+}
+
 } // namespace parquet4seastar
@@ -25,6 +25,9 @@
 #include <boost/test/included/unit_test.hpp>
 #include <vector>
 #include <array>
+#include <cstring>
+#include <limits>
+#include <string>
 
 BOOST_AUTO_TEST_CASE(dict_encoder_trivial_happy) {
     using namespace parquet4seastar;
@@ -151,3 +154,102 @@ BOOST_AUTO_TEST_CASE(dict_encoder_byte_array_happy) {
         BOOST_CHECK_EQUAL_COLLECTIONS(std::begin(dict), std::end(dict), std::begin(expected_dict), std::end(expected_dict));
     }
 }
+
+BOOST_AUTO_TEST_CASE(dict_encoder_many_keys) {
+    using namespace parquet4seastar;
+    auto encoder = make_value_encoder<format::Type::BYTE_ARRAY>(format::Encoding::RLE_DICTIONARY);
+    constexpr uint32_t n_keys = 10000;
+    std::vector<std::string> keys;
+    for (uint32_t i = 0; i < n_keys; ++i) {
+        keys.push_back("key" + std::to_string(i * 7919));
+    }
+    std::vector<bytes_view> input;
+    std::vector<uint32_t> expected;
+    for (uint32_t round = 0; round < 2; ++round) {
+        for (uint32_t i = 0; i < n_keys; ++i) {
+            const std::string& key = keys[i];
+            input.push_back(bytes_view{reinterpret_cast<const uint8_t*>(key.data()), key.size()});
+            expected.push_back(i);
+        }
+    }
+    encoder->put_batch(input.data(), input.size());
+    std::vector<uint8_t> out(encoder->max_encoded_size());
+    auto [n_written, encoding] = encoder->flush(out.data());
+    BOOST_CHECK_EQUAL(encoding, format::Encoding::RLE_DICTIONARY);
+
+    RleDecoder decoder{out.data() + 1, static_cast<int>(n_written - 1), out[0]};
+    std::vector<uint32_t> decoded(expected.size());
+    BOOST_CHECK_EQUAL(decoder.GetBatch(decoded.data(), decoded.size()), expected.size());
+    BOOST_CHECK(decoded == expected);
+
+    bytes expected_dict;
+    for (const std::string& key : keys) {
+        append_raw_bytes<uint32_t>(expected_dict, key.size());
+        expected_dict.insert(expected_dict.end(), key.begin(), key.end());
+    }
+    BOOST_CHECK(*encoder->view_dict() == expected_dict);
+    BOOST_CHECK_EQUAL(encoder->cardinality(), n_keys);
+}
+
+BOOST_AUTO_TEST_CASE(dict_encoder_bitwise_equality) {
+    using namespace parquet4seastar;
+    auto encoder = make_value_encoder<format::Type::DOUBLE>(format::Encoding::RLE_DICTIONARY);
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    double input[] = {nan, 0.0, nan, -0.0, 0.0};
+    encoder->put_batch(std::data(input), std::size(input));
+    // NaNs share an entry, but the zeros don't.
+    BOOST_CHECK_EQUAL(encoder->cardinality(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(dict_encoder_size_limit) {
+    using namespace parquet4seastar;
+    // Room for 16 INT32 entries.
+    auto encoder = make_value_encoder<format::Type::INT32>(format::Encoding::RLE_DICTIONARY, 64);
+    std::vector<int32_t> input;
+    for (int32_t i = 0; i < 1000; ++i) {
+        input.push_back(i % 10);
+    }
+    encoder->put_batch(input.data(), input.size());
+    std::vector<uint8_t> out(encoder->max_encoded_size());
+    BOOST_CHECK_EQUAL(encoder->flush(out.data()).encoding, format::Encoding::RLE_DICTIONARY);
+
+    // The limit is exceeded in the middle of the page, so the whole page is written plain,
+    // and the dictionary keeps only the entries of the first page.
+    input.clear();
+    for (int32_t i = 0; i < 100; ++i) {
+        input.push_back(i);
+    }
+    encoder->put_batch(input.data(), input.size());
+    BOOST_CHECK_EQUAL(encoder->cardinality(), 10);
+    out.resize(encoder->max_encoded_size());
+    auto [n_written, encoding] = encoder->flush(out.data());
+    BOOST_CHECK_EQUAL(encoding, format::Encoding::PLAIN);
+    BOOST_REQUIRE_EQUAL(n_written, input.size() * sizeof(int32_t));
+    BOOST_CHECK(std::memcmp(out.data(), input.data(), n_written) == 0);
+    BOOST_CHECK_EQUAL(encoder->view_dict()->size(), 10 * sizeof(int32_t));
+
+    // The next column chunk starts with an empty dictionary.
+    encoder->reset_dict();
+    int32_t next_chunk[] = {7, 8, 7};
+    encoder->put_batch(std::data(next_chunk), std::size(next_chunk));
+    out.resize(encoder->max_encoded_size());
+    BOOST_CHECK_EQUAL(encoder->flush(out.data()).encoding, format::Encoding::RLE_DICTIONARY);
+    BOOST_CHECK_EQUAL(encoder->cardinality(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(dict_encoder_no_benefit) {
+    using namespace parquet4seastar;
+    auto encoder = make_value_encoder<format::Type::INT64>(format::Encoding::RLE_DICTIONARY);
+    std::vector<int64_t> input;
+    for (int64_t i = 0; i < 1000; ++i) {
+        input.push_back(i);
+    }
+    // Unique values: the dictionary is as big as plain pages, so it's dropped after the first page.
+    encoder->put_batch(input.data(), input.size());
+    std::vector<uint8_t> out(encoder->max_encoded_size());
+    BOOST_CHECK_EQUAL(encoder->flush(out.data()).encoding, format::Encoding::RLE_DICTIONARY);
+    encoder->put_batch(input.data(), input.size());
+    out.resize(encoder->max_encoded_size());
+    BOOST_CHECK_EQUAL(encoder->flush(out.data()).encoding, format::Encoding::PLAIN);
+    BOOST_CHECK_EQUAL(encoder->cardinality(), input.size());
+}
@@ -129,3 +129,234 @@ INSERT INTO "parquet"("row_number", "Map", "List") VALUES(1, {'key1': 1, 'key2':
         BOOST_CHECK_EQUAL(ss.str(), output);
     });
 }
+
+SEASTAR_TEST_CASE(automatic_flushes) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        // Write
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            return schema{vec<node>(
+                primitive_node{
+                    "Value",
+                    false,
+                    logical_type::INT64{},
+                    {},
+                    format::Encoding::PLAIN,
+                    format::CompressionCodec::UNCOMPRESSED}
+            )};
+        }();
+
+        file_writer_options options;
+        options.column_options.max_rows_per_page = 1000;
+        options.target_row_group_size = 64 * 1024;
+        std::unique_ptr<file_writer> fw = file_writer::open(test_file_name, writer_schema, options).get0();
+        auto& value = fw->column<format::Type::INT64>(0);
+        constexpr int64_t n_rows = 100000;
+        for (int64_t i = 0; i < n_rows; ++i) {
+            value.put(0, 0, i);
+            fw->maybe_flush_row_group().get();
+        }
+        fw->close().get0();
+
+        // Read
+        file_reader fr = file_reader::open(test_file_name).get0();
+        const format::FileMetaData& metadata = fr.metadata();
+        BOOST_CHECK_EQUAL(metadata.num_rows, n_rows);
+        BOOST_CHECK_GT(metadata.row_groups.size(), 1);
+        int64_t expected = 0;
+        for (size_t rg = 0; rg < metadata.row_groups.size(); ++rg) {
+            BOOST_CHECK_GT(metadata.row_groups[rg].num_rows, 0);
+            BOOST_CHECK_LE(metadata.row_groups[rg].columns[0].meta_data.total_compressed_size, 2 * 64 * 1024);
+            auto r = fr.open_column_chunk_reader<format::Type::INT64>(rg, 0).get0();
+            std::vector<int32_t> def(n_rows);
+            std::vector<int32_t> rep(n_rows);
+            std::vector<int64_t> val(n_rows);
+            while (size_t n_read = r.read_batch(n_rows, def.data(), rep.data(), val.data()).get0()) {
+                // A batch never crosses a page boundary.
+                BOOST_REQUIRE_LE(n_read, 1000);
+                for (size_t i = 0; i < n_read; ++i) {
+                    BOOST_REQUIRE_EQUAL(val[i], expected);
+                    ++expected;
+                }
+            }
+        }
+        BOOST_CHECK_EQUAL(expected, n_rows);
+
+        // The column chunks decoded on demand are the same as in the whole metadata.
+        BOOST_CHECK_EQUAL(fr.shallow_metadata().row_groups.size(), metadata.row_groups.size());
+        for (size_t rg = 0; rg < metadata.row_groups.size(); ++rg) {
+            BOOST_CHECK(fr.shallow_metadata().row_groups[rg].columns.empty());
+            BOOST_CHECK_EQUAL(fr.shallow_metadata().row_groups[rg].num_rows, metadata.row_groups[rg].num_rows);
+            BOOST_CHECK_EQUAL(fr.column_chunk_count(rg), 1);
+            BOOST_CHECK(fr.column_chunk(rg, 0) == metadata.row_groups[rg].columns[0]);
+        }
+        BOOST_CHECK_THROW(fr.column_chunk(0, 1), parquet_exception);
+
+        // Page index
+        const format::ColumnChunk& cc = metadata.row_groups[0].columns[0];
+        auto read_index = [&fr] (auto& index, int64_t offset, int32_t length) {
+            auto buf = fr.file().dma_read_exactly<char>(offset, length).get0();
+            deserialize_thrift_msg(reinterpret_cast<const byte*>(buf.get()), buf.size(), index);
+        };
+        format::ColumnIndex column_index;
+        read_index(column_index, cc.column_index_offset, cc.column_index_length);
+        format::OffsetIndex offset_index;
+        read_index(offset_index, cc.offset_index_offset, cc.offset_index_length);
+        BOOST_CHECK_EQUAL(column_index.boundary_order, format::BoundaryOrder::ASCENDING);
+        BOOST_REQUIRE_GT(offset_index.page_locations.size(), 1);
+        BOOST_CHECK_EQUAL(column_index.min_values.size(), offset_index.page_locations.size());
+        BOOST_CHECK_EQUAL(offset_index.page_locations[0].offset, cc.meta_data.data_page_offset);
+        for (size_t i = 0; i < offset_index.page_locations.size(); ++i) {
+            const format::PageLocation& location = offset_index.page_locations[i];
+            BOOST_CHECK_EQUAL(location.first_row_index, static_cast<int64_t>(i * 1000));
+            int64_t min;
+            std::memcpy(&min, column_index.min_values[i].data(), sizeof(min));
+            BOOST_CHECK_EQUAL(min, static_cast<int64_t>(i * 1000));
+            if (i > 0) {
+                const format::PageLocation& previous = offset_index.page_locations[i - 1];
+                BOOST_CHECK_EQUAL(location.offset, previous.offset + previous.compressed_page_size);
+            }
+        }
+        fr.close().get();
+    });
+}
+
+SEASTAR_TEST_CASE(output_options) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema;
+        writer_schema.fields.push_back(writer_schema::primitive_node{"Value", false, logical_type::INT64{}});
+
+        file_writer_options options;
+        options.output_stream_options.buffer_size = 4096;
+        options.output_stream_options.write_behind = 2;
+        options.expected_file_size = 16 * 1024 * 1024;
+        std::unique_ptr<file_writer> fw = file_writer::open(test_file_name, writer_schema, options).get0();
+        auto& value = fw->column<format::Type::INT64>(0);
+        constexpr int64_t n_rows = 10000;
+        for (int64_t i = 0; i < n_rows; ++i) {
+            value.put(0, 0, i);
+        }
+        fw->close().get0();
+
+        // Preallocation doesn't change the size of the file.
+        BOOST_CHECK_LT(seastar::file_size(test_file_name).get0(), *options.expected_file_size);
+
+        file_reader fr = file_reader::open(test_file_name).get0();
+        auto r = fr.open_column_chunk_reader<format::Type::INT64>(0, 0).get0();
+        std::vector<int32_t> def(n_rows);
+        std::vector<int32_t> rep(n_rows);
+        std::vector<int64_t> val(n_rows);
+        int64_t expected = 0;
+        while (size_t n_read = r.read_batch(n_rows, def.data(), rep.data(), val.data()).get0()) {
+            for (size_t i = 0; i < n_read; ++i) {
+                BOOST_REQUIRE_EQUAL(val[i], expected);
+                ++expected;
+            }
+        }
+        BOOST_CHECK_EQUAL(expected, n_rows);
+        fr.close().get();
+    });
+}
+
+SEASTAR_TEST_CASE(memory_budget) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema;
+        writer_schema.fields.push_back(writer_schema::primitive_node{"Value", false, logical_type::INT64{},
+                {}, format::Encoding::PLAIN, format::CompressionCodec::UNCOMPRESSED});
+
+        file_writer_options options;
+        options.memory_budget = 64 * 1024;
+        BOOST_CHECK_THROW(file_writer::open(test_file_name, writer_schema, options).get(), parquet_exception);
+
+        options.column_options.spill_directory = "/tmp";
+        options.column_options.max_rows_per_page = 1000;
+        std::unique_ptr<file_writer> fw = file_writer::open(test_file_name, writer_schema, options).get0();
+        auto& value = fw->column<format::Type::INT64>(0);
+        constexpr int64_t n_rows = 100000;
+        for (int64_t i = 0; i < n_rows; ++i) {
+            value.put(0, 0, i);
+            if (i % 1000 == 999) {
+                fw->maybe_flush_row_group().get();
+                // Only the current page can be above the budget.
+                BOOST_CHECK_LE(fw->buffered_size(), *options.memory_budget + 1000 * sizeof(int64_t));
+            }
+        }
+        fw->close().get0();
+
+        file_reader fr = file_reader::open(test_file_name).get0();
+        BOOST_REQUIRE_EQUAL(fr.metadata().row_groups.size(), 1);
+        auto r = fr.open_column_chunk_reader<format::Type::INT64>(0, 0).get0();
+        std::vector<int32_t> def(n_rows);
+        std::vector<int32_t> rep(n_rows);
+        std::vector<int64_t> val(n_rows);
+        int64_t expected = 0;
+        while (size_t n_read = r.read_batch(n_rows, def.data(), rep.data(), val.data()).get0()) {
+            for (size_t i = 0; i < n_read; ++i) {
+                BOOST_REQUIRE_EQUAL(val[i], expected);
+                ++expected;
+            }
+        }
+        BOOST_CHECK_EQUAL(expected, n_rows);
+        fr.close().get();
+    });
+}
+
+SEASTAR_TEST_CASE(memory_roundtrip) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema;
+        writer_schema.fields.push_back(writer_schema::primitive_node{"Value", true, logical_type::STRING{},
+                {}, format::Encoding::RLE_DICTIONARY, format::CompressionCodec::SNAPPY});
+
+        // Small buffers, so that the file is split across many of them.
+        auto buffers = seastar::make_lw_shared<buffer_chain>();
+        std::unique_ptr<file_writer> fw = file_writer::open(
+                make_memory_output_stream(buffers, 16), writer_schema).get0();
+        auto& value = fw->column<format::Type::BYTE_ARRAY>(0);
+        value.put(1, 0, "a"_bv);
+        value.put(0, 0, bytes_view{});
+        fw->flush_row_group().get();
+        value.put(1, 0, "b"_bv);
+        fw->close().get();
+        BOOST_CHECK_GT(buffers->size(), 1);
+
+        std::string expected = R"###(
+CREATE TABLE "parquet"("row_number" bigint PRIMARY KEY, "Value" text);
+INSERT INTO "parquet"("row_number", "Value") VALUES(0, 'a');
+INSERT INTO "parquet"("row_number", "Value") VALUES(1, null);
+INSERT INTO "parquet"("row_number", "Value") VALUES(2, 'b');
+)###";
+        auto to_cql = [&] (seastar::shared_ptr<random_access_source> source) {
+            file_reader fr = file_reader::open(std::move(source)).get0();
+            std::stringstream ss;
+            ss << '\n';
+            cql::parquet_to_cql(fr, "parquet", "row_number", ss).get();
+            fr.close().get();
+            return ss.str();
+        };
+
+        buffer_chain shared;
+        bytes flat;
+        for (seastar::temporary_buffer<char>& buf : *buffers) {
+            shared.push_back(buf.share());
+            flat.append(reinterpret_cast<const uint8_t*>(buf.get()), buf.size());
+        }
+        BOOST_CHECK_EQUAL(to_cql(make_memory_source(std::move(shared))), expected);
+
+        // Streams read in pieces smaller than the pages.
+        auto read = [&flat] (uint64_t pos, size_t len) {
+            return seastar::make_ready_future<seastar::temporary_buffer<uint8_t>>(
+                    seastar::temporary_buffer<uint8_t>(flat.data() + pos, len));
+        };
+        BOOST_CHECK_EQUAL(to_cql(make_callback_source(flat.size(), read, 7)), expected);
+
+        BOOST_CHECK_THROW(file_reader::open(make_memory_source(buffer_chain{})).get(), parquet_exception);
+    });
+}
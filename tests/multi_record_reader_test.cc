@@ -0,0 +1,90 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include "record_reader_test_utils.hh"
+#include <parquet4seastar/multi_record_reader.hh>
+#include <seastar/testing/test_case.hh>
+
+const std::string test_file_name = "/tmp/parquet4seastar_multi_record_reader_test.parquet";
+
+SEASTAR_TEST_CASE(multi_record_reader_files) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            return schema{vec<node>(
+                primitive_node{"a", false, logical_type::INT64{}},
+                primitive_node{"b", true, logical_type::INT64{}}
+            )};
+        }();
+
+        // Files with 2, 0 and 1 row groups of 3 records.
+        std::vector<std::string> paths;
+        int64_t value = 0;
+        for (int row_groups : {2, 0, 1}) {
+            paths.push_back(test_file_name + std::to_string(paths.size()));
+            write_test_file(paths.back(), writer_schema, [&] (record::record_writer& rw, file_writer& fw) {
+                for (int i = 0; i < row_groups; ++i) {
+                    for (int j = 0; j < 3; ++j) {
+                        rw.start_record();
+                        rw.append_value(++value);
+                        rw.append_null();
+                        rw.end_record();
+                    }
+                    end_row_group(rw, fw);
+                }
+            });
+        }
+
+        {
+            record::multi_record_reader reader{paths};
+            counting_consumer c;
+            reader.read_all(c).get();
+            reader.close().get();
+            BOOST_CHECK_EQUAL(c.records, 9);
+            BOOST_CHECK_EQUAL(c.nulls, 9);
+            BOOST_CHECK_EQUAL(c.sum, 9 * 10 / 2);
+        }
+        {
+            file_reader fr = file_reader::open(paths[0]).get0();
+            record::multi_record_reader reader{std::vector<file_reader*>{&fr}, record::projection::of_columns(fr.schema(), {1})};
+            counting_consumer c;
+            reader.read_all(c).get();
+            reader.close().get();
+            BOOST_CHECK_EQUAL(c.records, 6);
+            BOOST_CHECK_EQUAL(c.values, 0);
+            BOOST_CHECK(c.fields == (std::vector<std::string>{"b"}));
+            fr.close().get();
+        }
+        {
+            // A file with a different schema.
+            writer_schema::schema other_schema{};
+            other_schema.fields.push_back(writer_schema::primitive_node{"a", false, logical_type::INT32{}});
+            paths.push_back(test_file_name + std::to_string(paths.size()));
+            file_writer::open(paths.back(), other_schema).get0()->close().get();
+            record::multi_record_reader reader{paths};
+            counting_consumer c;
+            BOOST_CHECK_THROW(reader.read_all(c).get(), parquet_exception);
+            reader.close().get();
+        }
+    });
+}
@@ -0,0 +1,487 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include "record_reader_test_utils.hh"
+#include <parquet4seastar/record_reader.hh>
+#include <parquet4seastar/multi_record_reader.hh>
+#include <parquet4seastar/static_record_reader.hh>
+#include <seastar/testing/test_case.hh>
+
+const std::string test_file_name = "/tmp/parquet4seastar_record_reader_test.parquet";
+
+// Records spanning many batches of the leaf readers are assembled whole.
+SEASTAR_TEST_CASE(record_reader_long_records) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            return schema{vec<node>(
+                primitive_node{"Id", false, logical_type::INT32{}},
+                list_node{"List", true, box<node>(primitive_node{"Element", false, logical_type::INT64{}})}
+            )};
+        }();
+
+        constexpr int64_t n_records = 10;
+        constexpr int64_t list_size = 3000;
+        write_test_file(test_file_name, writer_schema, [] (record::record_writer& rw, file_writer&) {
+            for (int32_t i = 0; i < n_records; ++i) {
+                rw.start_record();
+                rw.append_value(i);
+                if (i % 2 == 0) {
+                    rw.append_null();
+                } else {
+                    rw.start_list();
+                    for (int64_t j = 0; j < list_size; ++j) {
+                        rw.append_value(j);
+                    }
+                    rw.end_list();
+                }
+                rw.end_record();
+            }
+        });
+
+        file_reader fr = file_reader::open(test_file_name).get0();
+        record::record_reader rr = record::record_reader::make(fr, 0).get0();
+        counting_consumer c;
+        rr.read_all(c).get();
+        BOOST_CHECK_EQUAL(c.records, n_records);
+        BOOST_CHECK_EQUAL(c.nulls, n_records / 2);
+        BOOST_CHECK_EQUAL(c.values, n_records + n_records / 2 * list_size);
+        BOOST_CHECK_EQUAL(c.sum, n_records / 2 * list_size * (list_size - 1) / 2);
+        fr.close().get();
+    });
+}
+
+SEASTAR_TEST_CASE(record_reader_projection) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            return schema{vec<node>(
+                primitive_node{"Id", false, logical_type::INT32{}},
+                struct_node{"Struct", true, vec<node>(
+                    primitive_node{"a", false, logical_type::INT64{}},
+                    primitive_node{"b", true, logical_type::INT64{}}
+                )},
+                primitive_node{"Last", false, logical_type::INT64{}}
+            )};
+        }();
+
+        write_test_file(test_file_name, writer_schema, [] (record::record_writer& rw, file_writer&) {
+            for (int32_t i = 0; i < 3; ++i) {
+                rw.start_record();
+                rw.append_value(i);
+                rw.start_struct();
+                rw.append_value(int64_t(1));
+                rw.append_value(int64_t(10));
+                rw.end_struct();
+                rw.append_value(int64_t(100));
+                rw.end_record();
+            }
+        });
+
+        file_reader fr = file_reader::open(test_file_name).get0();
+        {
+            auto proj = record::projection::of_paths(fr.schema(), {{"Struct", "b"}, {"Last"}});
+            record::record_reader rr = record::record_reader::make(fr, 0, proj).get0();
+            counting_consumer c;
+            rr.read_all(c).get();
+            BOOST_CHECK_EQUAL(c.records, 3);
+            BOOST_CHECK_EQUAL(c.sum, 3 * 110);
+            BOOST_CHECK(c.fields == (std::vector<std::string>{"Struct", "b", "Last"}));
+        }
+        {
+            auto proj = record::projection::of_columns(fr.schema(), {0});
+            record::record_reader rr = record::record_reader::make(fr, 0, proj).get0();
+            counting_consumer c;
+            rr.read_all(c).get();
+            BOOST_CHECK_EQUAL(c.values, 3);
+            BOOST_CHECK(c.fields == (std::vector<std::string>{"Id"}));
+        }
+        BOOST_CHECK_THROW(record::projection::of_paths(fr.schema(), {{"Struct", "c"}}), parquet_exception);
+        fr.close().get();
+    });
+}
+
+SEASTAR_TEST_CASE(static_record_reader) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            return schema{vec<node>(
+                primitive_node{"Id", false, logical_type::INT32{}},
+                list_node{"List", true, box<node>(primitive_node{"Element", false, logical_type::INT64{}})},
+                map_node{"Map", false,
+                    box<node>(primitive_node{"Key", false, logical_type::STRING{}}),
+                    box<node>(struct_node{"Value", true, vec<node>(
+                        primitive_node{"a", false, logical_type::INT64{}},
+                        primitive_node{"b", true, logical_type::INT64{}}
+                    )})
+                }
+            )};
+        }();
+
+        write_test_file(test_file_name, writer_schema, [] (record::record_writer& rw, file_writer&) {
+            for (int32_t i = 0; i < 100; ++i) {
+                rw.start_record();
+                rw.append_value(i);
+                if (i % 3 == 0) {
+                    rw.append_null();
+                } else {
+                    rw.start_list();
+                    for (int64_t j = 0; j < i; ++j) {
+                        rw.append_value(j);
+                    }
+                    rw.end_list();
+                }
+                rw.start_map();
+                if (i % 2 == 0) {
+                    rw.append_value("k"_bv);
+                    rw.start_struct();
+                    rw.append_value(int64_t(i));
+                    rw.end_struct();
+                }
+                rw.end_map();
+                rw.end_record();
+            }
+        });
+
+        using schema = record::static_schema::schema<
+            record::static_schema::primitive_node<logical_type::INT32>,
+            record::static_schema::optional_node<record::static_schema::list_node<
+                record::static_schema::primitive_node<logical_type::INT64>>>,
+            record::static_schema::map_node<
+                record::static_schema::primitive_node<logical_type::STRING>,
+                record::static_schema::optional_node<record::static_schema::struct_node<
+                    record::static_schema::primitive_node<logical_type::INT64>,
+                    record::static_schema::optional_node<record::static_schema::primitive_node<logical_type::INT64>>>>>>;
+        using wrong_schema = record::static_schema::schema<
+            record::static_schema::primitive_node<logical_type::INT64>>;
+
+        file_reader fr = file_reader::open(test_file_name).get0();
+        BOOST_CHECK(record::static_record_reader<schema>::matches(fr.schema()));
+        BOOST_CHECK(!record::static_record_reader<wrong_schema>::matches(fr.schema()));
+        BOOST_CHECK_THROW(record::static_record_reader<wrong_schema>::make(fr, 0).get(), parquet_exception);
+
+        counting_consumer expected;
+        record::record_reader rr = record::record_reader::make(fr, 0).get0();
+        rr.read_all(expected).get();
+
+        counting_consumer c;
+        auto srr = record::static_record_reader<schema>::make(fr, 0).get0();
+        srr.read_all(c).get();
+        BOOST_CHECK_EQUAL(c.records, expected.records);
+        BOOST_CHECK_EQUAL(c.values, expected.values);
+        BOOST_CHECK_EQUAL(c.nulls, expected.nulls);
+        BOOST_CHECK_EQUAL(c.sum, expected.sum);
+        BOOST_CHECK(c.fields == expected.fields);
+        fr.close().get();
+    });
+}
+
+SEASTAR_TEST_CASE(record_reader_filter) {
+    using namespace parquet4seastar;
+    using record::predicate;
+    using record::comparison;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            primitive_node name{"Name", true, logical_type::STRING{}};
+            name.bloom_filter = bloom_filter_options{};
+            return schema{vec<node>(
+                primitive_node{"Id", false, logical_type::INT32{}},
+                std::move(name),
+                list_node{"List", true, box<node>(primitive_node{"Element", false, logical_type::INT64{}})}
+            )};
+        }();
+
+        // Row group i holds the ids [10 * i, 10 * i + 10). Every third name is null.
+        write_test_file(test_file_name, writer_schema, [] (record::record_writer& rw, file_writer& fw) {
+            for (int32_t i = 0; i < 30; ++i) {
+                rw.start_record();
+                rw.append_value(i);
+                if (i % 3 == 0) {
+                    rw.append_null();
+                } else {
+                    std::string name = "name" + std::to_string(i);
+                    rw.append_value(bytes_view{reinterpret_cast<const uint8_t*>(name.data()), name.size()});
+                }
+                rw.append_null();
+                rw.end_record();
+                if (i % 10 == 9) {
+                    end_row_group(rw, fw);
+                }
+            }
+        });
+
+        file_reader fr = file_reader::open(test_file_name).get0();
+        {
+            // The filtered column isn't projected.
+            auto proj = record::projection::of_columns(fr.schema(), {1});
+            std::vector<predicate> filter{
+                predicate::make(0, comparison::ge, int32_t(4)),
+                predicate::make(0, comparison::lt, int32_t(8))};
+            record::record_reader rr = record::record_reader::make(fr, 0, proj, filter).get0();
+            counting_consumer c;
+            rr.read_all(c).get();
+            BOOST_CHECK_EQUAL(c.records, 4);
+            BOOST_CHECK_EQUAL(c.values, 3);
+            BOOST_CHECK_EQUAL(c.nulls, 1);
+            BOOST_CHECK(c.fields == (std::vector<std::string>{"Name"}));
+        }
+        {
+            record::record_reader rr = record::record_reader::make(fr, 1, {}, {predicate::is_null(1)}).get0();
+            counting_consumer c;
+            rr.read_one(c).get();
+            rr.read_all(c).get();
+            BOOST_CHECK_EQUAL(c.records, 3);
+        }
+
+        auto may_match = [&fr] (int row_group, predicate p) {
+            return record::row_group_may_match(fr, row_group, {std::move(p)}).get0();
+        };
+        BOOST_CHECK(!may_match(0, predicate::make(0, comparison::eq, int32_t(15))));
+        BOOST_CHECK(may_match(1, predicate::make(0, comparison::eq, int32_t(15))));
+        BOOST_CHECK(!may_match(2, predicate::make(0, comparison::lt, int32_t(20))));
+        BOOST_CHECK(may_match(2, predicate::make(0, comparison::le, int32_t(20))));
+        BOOST_CHECK(may_match(0, predicate::make(1, comparison::eq, "name5"_bv)));
+        // Within the range of the statistics, but not in the bloom filter.
+        BOOST_CHECK(!may_match(0, predicate::make(1, comparison::eq, "name55"_bv)));
+        BOOST_CHECK_THROW(may_match(0, predicate::make(0, comparison::eq, int64_t(1))), parquet_exception);
+        BOOST_CHECK_THROW(may_match(0, predicate::is_null(2)), parquet_exception);
+
+        {
+            std::vector<file_reader*> files{&fr};
+            record::multi_record_reader reader{files, {}, {predicate::make(0, comparison::gt, int32_t(25))}};
+            counting_consumer c;
+            reader.read_all(c).get();
+            reader.close().get();
+            BOOST_CHECK_EQUAL(c.records, 4);
+        }
+        fr.close().get();
+    });
+}
+
+SEASTAR_TEST_CASE(record_reader_row_selection) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            return schema{vec<node>(
+                primitive_node{"Id", false, logical_type::INT64{}},
+                list_node{"List", true, box<node>(primitive_node{"Element", false, logical_type::INT64{}})}
+            )};
+        }();
+
+        // Row group i holds the ids [100 * i, 100 * i + 100). Record j has a list of j % 3 zeroes.
+        write_test_file(test_file_name, writer_schema, [] (record::record_writer& rw, file_writer& fw) {
+            for (int64_t i = 0; i < 300; ++i) {
+                rw.start_record();
+                rw.append_value(i);
+                rw.start_list();
+                for (int64_t j = 0; j < i % 3; ++j) {
+                    rw.append_value(int64_t(0));
+                }
+                rw.end_list();
+                rw.end_record();
+                if (i % 100 == 99) {
+                    end_row_group(rw, fw);
+                }
+            }
+        });
+
+        file_reader fr = file_reader::open(test_file_name).get0();
+        auto read = [&fr] (const std::vector<std::pair<int, record::row_selection>>& selections) {
+            counting_consumer c;
+            for (const auto& [row_group, rows] : selections) {
+                record::record_reader rr = record::record_reader::make(fr, row_group, {}, {}, rows).get0();
+                rr.read_all(c).get();
+            }
+            return c;
+        };
+        {
+            auto selections = record::select_row_range(fr.shallow_metadata(), 150, 210);
+            BOOST_CHECK_EQUAL(selections.size(), 2);
+            counting_consumer c = read(selections);
+            BOOST_CHECK_EQUAL(c.records, 60);
+            int64_t ids = (150 + 209) * 60 / 2;
+            BOOST_CHECK_EQUAL(c.sum, ids);
+        }
+        {
+            record::row_selection rows;
+            rows.rows = std::vector<uint64_t>{1, 2, 50, 99};
+            record::record_reader rr = record::record_reader::make(fr, 2, {}, {}, rows).get0();
+            counting_consumer c;
+            rr.read_one(c).get();
+            BOOST_CHECK_EQUAL(c.sum, 201);
+            rr.read_all(c).get();
+            BOOST_CHECK_EQUAL(c.records, 4);
+            BOOST_CHECK_EQUAL(c.sum, 201 + 202 + 250 + 299);
+            BOOST_CHECK_THROW(rr.read_one(c).get(), parquet_exception);
+        }
+        {
+            counting_consumer c = read(record::select_uniform_sample(fr.shallow_metadata(), 17, 1));
+            BOOST_CHECK_EQUAL(c.records, 17);
+            BOOST_CHECK_EQUAL(read(record::select_uniform_sample(fr.shallow_metadata(), 1000, 1)).records, 300);
+        }
+        BOOST_CHECK_EQUAL(read(record::select_bernoulli_sample(fr.shallow_metadata(), 1, 1)).records, 300);
+        BOOST_CHECK_EQUAL(read(record::select_bernoulli_sample(fr.shallow_metadata(), 0, 1)).records, 0);
+        BOOST_CHECK_THROW(record::select_bernoulli_sample(fr.shallow_metadata(), 2, 1), parquet_exception);
+        fr.close().get();
+    });
+}
+
+// Row ranges starting several pages into the chunks are read through the offset index,
+// from the page of their first row, together with the dictionary page if there is one.
+SEASTAR_TEST_CASE(record_reader_page_skipping) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            primitive_node dict{"Dict", true, logical_type::STRING{}};
+            dict.encoding = format::Encoding::RLE_DICTIONARY;
+            return schema{vec<node>(
+                primitive_node{"Id", false, logical_type::INT64{}},
+                std::move(dict),
+                primitive_node{"Plain", false, logical_type::STRING{}},
+                list_node{"List", true, box<node>(primitive_node{"Element", false, logical_type::INT64{}})}
+            )};
+        }();
+
+        auto dict_value = [] (int64_t i) { return "dict value " + std::to_string(i % 4); };
+        auto plain_value = [] (int64_t i) { return "plain value " + std::to_string(i); };
+        auto as_bytes = [] (const std::string& s) {
+            return bytes_view{reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+        };
+
+        constexpr int64_t n_records = 200;
+        constexpr int64_t rows_per_page = 10;
+        file_writer_options options;
+        options.column_options.max_rows_per_page = rows_per_page;
+        write_test_file(test_file_name, writer_schema, [&] (record::record_writer& rw, file_writer&) {
+            for (int64_t i = 0; i < n_records; ++i) {
+                rw.start_record();
+                rw.append_value(i);
+                if (i % 3 == 0) {
+                    rw.append_null();
+                } else {
+                    rw.append_value(as_bytes(dict_value(i)));
+                }
+                rw.append_value(as_bytes(plain_value(i)));
+                rw.start_list();
+                for (int64_t j = 0; j < i % 3; ++j) {
+                    rw.append_value(1000 * i);
+                }
+                rw.end_list();
+                rw.end_record();
+            }
+        }, options);
+
+        file_reader fr = file_reader::open(test_file_name).get0();
+        BOOST_REQUIRE(fr.column_chunk(0, 1).__isset.offset_index_offset);
+        BOOST_REQUIRE(fr.column_chunk(0, 1).meta_data.__isset.dictionary_page_offset);
+        BOOST_REQUIRE(!fr.column_chunk(0, 2).meta_data.__isset.dictionary_page_offset);
+
+        std::vector<std::pair<int64_t, int64_t>> ranges{{55, 137}, {70, 100}, {191, 200}};
+        for (auto [first, end] : ranges) {
+            // Only the pages from the one holding the first row are read.
+            uint64_t first_page_row = first / rows_per_page * rows_per_page;
+            auto dict_reader = fr.open_column_chunk_reader_at<format::Type::BYTE_ARRAY>(0, 1, first).get0();
+            BOOST_CHECK_EQUAL(dict_reader.second, first_page_row);
+            auto plain_reader = fr.open_column_chunk_reader_at<format::Type::BYTE_ARRAY>(0, 2, first).get0();
+            BOOST_CHECK_EQUAL(plain_reader.second, first_page_row);
+
+            counting_consumer expected;
+            for (int64_t i = first; i < end; ++i) {
+                ++expected.records;
+                expected.sum += i + i % 3 * 1000 * i;
+                if (i % 3 != 0) {
+                    expected.strings.push_back(dict_value(i));
+                }
+                expected.strings.push_back(plain_value(i));
+            }
+
+            auto selections = record::select_row_range(fr.shallow_metadata(), first, end);
+            BOOST_REQUIRE_EQUAL(selections.size(), 1);
+            record::record_reader rr = record::record_reader::make(fr, 0, {}, {}, selections[0].second).get0();
+            counting_consumer c;
+            rr.read_all(c).get();
+            BOOST_CHECK_EQUAL(c.records, expected.records);
+            BOOST_CHECK_EQUAL(c.sum, expected.sum);
+            BOOST_CHECK(c.strings == expected.strings);
+        }
+        fr.close().get();
+    });
+}
+
+// Values read with an arena are the same as without it, also when records span refills.
+SEASTAR_TEST_CASE(record_reader_arena) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            primitive_node dict{"Element", false, logical_type::STRING{}};
+            dict.encoding = format::Encoding::RLE_DICTIONARY;
+            return schema{vec<node>(
+                primitive_node{"Plain", true, logical_type::STRING{}},
+                list_node{"Dict", false, box<node>(std::move(dict))}
+            )};
+        }();
+
+        write_test_file(test_file_name, writer_schema, [] (record::record_writer& rw, file_writer&) {
+            for (int i = 0; i < 3000; ++i) {
+                rw.start_record();
+                if (i % 5 == 0) {
+                    rw.append_null();
+                } else {
+                    std::string value = "plain value " + std::to_string(i);
+                    rw.append_value(bytes_view{reinterpret_cast<const uint8_t*>(value.data()), value.size()});
+                }
+                rw.start_list();
+                for (int j = 0; j < i % 7; ++j) {
+                    std::string value = "dict value " + std::to_string(j);
+                    rw.append_value(bytes_view{reinterpret_cast<const uint8_t*>(value.data()), value.size()});
+                }
+                rw.end_list();
+                rw.end_record();
+            }
+        });
+
+        file_reader fr = file_reader::open(test_file_name).get0();
+        auto read = [&fr] (bool use_arena) {
+            record::record_reader rr = record::record_reader::make(fr, 0, {}, {}, {}, use_arena).get0();
+            counting_consumer c;
+            rr.read_all(c).get();
+            return c.strings;
+        };
+        std::vector<std::string> expected = read(false);
+        BOOST_CHECK_EQUAL(expected.size(), 2400 + 3000 / 7 * 21 + (0 + 1 + 2 + 3));
+        BOOST_CHECK(read(true) == expected);
+        fr.close().get();
+    });
+}
@@ -0,0 +1,106 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#pragma once
+
+#include <parquet4seastar/record_writer.hh>
+#include <seastar/core/thread.hh>
+
+// Helpers shared by the tests of the record readers.
+
+constexpr parquet4seastar::bytes_view operator ""_bv(const char* str, size_t len) noexcept {
+    return {static_cast<const uint8_t*>(static_cast<const void*>(str)), len};
+}
+
+template <typename T>
+std::unique_ptr<T> box(T&& x) {
+    return std::make_unique<T>(std::forward<T>(x));
+}
+
+template <typename T, typename Targ>
+void vec_fill(std::vector<T>& v, Targ&& arg) {
+    v.push_back(std::forward<Targ>(arg));
+}
+
+template <typename T, typename Targ, typename... Targs>
+void vec_fill(std::vector<T>& v, Targ&& arg, Targs&&... args) {
+    v.push_back(std::forward<Targ>(arg));
+    vec_fill(v, std::forward<Targs>(args)...);
+}
+
+template <typename T, typename... Targs>
+std::vector<T> vec(Targs&&... args) {
+    std::vector<T> v;
+    vec_fill(v, std::forward<Targs>(args)...);
+    return v;
+}
+
+// Writes a file with the given schema, whose records are written by fill(rw, fw).
+// fill() can end row groups with end_row_group(). Must be called in a seastar thread.
+template <typename Fill>
+void write_test_file(const std::string& path, const parquet4seastar::writer_schema::schema& schema,
+        Fill fill, parquet4seastar::file_writer_options options = {}) {
+    using namespace parquet4seastar;
+    std::unique_ptr<file_writer> fw = file_writer::open(path, schema, std::move(options)).get0();
+    record::record_writer rw{*fw, schema};
+    fill(rw, *fw);
+    rw.close().get();
+}
+
+inline void end_row_group(parquet4seastar::record::record_writer& rw, parquet4seastar::file_writer& fw) {
+    rw.flush();
+    fw.flush_row_group().get();
+}
+
+// Counts what record_reader passes to it.
+struct counting_consumer {
+    size_t records = 0;
+    size_t values = 0;
+    size_t nulls = 0;
+    int64_t sum = 0;
+    // Copies of byte array values.
+    std::vector<std::string> strings;
+    // The columns and fields of the last record.
+    std::vector<std::string> fields;
+    void start_record() { fields.clear(); }
+    void end_record() { ++records; }
+    void start_column(const std::string& name) { fields.push_back(name); }
+    void start_struct() {}
+    void end_struct() {}
+    void start_field(const std::string& name) { fields.push_back(name); }
+    void start_list() {}
+    void end_list() {}
+    void start_map() {}
+    void end_map() {}
+    void separate_list_values() {}
+    void separate_key_value() {}
+    void separate_map_values() {}
+    void append_null() { ++nulls; }
+    template <typename LogicalType, typename T>
+    void append_value(LogicalType, const T& v) {
+        ++values;
+        if constexpr (std::is_same_v<T, int64_t>) {
+            sum += v;
+        } else if constexpr (std::is_same_v<T, seastar::temporary_buffer<uint8_t>>) {
+            strings.emplace_back(reinterpret_cast<const char*>(v.get()), v.size());
+        }
+    }
+};
@@ -0,0 +1,192 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include <parquet4seastar/record_writer.hh>
+#include <parquet4seastar/cql_reader.hh>
+#include <seastar/testing/test_case.hh>
+#include <seastar/core/thread.hh>
+
+const std::string test_file_name = "/tmp/parquet4seastar_record_writer_test.parquet";
+
+constexpr parquet4seastar::bytes_view operator ""_bv(const char* str, size_t len) noexcept {
+    return {static_cast<const uint8_t*>(static_cast<const void*>(str)), len};
+}
+
+template <typename T>
+std::unique_ptr<T> box(T&& x) {
+    return std::make_unique<T>(std::forward<T>(x));
+}
+
+template <typename T, typename Targ>
+void vec_fill(std::vector<T>& v, Targ&& arg) {
+    v.push_back(std::forward<Targ>(arg));
+}
+
+template <typename T, typename Targ, typename... Targs>
+void vec_fill(std::vector<T>& v, Targ&& arg, Targs&&... args) {
+    v.push_back(std::forward<Targ>(arg));
+    vec_fill(v, std::forward<Targs>(args)...);
+}
+
+template <typename T, typename... Targs>
+std::vector<T> vec(Targs&&... args) {
+    std::vector<T> v;
+    vec_fill(v, std::forward<Targs>(args)...);
+    return v;
+}
+
+SEASTAR_TEST_CASE(record_roundtrip) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        // Write
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            return schema{vec<node>(
+                map_node {"Map", true,
+                    box<node>(primitive_node{
+                        "Map key",
+                        false,
+                        logical_type::STRING{},
+                        {},
+                        format::Encoding::RLE_DICTIONARY,
+                        format::CompressionCodec::GZIP}),
+                    box<node>(primitive_node{
+                        "Map value",
+                        false,
+                        logical_type::INT32{},
+                        {},
+                        format::Encoding::PLAIN,
+                        format::CompressionCodec::SNAPPY}),
+                },
+                list_node {"List", true,
+                    box<node>(struct_node{"Struct", true, vec<node>(
+                        primitive_node{"Struct field 1", true, logical_type::FLOAT{}},
+                        primitive_node{"Struct field 2", false, logical_type::DOUBLE{}}
+                    )})
+                },
+                list_node {"Nested list", false,
+                    box<node>(list_node{"Inner list", true,
+                        box<node>(primitive_node{"Element", true, logical_type::INT64{}})
+                    })
+                }
+            )};
+        }();
+
+        std::unique_ptr<file_writer> fw = file_writer::open(test_file_name, writer_schema).get0();
+        record::record_writer rw{*fw, writer_schema, record::record_writer_options{2}};
+
+        rw.start_record();
+        rw.start_column("Map");
+        rw.append_null();
+        rw.start_column("Nested list");
+        rw.start_list();
+        rw.end_list();
+        rw.end_record();
+
+        rw.start_record();
+        rw.start_column("Map");
+        rw.start_map();
+        rw.append_value("key1"_bv);
+        rw.separate_key_value();
+        rw.append_value(1);
+        rw.separate_map_values();
+        rw.append_value("key2"_bv);
+        rw.separate_key_value();
+        rw.append_value(2);
+        rw.end_map();
+        rw.start_column("List");
+        rw.start_list();
+        rw.append_null();
+        rw.separate_list_values();
+        rw.start_struct();
+        rw.start_field("Struct field 2");
+        rw.append_value(1.0);
+        rw.end_struct();
+        rw.end_list();
+        rw.start_list();
+        rw.start_list();
+        rw.append_value(int64_t(1));
+        rw.append_null();
+        rw.end_list();
+        rw.append_null();
+        rw.start_list();
+        rw.end_list();
+        rw.end_list();
+        rw.end_record();
+        BOOST_CHECK_EQUAL(rw.buffered_records(), 0);
+
+        rw.start_record();
+        rw.start_column("Map");
+        rw.start_map();
+        rw.end_map();
+        rw.start_list();
+        rw.start_struct();
+        rw.append_value(2.0f);
+        rw.append_value(3.0);
+        rw.end_struct();
+        rw.end_list();
+        rw.start_list();
+        rw.end_list();
+        rw.end_record();
+        BOOST_CHECK_EQUAL(rw.buffered_records(), 1);
+
+        rw.start_record();
+        BOOST_CHECK_THROW(rw.start_column("No such column"), parquet_exception);
+
+        rw.close().get();
+
+        // Read
+        file_reader fr = file_reader::open(test_file_name).get0();
+        std::stringstream ss;
+        ss << '\n';
+        cql::parquet_to_cql(fr, "parquet", "row_number", ss).get();
+        std::string output = R"###(
+CREATE TYPE "parquet_udt_0" ("Struct field 1" float, "Struct field 2" double);
+CREATE TABLE "parquet"("row_number" bigint PRIMARY KEY, "Map" frozen<map<text, int>>, "List" frozen<list<"parquet_udt_0">>, "Nested list" frozen<list<frozen<list<bigint>>>>);
+INSERT INTO "parquet"("row_number", "Map", "List", "Nested list") VALUES(0, null, null, []);
+INSERT INTO "parquet"("row_number", "Map", "List", "Nested list") VALUES(1, {'key1': 1, 'key2': 2}, [null, {"Struct field 1": null, "Struct field 2": 1.000000e+00}], [[1, null], null, []]);
+INSERT INTO "parquet"("row_number", "Map", "List", "Nested list") VALUES(2, {}, [{"Struct field 1": 2.000000e+00, "Struct field 2": 3.000000e+00}], []);
+)###";
+        BOOST_CHECK_EQUAL(ss.str(), output);
+    });
+}
+
+SEASTAR_TEST_CASE(record_fixed_len_byte_array_size) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        writer_schema::schema writer_schema = [] () -> writer_schema::schema {
+            using namespace writer_schema;
+            return schema{vec<node>(
+                primitive_node{"Fixed", false, logical_type::FIXED_LEN_BYTE_ARRAY{}, 4}
+            )};
+        }();
+
+        std::unique_ptr<file_writer> fw = file_writer::open(test_file_name, writer_schema).get0();
+        record::record_writer rw{*fw, writer_schema};
+
+        rw.start_record();
+        BOOST_CHECK_THROW(rw.append_value("abc"_bv), parquet_exception);
+        // The record writer is unusable after an exception, but the file can still be closed.
+        fw->close().get();
+    });
+}
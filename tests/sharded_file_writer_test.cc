@@ -0,0 +1,85 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#include <parquet4seastar/sharded_file_writer.hh>
+#include <parquet4seastar/cql_reader.hh>
+#include <seastar/testing/test_case.hh>
+#include <seastar/core/thread.hh>
+
+const std::string test_file_name = "/tmp/parquet4seastar_sharded_file_writer_test.parquet";
+
+constexpr parquet4seastar::bytes_view operator ""_bv(const char* str, size_t len) noexcept {
+    return {static_cast<const uint8_t*>(static_cast<const void*>(str)), len};
+}
+
+SEASTAR_TEST_CASE(sharded_roundtrip) {
+    using namespace parquet4seastar;
+
+    return seastar::async([] {
+        // Write
+        writer_schema::schema writer_schema;
+        writer_schema.fields.push_back(writer_schema::primitive_node{"a", false, logical_type::INT32{}});
+        writer_schema.fields.push_back(writer_schema::primitive_node{"b", true, logical_type::STRING{},
+                {}, format::Encoding::RLE_DICTIONARY, format::CompressionCodec::SNAPPY});
+        writer_schema.fields.push_back(writer_schema::primitive_node{"c", false, logical_type::DOUBLE{}});
+
+        std::unique_ptr<sharded_file_writer> fw = sharded_file_writer::open(test_file_name, writer_schema).get0();
+        BOOST_CHECK_EQUAL(fw->shard_of(1), 1 % seastar::smp::count);
+
+        auto write_rows = [&] (int32_t a, double c) {
+            seastar::when_all_succeed(
+                fw->invoke_on_column<format::Type::INT32>(0, [a] (column_chunk_writer<format::Type::INT32>& w) {
+                    w.put(0, 0, a);
+                    w.put(0, 0, a + 1);
+                }),
+                fw->invoke_on_column<format::Type::BYTE_ARRAY>(1, [] (column_chunk_writer<format::Type::BYTE_ARRAY>& w) {
+                    w.put(1, 0, "x"_bv);
+                    w.put(0, 0, bytes_view{});
+                }),
+                fw->invoke_on_column<format::Type::DOUBLE>(2, [c] (column_chunk_writer<format::Type::DOUBLE>& w) {
+                    w.put(0, 0, c);
+                    w.put(0, 0, c + 1);
+                })
+            ).get();
+        };
+
+        write_rows(1, 1.0);
+        BOOST_CHECK_EQUAL(fw->rows_in_row_group().get0(), 2);
+        fw->flush_row_group().get();
+        write_rows(3, 3.0);
+        fw->close().get();
+
+        // Read
+        file_reader fr = file_reader::open(test_file_name).get0();
+        BOOST_CHECK_EQUAL(fr.metadata().row_groups.size(), 2);
+        std::stringstream ss;
+        ss << '\n';
+        cql::parquet_to_cql(fr, "parquet", "row_number", ss).get();
+        std::string output = R"###(
+CREATE TABLE "parquet"("row_number" bigint PRIMARY KEY, "a" int, "b" text, "c" double);
+INSERT INTO "parquet"("row_number", "a", "b", "c") VALUES(0, 1, 'x', 1.000000e+00);
+INSERT INTO "parquet"("row_number", "a", "b", "c") VALUES(1, 2, null, 2.000000e+00);
+INSERT INTO "parquet"("row_number", "a", "b", "c") VALUES(2, 3, 'x', 3.000000e+00);
+INSERT INTO "parquet"("row_number", "a", "b", "c") VALUES(3, 4, null, 4.000000e+00);
+)###";
+        BOOST_CHECK_EQUAL(ss.str(), output);
+    });
+}
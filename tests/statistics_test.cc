@@ -0,0 +1,125 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+#define BOOST_TEST_MODULE parquet
+
+#include <parquet4seastar/statistics.hh>
+#include <boost/test/included/unit_test.hpp>
+#include <cmath>
+#include <limits>
+
+namespace parquet4seastar {
+
+namespace {
+
+bytes_view operator ""_bv(const char* str, size_t len) noexcept {
+    return {reinterpret_cast<const uint8_t*>(str), len};
+}
+
+template <typename T>
+std::string plain(T x) {
+    return std::string(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+std::string str(bytes_view x) {
+    return std::string(reinterpret_cast<const char*>(x.data()), x.size());
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(statistics_integers) {
+    statistics_builder<format::Type::INT32> sb{statistics_options{}};
+    sb.put(-5);
+    sb.put(7);
+    sb.put_null();
+    format::Statistics stats = sb.build();
+    BOOST_CHECK_EQUAL(stats.null_count, 1);
+    BOOST_CHECK(stats.min_value == plain<int32_t>(-5));
+    BOOST_CHECK(stats.max_value == plain<int32_t>(7));
+    BOOST_CHECK(stats.min == plain<int32_t>(-5));
+
+    statistics_options unsigned_options;
+    unsigned_options.sort_order = logical_type::sort_order::UNSIGNED;
+    statistics_builder<format::Type::INT32> usb{unsigned_options};
+    usb.put(-5);
+    usb.put(7);
+    stats = usb.build();
+    BOOST_CHECK(stats.min_value == plain<int32_t>(7));
+    BOOST_CHECK(stats.max_value == plain<int32_t>(-5));
+    BOOST_CHECK(!stats.__isset.min && !stats.__isset.max);
+}
+
+BOOST_AUTO_TEST_CASE(statistics_floats) {
+    statistics_builder<format::Type::DOUBLE> sb{statistics_options{}};
+    sb.put(std::numeric_limits<double>::quiet_NaN());
+    BOOST_CHECK(!sb.build().__isset.min_value);
+    sb.put(0.0);
+    sb.put(-1.5);
+    format::Statistics stats = sb.build();
+    BOOST_CHECK(stats.min_value == plain<double>(-1.5));
+    BOOST_CHECK(stats.max_value == plain<double>(+0.0));
+
+    statistics_builder<format::Type::FLOAT> zeros{statistics_options{}};
+    zeros.put(+0.0f);
+    stats = zeros.build();
+    BOOST_CHECK(stats.min_value == plain<float>(-0.0f));
+    BOOST_CHECK(stats.max_value == plain<float>(+0.0f));
+}
+
+BOOST_AUTO_TEST_CASE(statistics_byte_arrays) {
+    statistics_options options;
+    options.max_byte_array_size = 3;
+    statistics_builder<format::Type::BYTE_ARRAY> sb{options};
+    sb.put("abcd"_bv);
+    sb.put("\xff"_bv);
+    sb.put("ab\xff\xff"_bv);
+    format::Statistics stats = sb.build();
+    BOOST_CHECK_EQUAL(stats.min_value, "abc");
+    BOOST_CHECK_EQUAL(stats.max_value, "\xff");
+    BOOST_CHECK(!stats.__isset.min && !stats.__isset.max);
+
+    statistics_builder<format::Type::BYTE_ARRAY> truncated_max{options};
+    truncated_max.put("ab\xff\xff"_bv);
+    BOOST_CHECK_EQUAL(truncated_max.build().max_value, "ac");
+
+    statistics_builder<format::Type::BYTE_ARRAY> untruncatable{options};
+    untruncatable.put("\xff\xff\xff\xff"_bv);
+    BOOST_CHECK_EQUAL(untruncatable.build().max_value, "\xff\xff\xff\xff");
+}
+
+BOOST_AUTO_TEST_CASE(statistics_decimals) {
+    statistics_options options;
+    options.sort_order = logical_type::sort_order::SIGNED;
+    statistics_builder<format::Type::BYTE_ARRAY> sb{options};
+    bytes_view minus_one = "\xff"_bv;
+    bytes_view minus_256 = "\xff\x00"_bv;
+    bytes_view one = "\x01"_bv;
+    bytes_view two_hundred = "\x00\xc8"_bv;
+    sb.put(one);
+    sb.put(minus_one);
+    sb.put(two_hundred);
+    sb.put(minus_256);
+    format::Statistics stats = sb.build();
+    BOOST_CHECK_EQUAL(stats.min_value, str(minus_256));
+    BOOST_CHECK_EQUAL(stats.max_value, str(two_hundred));
+}
+
+} // namespace parquet4seastar
@@ -40,3 +40,109 @@ BOOST_AUTO_TEST_CASE(thrift_serdes) {
 
     BOOST_CHECK(fmd2.schema[0].type == format::Type::DOUBLE);
 }
+
+BOOST_AUTO_TEST_CASE(thrift_compact_decoder) {
+    using namespace parquet4seastar;
+    thrift_serializer serializer;
+
+    format::Statistics stats;
+    stats.__set_null_count(3);
+    stats.__set_min_value("abc");
+    stats.__set_max_value(std::string(300, 'z'));
+    format::DataPageHeader dph;
+    dph.__set_num_values(1000);
+    dph.__set_encoding(format::Encoding::RLE_DICTIONARY);
+    dph.__set_definition_level_encoding(format::Encoding::RLE);
+    dph.__set_repetition_level_encoding(format::Encoding::RLE);
+    dph.__set_statistics(stats);
+    format::PageHeader ph;
+    ph.__set_type(format::PageType::DATA_PAGE);
+    ph.__set_uncompressed_page_size(123456);
+    ph.__set_compressed_page_size(-1);
+    ph.__set_crc(42);
+    ph.__set_data_page_header(dph);
+    bytes serialized_ph{serializer.serialize(ph)};
+
+    format::PageHeader ph2;
+    BOOST_CHECK_EQUAL(thrift_compact::decode(serialized_ph, ph2), serialized_ph.size());
+    BOOST_CHECK(ph2 == ph);
+
+    format::LogicalType lt;
+    format::TimestampType ts;
+    ts.__set_isAdjustedToUTC(true);
+    format::TimeUnit unit;
+    unit.__set_NANOS(format::NanoSeconds{});
+    ts.__set_unit(unit);
+    lt.__set_TIMESTAMP(ts);
+    format::SchemaElement root;
+    root.__set_name("root");
+    root.__set_num_children(1);
+    format::SchemaElement leaf;
+    leaf.__set_name("ts");
+    leaf.__set_type(format::Type::INT64);
+    leaf.__set_repetition_type(format::FieldRepetitionType::OPTIONAL);
+    leaf.__set_logicalType(lt);
+    format::ColumnMetaData cmd;
+    cmd.__set_type(format::Type::INT64);
+    cmd.__set_encodings({format::Encoding::PLAIN, format::Encoding::RLE});
+    cmd.__set_path_in_schema({"ts"});
+    cmd.__set_codec(format::CompressionCodec::SNAPPY);
+    cmd.__set_num_values(1000);
+    cmd.__set_total_uncompressed_size(8000);
+    cmd.__set_total_compressed_size(4000);
+    cmd.__set_data_page_offset(4);
+    cmd.__set_statistics(stats);
+    format::ColumnChunk cc;
+    cc.__set_file_offset(4);
+    cc.__set_meta_data(cmd);
+    format::RowGroup rg;
+    rg.__set_columns({cc});
+    rg.__set_total_byte_size(8000);
+    rg.__set_num_rows(1000);
+    rg.__set_ordinal(0);
+    format::KeyValue kv;
+    kv.__set_key("key");
+    kv.__set_value("value");
+    format::FileMetaData fmd;
+    fmd.__set_version(1);
+    fmd.__set_schema({root, leaf});
+    fmd.__set_num_rows(1000);
+    fmd.__set_row_groups({rg, rg});
+    fmd.__set_key_value_metadata({kv});
+    fmd.__set_created_by("parquet4seastar");
+    bytes serialized_fmd{serializer.serialize(fmd)};
+
+    format::FileMetaData fmd2;
+    BOOST_CHECK_EQUAL(thrift_compact::decode(serialized_fmd, fmd2), serialized_fmd.size());
+    BOOST_CHECK(fmd2 == fmd);
+
+    format::ColumnMetaData cmd2;
+    bytes serialized_cmd{serializer.serialize(cmd)};
+    BOOST_CHECK_EQUAL(thrift_compact::decode(serialized_cmd, cmd2), serialized_cmd.size());
+    BOOST_CHECK(cmd2 == cmd);
+
+    // The lazy metadata has the same row groups, but without columns.
+    thrift_compact::lazy_file_metadata lazy;
+    BOOST_CHECK_EQUAL(thrift_compact::decode(serialized_fmd, lazy), serialized_fmd.size());
+    BOOST_REQUIRE_EQUAL(lazy.column_chunk_offsets.size(), 2);
+    for (size_t i = 0; i < 2; ++i) {
+        const std::vector<uint32_t>& offsets = lazy.column_chunk_offsets[i];
+        BOOST_REQUIRE_EQUAL(offsets.size(), 2);
+        format::ColumnChunk cc2;
+        bytes_view serialized_cc{serialized_fmd.data() + offsets[0], offsets[1] - offsets[0]};
+        BOOST_CHECK_EQUAL(thrift_compact::decode(serialized_cc, cc2), serialized_cc.size());
+        BOOST_CHECK(cc2 == cc);
+        lazy.metadata.row_groups[i].columns.push_back(cc2);
+    }
+    BOOST_CHECK(lazy.metadata == fmd);
+
+    // Truncated messages are reported, so that the stream reader can retry with more data.
+    for (size_t len : {size_t(0), size_t(1), serialized_ph.size() / 2, serialized_ph.size() - 1}) {
+        BOOST_CHECK_THROW(thrift_compact::decode(bytes_view{serialized_ph.data(), len}, ph2),
+                thrift_compact::truncated_message);
+    }
+
+    // Required fields are checked: a page header with only its type.
+    bytes missing_fields{0x15, 0x00, 0x00};
+    BOOST_CHECK_THROW(thrift_compact::decode(missing_fields, ph2), parquet_exception);
+}